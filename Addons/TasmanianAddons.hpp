@@ -43,6 +43,7 @@
  */
 
 #include "tsgLoadNeededValues.hpp"
+#include "tsgEvaluateStream.hpp"
 #include "tsgMPISampleDream.hpp"
 
 /*!
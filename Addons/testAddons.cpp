@@ -29,6 +29,7 @@
  */
 
 #include "testConstructSurrogate.hpp"
+#include "testEvaluateStream.hpp"
 
 int main(int, char **){
 
@@ -44,6 +45,10 @@ int main(int, char **){
     cout << std::setw(40) << "Automated construction" << std::setw(10) << ((pass) ? "Pass" : "FAIL") << endl;
     pass_all = pass_all && pass;
 
+    pass = testEvaluateStream(verbose);
+    cout << std::setw(40) << "Streaming evaluations" << std::setw(10) << ((pass) ? "Pass" : "FAIL") << endl;
+    pass_all = pass_all && pass;
+
     cout << "\n";
     if (pass){
         cout << "---------------------------------------------------------------------" << endl;
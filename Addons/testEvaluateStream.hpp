@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2017, Miroslav Stoyanov
+ *
+ * This file is part of
+ * Toolkit for Adaptive Stochastic Modeling And Non-Intrusive ApproximatioN: TASMANIAN
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * UT-BATTELLE, LLC AND THE UNITED STATES GOVERNMENT MAKE NO REPRESENTATIONS AND DISCLAIM ALL WARRANTIES, BOTH EXPRESSED AND IMPLIED.
+ * THERE ARE NO EXPRESS OR IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, OR THAT THE USE OF THE SOFTWARE WILL NOT INFRINGE ANY PATENT,
+ * COPYRIGHT, TRADEMARK, OR OTHER PROPRIETARY RIGHTS, OR THAT THE SOFTWARE WILL ACCOMPLISH THE INTENDED RESULTS OR THAT THE SOFTWARE OR ITS USE WILL NOT RESULT IN INJURY OR DAMAGE.
+ * THE USER ASSUMES RESPONSIBILITY FOR ALL LIABILITIES, PENALTIES, FINES, CLAIMS, CAUSES OF ACTION, AND COSTS AND EXPENSES, CAUSED BY, RESULTING FROM OR ARISING OUT OF,
+ * IN WHOLE OR IN PART THE USE, STORAGE OR DISPOSAL OF THE SOFTWARE.
+ */
+
+#ifndef __TASMANIAN_TEST_EVALUATE_STREAM_HPP
+#define __TASMANIAN_TEST_EVALUATE_STREAM_HPP
+
+#include "TasmanianAddons.hpp"
+#include "tasgridCLICommon.hpp"
+
+//! \brief Compares the streaming evaluations against a single call to evaluateBatch().
+bool testEvaluateStream(bool verbose){
+    auto grid = TasGrid::makeLocalPolynomialGrid(3, 2, 4, 2, TasGrid::rule_localp);
+    grid.setDomainTransform({-2.0, 0.0, 1.0}, {1.0, 3.0, 5.0});
+    auto points = grid.getNeededPoints();
+    std::vector<double> values(2 * grid.getNumNeeded());
+    for(int i=0; i<grid.getNumNeeded(); i++){
+        values[2*i]     = std::exp(points[3*i] - points[3*i+1]);
+        values[2*i + 1] = points[3*i] * points[3*i+2];
+    }
+    grid.loadNeededPoints(values);
+
+    std::minstd_rand park_miller(42);
+    std::uniform_real_distribution<double> unif(0.0, 1.0);
+    int num_x = 1003; // not a multiple of the chunk size
+    std::vector<double> x(3 * num_x);
+    for(int i=0; i<num_x; i++){
+        x[3*i]     = -2.0 + 3.0 * unif(park_miller);
+        x[3*i + 1] =  3.0 * unif(park_miller);
+        x[3*i + 2] =  1.0 + 4.0 * unif(park_miller);
+    }
+    std::vector<double> reference;
+    grid.evaluateBatch(x, reference);
+
+    // using the callbacks
+    std::vector<double> result;
+    size_t offset = 0;
+    TasGrid::evaluateBatchStream(grid,
+        [&](int max_num_x, double xchunk[])->int{
+            size_t num_read = std::min((size_t) (3 * max_num_x), x.size() - offset);
+            std::copy_n(x.begin() + offset, num_read, xchunk);
+            offset += num_read;
+            return (int) (num_read / 3);
+        },
+        [&](int num, double const ychunk[])->void{
+            result.insert(result.end(), ychunk, ychunk + 2 * num);
+        }, 100);
+    if (result != reference){
+        cout << "ERROR: mismatch in evaluateBatchStream() using callbacks" << endl;
+        return false;
+    }
+    if (verbose) cout << std::setw(40) << "stream callbacks" << std::setw(10) << "Pass" << endl;
+
+    // using the binary matrix files
+    {
+        std::ofstream ofs("stream_x.tsg", std::ios::out | std::ios::binary);
+        char tsg[3] = {'T', 'S', 'G'};
+        int num_cols = 3;
+        ofs.write(tsg, 3 * sizeof(char));
+        ofs.write((char*) &num_x, sizeof(int));
+        ofs.write((char*) &num_cols, sizeof(int));
+        ofs.write((char*) x.data(), x.size() * sizeof(double));
+    }
+    TasGrid::evaluateBatchStream(grid, "stream_x.tsg", "stream_y.tsg", 64);
+    {
+        std::ifstream ifs("stream_y.tsg", std::ios::in | std::ios::binary);
+        char tsg[3] = {'A', 'A', 'A'};
+        int num_rows = 0, num_cols = 0;
+        ifs.read(tsg, 3 * sizeof(char));
+        ifs.read((char*) &num_rows, sizeof(int));
+        ifs.read((char*) &num_cols, sizeof(int));
+        result = std::vector<double>(reference.size());
+        ifs.read((char*) result.data(), result.size() * sizeof(double));
+        if ((tsg[0] != 'T') || (num_rows != num_x) || (num_cols != 2) || (result != reference)){
+            cout << "ERROR: mismatch in evaluateBatchStream() using files" << endl;
+            return false;
+        }
+    }
+    if ((std::remove("stream_x.tsg") != 0) || (std::remove("stream_y.tsg") != 0))
+        throw std::runtime_error("Could not delete the files used by the stream test.");
+    if (verbose) cout << std::setw(40) << "stream files" << std::setw(10) << "Pass" << endl;
+
+    // errors in the reader must propagate to the caller
+    try{
+        TasGrid::evaluateBatchStream(grid,
+            [&](int, double[])->int{ throw std::runtime_error("reader failure"); },
+            [&](int, double const[])->void{}, 100);
+        cout << "ERROR: evaluateBatchStream() did not propagate the reader exception" << endl;
+        return false;
+    }catch(std::runtime_error &){}
+
+    return true;
+}
+
+#endif
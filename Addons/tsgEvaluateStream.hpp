@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2017, Miroslav Stoyanov
+ *
+ * This file is part of
+ * Toolkit for Adaptive Stochastic Modeling And Non-Intrusive ApproximatioN: TASMANIAN
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * UT-BATTELLE, LLC AND THE UNITED STATES GOVERNMENT MAKE NO REPRESENTATIONS AND DISCLAIM ALL WARRANTIES, BOTH EXPRESSED AND IMPLIED.
+ * THERE ARE NO EXPRESS OR IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, OR THAT THE USE OF THE SOFTWARE WILL NOT INFRINGE ANY PATENT,
+ * COPYRIGHT, TRADEMARK, OR OTHER PROPRIETARY RIGHTS, OR THAT THE SOFTWARE WILL ACCOMPLISH THE INTENDED RESULTS OR THAT THE SOFTWARE OR ITS USE WILL NOT RESULT IN INJURY OR DAMAGE.
+ * THE USER ASSUMES RESPONSIBILITY FOR ALL LIABILITIES, PENALTIES, FINES, CLAIMS, CAUSES OF ACTION, AND COSTS AND EXPENSES, CAUSED BY, RESULTING FROM OR ARISING OUT OF,
+ * IN WHOLE OR IN PART THE USE, STORAGE OR DISPOSAL OF THE SOFTWARE.
+ */
+
+#ifndef __TASMANIAN_ADDONS_EVALUATE_STREAM_HPP
+#define __TASMANIAN_ADDONS_EVALUATE_STREAM_HPP
+
+/*!
+ * \internal
+ * \file tsgEvaluateStream.hpp
+ * \brief Templates for evaluating a surrogate over a stream of points.
+ * \author Miroslav Stoyanov
+ * \ingroup TasmanianAddonsCommon
+ *
+ * Evaluates a sparse grid at a sequence of points that is read and written
+ * in fixed size chunks, the I/O is overlapped with the evaluations.
+ * \endinternal
+ */
+
+#include <exception>
+
+#include "tsgAddonsCommon.hpp"
+
+/*!
+ * \ingroup TasmanianAddons
+ * \addtogroup TasmanianAddonsEvaluateStream Streaming Evaluations
+ *
+ * Handy templates to evaluate a surrogate at a number of points that is too large
+ * to hold in memory, e.g., Monte Carlo samples that are read from and written to disk.
+ */
+
+namespace TasGrid{
+
+/*!
+ * \ingroup TasmanianAddonsEvaluateStream
+ * \brief Evaluates the grid at the points provided by the \b reader and passes the result to the \b writer.
+ *
+ * The points are processed in chunks of at most \b chunk_size and two chunks are kept in memory;
+ * while the grid is evaluating one chunk, a separate thread writes the result of the previous chunk
+ * and reads the points of the next one. The result is identical to calling
+ * grid.evaluateBatch() on all points, but the memory usage is bounded by the chunk size
+ * and any domain transform is applied one chunk at a time.
+ *
+ * \param grid is the sparse grid to evaluate, it must have loaded values.
+ * \param reader must write up to \b max_num_x points in \b x, using the same layout as evaluateBatch(),
+ *               and return the number of points actually written; zero indicates the end of the stream.
+ *               The reader is called from a separate thread, but never concurrently with the writer.
+ * \param writer accepts the \b num_x results associated with the points of the oldest chunk
+ *               that has not been written yet, the \b y array is valid only during the call.
+ * \param chunk_size is the maximum number of points in a single chunk, i.e., in a single call to grid.evaluateBatch().
+ *
+ * \throws std::invalid_argument if \b chunk_size is not positive or if the \b reader returns more than \b max_num_x points.
+ * \throws std::runtime_error if the grid has no outputs,
+ *         exceptions from the \b reader and \b writer are propagated to the caller.
+ */
+inline void evaluateBatchStream(TasmanianSparseGrid const &grid,
+                                std::function<int(int max_num_x, double x[])> reader,
+                                std::function<void(int num_x, double const y[])> writer,
+                                int chunk_size = 4096){
+    if (grid.getNumOutputs() == 0) throw std::runtime_error("ERROR: cannot call evaluateBatchStream() for a grid with no outputs");
+    if (chunk_size < 1) throw std::invalid_argument("ERROR: evaluateBatchStream() requires positive chunk_size");
+    size_t x_size = Utils::size_mult(chunk_size, grid.getNumDimensions());
+    size_t y_size = Utils::size_mult(chunk_size, grid.getNumOutputs());
+
+    auto checked_read = [&](double x[])->int{
+        int num_x = reader(chunk_size, x);
+        if (num_x > chunk_size) throw std::invalid_argument("ERROR: the reader in evaluateBatchStream() returned more than the max_num_x points");
+        return std::max(num_x, 0);
+    };
+
+    // the "active" chunk is being evaluated while the "next" is read and the "done" is written
+    std::vector<double> x_active(x_size), x_next(x_size), y_active(y_size), y_done(y_size);
+    int num_active = checked_read(x_active.data());
+    int num_done = 0;
+
+    while(num_active > 0){
+        int num_next = 0;
+        std::exception_ptr io_error;
+        std::thread io([&]()->void{
+            try{
+                if (num_done > 0) writer(num_done, y_done.data());
+                num_next = checked_read(x_next.data());
+            }catch(...){
+                io_error = std::current_exception();
+            }
+        });
+        try{
+            grid.evaluateBatch(x_active.data(), num_active, y_active.data());
+        }catch(...){
+            io.join();
+            throw;
+        }
+        io.join();
+        if (io_error) std::rethrow_exception(io_error);
+
+        std::swap(x_active, x_next);
+        std::swap(y_active, y_done);
+        num_done = num_active;
+        num_active = num_next;
+    }
+    if (num_done > 0) writer(num_done, y_done.data());
+}
+
+/*!
+ * \ingroup TasmanianAddonsEvaluateStream
+ * \brief Evaluates the grid at the points stored in a file and writes the result to another file.
+ *
+ * The files use the binary matrix format of the tasgrid command line tool,
+ * i.e., the characters "TSG" followed by the number of rows and columns as integers
+ * and the matrix entries in row-major format.
+ * Each row of the matrix in \b x_filename is one point and the number of columns
+ * must match grid.getNumDimensions(); the result written in \b y_filename has one row per point
+ * and grid.getNumOutputs() columns. Only two chunks of the matrices are held in memory,
+ * see the callback overload of evaluateBatchStream().
+ *
+ * \throws std::runtime_error if the files cannot be opened, if \b x_filename is not a binary matrix,
+ *         or if the number of columns does not match the dimensions of the grid.
+ */
+inline void evaluateBatchStream(TasmanianSparseGrid const &grid, std::string const &x_filename, std::string const &y_filename, int chunk_size = 4096){
+    std::ifstream ifs(x_filename, std::ios::in | std::ios::binary);
+    if (!ifs.good()) throw std::runtime_error(std::string("ERROR: could not open file ") + x_filename);
+    char tsg[3] = {'A', 'A', 'A'};
+    ifs.read(tsg, 3 * sizeof(char));
+    if ((tsg[0] != 'T') || (tsg[1] != 'S') || (tsg[2] != 'G'))
+        throw std::runtime_error(std::string("ERROR: evaluateBatchStream() requires a binary matrix file, could not read ") + x_filename);
+    int num_rows = 0, num_cols = 0;
+    ifs.read((char*) &num_rows, sizeof(int));
+    ifs.read((char*) &num_cols, sizeof(int));
+    if (!ifs.good() || (num_rows < 0)) throw std::runtime_error(std::string("ERROR: corrupt matrix header in file ") + x_filename);
+    if (num_cols != grid.getNumDimensions())
+        throw std::runtime_error("ERROR: the number of columns in the file does not match the number of dimensions of the grid");
+
+    int num_outputs = grid.getNumOutputs();
+    std::ofstream ofs(y_filename, std::ios::out | std::ios::binary);
+    if (!ofs.good()) throw std::runtime_error(std::string("ERROR: could not open file ") + y_filename);
+    tsg[0] = 'T'; tsg[1] = 'S'; tsg[2] = 'G';
+    ofs.write(tsg, 3 * sizeof(char));
+    ofs.write((char*) &num_rows, sizeof(int));
+    ofs.write((char*) &num_outputs, sizeof(int));
+
+    int num_remaining = num_rows;
+    evaluateBatchStream(grid,
+        [&](int max_num_x, double x[])->int{
+            int num_x = std::min(max_num_x, num_remaining);
+            ifs.read((char*) x, Utils::size_mult(num_x, num_cols) * sizeof(double));
+            if (!ifs.good()) throw std::runtime_error(std::string("ERROR: unexpected end of file ") + x_filename);
+            num_remaining -= num_x;
+            return num_x;
+        },
+        [&](int num_x, double const y[])->void{
+            ofs.write((char const*) y, Utils::size_mult(num_x, num_outputs) * sizeof(double));
+            if (!ofs.good()) throw std::runtime_error(std::string("ERROR: could not write to file ") + y_filename);
+        }, chunk_size);
+}
+
+}
+
+#endif
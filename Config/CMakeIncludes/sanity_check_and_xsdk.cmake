@@ -79,10 +79,8 @@ if (Tasmanian_ENABLE_OPENMP OR Tasmanian_ENABLE_RECOMMENDED)
     endif()
 endif()
 
-# fallback threads library if OpenMP is disabled, needed for Addons
-if (NOT Tasmanian_ENABLE_OPENMP)
-    find_package(Threads REQUIRED)
-endif()
+# threads library, used by the thread pool executor and the Addons
+find_package(Threads REQUIRED)
 
 # check for BLAS
 if (Tasmanian_ENABLE_BLAS OR Tasmanian_ENABLE_RECOMMENDED)
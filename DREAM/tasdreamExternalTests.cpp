@@ -360,13 +360,293 @@ bool DreamExternalTester::testGaussian2D(){
     return passAll;
 }
 
+bool DreamExternalTester::testCounterRandom(){
+    bool passAll = true;
+
+    // known answer test for Philox-4x32-10, taken from the Random123 library
+    std::array<std::uint32_t, 4> counter = {{0, 0, 0, 0}};
+    philox4x32(counter, {{0, 0}});
+    bool pass = (counter[0] == 0x6627e8d5u) && (counter[1] == 0xe169c58du) && (counter[2] == 0xbc57ac4cu) && (counter[3] == 0x9b00dbd8u);
+    counter = {{0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu}};
+    philox4x32(counter, {{0xffffffffu, 0xffffffffu}});
+    pass = pass && (counter[0] == 0x408f276du) && (counter[1] == 0x41c83b0eu) && (counter[2] == 0xa20bc7c6u) && (counter[3] == 0x6d5451fdu);
+
+    // batch fill gives the same sequence as individual calls, streams are independent of each other
+    CounterRandom01 single(42, 3, 7), batch(42, 3, 7);
+    std::vector<double> rsingle(15), rbatch(15);
+    for(auto &r : rsingle) r = single();
+    batch.fill(1, rbatch.data());
+    batch.fill(4, &rbatch[1]);
+    batch.fill(6, &rbatch[5]);
+    rbatch[11] = batch();
+    batch.fill(2, &rbatch[12]); // aligned with the blocks, bypasses the internal buffer
+    rbatch[14] = batch();
+    for(size_t i=0; i<rsingle.size(); i++)
+        if ((rsingle[i] != rbatch[i]) || (rsingle[i] <= 0.0) || (rsingle[i] >= 1.0)) pass = false;
+    if (single.getStream(3, 7)() != rsingle[0]) pass = false;
+    if (single.getStream(7, 3)() == rsingle[0]) pass = false;
+
+    passAll = passAll && pass;
+    if (verbose || !pass) reportPassFail(pass, "Counter RNG", "known answers and streams");
+
+    // sample Gaussian using chain-independent streams, repeat the sampling and check for reproducibility
+    int num_dimensions = 3;
+    int num_samples = 1000, num_chains = 20;
+    int num_iterations = num_samples / num_chains + 2;
+    int num_burnup = 20 * num_iterations;
+
+    CounterRandom01 random((usetimeseed) ? (unsigned long long) getRandomRandomSeed() : 42);
+    std::vector<double> means(num_dimensions, 2.0), deviations(num_dimensions, 3.0);
+    std::vector<double> tresult, initial_state;
+    genGaussianSamples(means, deviations, num_samples, tresult, random);
+    genGaussianSamples(means, deviations, num_chains, initial_state, random);
+
+    auto pdf = [&](const std::vector<double> &candidates, std::vector<double> &values){
+        auto ix = candidates.begin();
+        for(auto &v : values)
+            v = getDensity<dist_gaussian>(*ix++, 2.0, 9.0) * getDensity<dist_gaussian>(*ix++, 2.0, 9.0) * getDensity<dist_gaussian>(*ix++, 2.0, 9.0);
+    };
+    std::vector<double> upper(num_dimensions, 11.0), lower(num_dimensions, -7.0);
+
+    std::vector<std::vector<double>> history;
+    for(int repeat=0; repeat<2; repeat++){
+        TasmanianDREAM state(num_chains, num_dimensions);
+        state.setState(initial_state);
+        CounterRandom01 sampler_random = random; // copy the seed and the stream
+        SampleDREAM(num_burnup, 2*num_iterations, pdf, hypercube(lower, upper), state, dist_uniform, 0.2, const_percent<50>, sampler_random);
+        if (sampler_random.getIteration() != random.getIteration() + num_burnup + 2*num_iterations) pass = false;
+        history.push_back(state.getHistory());
+        if (repeat == 0) pass = pass && compareSamples(lower, upper, 5, tresult, history.back()) && (state.getAcceptanceRate() > 0.5);
+    }
+    pass = pass && (history[0] == history[1]);
+
+    passAll = passAll && pass;
+    if (verbose || !pass) reportPassFail(pass, "Counter RNG", "reproducible sampling");
+
+    // processing the chains in parallel must give the same result as the sequential mode
+    num_chains = 100;
+    genGaussianSamples(means, deviations, num_chains, initial_state, random);
+    history.clear();
+    for(int use_executor=0; use_executor<2; use_executor++){
+        TasmanianDREAM state(num_chains, num_dimensions);
+        if (use_executor == 1) state.setExecutor(TasGrid::makeThreadPoolExecutor(3));
+        state.setState(initial_state);
+        CounterRandom01 sampler_random = random;
+        SampleDREAM<logform>(10, 10, [&](const std::vector<double> &candidates, std::vector<double> &values){
+                pdf(candidates, values);
+                for(auto &v : values) v = std::log(v);
+            }, hypercube(lower, upper), state, dist_gaussian, 0.5, const_percent<50>, sampler_random);
+        history.push_back(state.getHistory());
+        history.push_back(state.getHistoryPDF());
+    }
+    pass = (history[0] == history[2]) && (history[1] == history[3]);
+
+    passAll = passAll && pass;
+    if (verbose || !pass) reportPassFail(pass, "Counter RNG", "parallel chains");
+
+    reportPassFail(passAll, "Counter RNG", "Philox streams");
+
+    return passAll;
+}
+
+bool DreamExternalTester::testHistorySinks(){
+    int num_dimensions = 2, num_chains = 10;
+    int num_burnup = 20, num_collect = 50;
+
+    CounterRandom01 random((usetimeseed) ? (unsigned long long) getRandomRandomSeed() : 42);
+    std::vector<double> initial_state = genUniformSamples({-1.0, -1.0}, {1.0, 1.0}, num_chains, random);
+
+    std::string filename = "dreamtest_history.bin";
+    TasmanianDREAM reference(num_chains, num_dimensions), thinned(num_chains, num_dimensions), streamed(num_chains, num_dimensions);
+    thinned.setHistoryThinning(3);
+    auto file_sink = std::make_shared<DreamHistoryFile>(filename, num_chains, num_dimensions, 7);
+    streamed.setHistorySink(file_sink);
+
+    for(auto state : {&reference, &thinned, &streamed}){
+        state->setState(initial_state);
+        CounterRandom01 sampler_random = random; // all states use the same random numbers
+        SampleDREAM(num_burnup, num_collect,
+            [&](const std::vector<double> &candidates, std::vector<double> &values){
+                auto ix = candidates.begin();
+                for(auto &v : values){
+                    v = getDensity<dist_gaussian>(*ix++, 0.0, 1.0) * getDensity<dist_gaussian>(*ix++, 0.0, 1.0);
+                }
+            }, hypercube({-1.0, -1.0}, {1.0, 1.0}), *state, dist_uniform, 0.5, const_percent<50>, sampler_random);
+    }
+    std::vector<double> const &history = reference.getHistory();
+    std::vector<double> const &pdf_history = reference.getHistoryPDF();
+    size_t snapshot_size = (size_t) (num_chains * num_dimensions);
+
+    // the thinned history keeps every third snapshot
+    bool pass = (thinned.getNumHistory() == (size_t) (num_chains * ((num_collect + 2) / 3)));
+    for(size_t s=0; pass && (s < thinned.getNumHistory() / num_chains); s++){
+        pass = std::equal(history.begin() + 3 * s * snapshot_size, history.begin() + (3 * s + 1) * snapshot_size, thinned.getHistory().begin() + s * snapshot_size)
+            && std::equal(pdf_history.begin() + 3 * s * num_chains, pdf_history.begin() + (3 * s + 1) * num_chains, thinned.getHistoryPDF().begin() + s * num_chains);
+    }
+    pass = pass && (thinned.getAcceptanceRate() == reference.getAcceptanceRate());
+    if (verbose || !pass) reportPassFail(pass, "History", "thinning");
+    bool passAll = pass;
+
+    // the file holds the full history and the reader can get any portion of it
+    pass = (streamed.getNumHistory() == 0) && (file_sink->getNumSnapshots() == (size_t) num_collect)
+        && (streamed.getAcceptanceRate() == reference.getAcceptanceRate());
+    {
+        DreamHistoryReader reader(filename);
+        std::vector<double> file_history, file_pdf;
+        reader.readSnapshots(0, reader.getNumSnapshots(), file_history, file_pdf);
+        pass = pass && (reader.getNumChains() == num_chains) && (reader.getNumDimensions() == num_dimensions)
+                    && (reader.getNumSnapshots() == (size_t) num_collect) && (file_history == history) && (file_pdf == pdf_history);
+        reader.readSnapshots(45, 10, file_history, file_pdf); // goes past the end of the file
+        pass = pass && (file_pdf.size() == (size_t) (5 * num_chains))
+                    && std::equal(file_history.begin(), file_history.end(), history.begin() + 45 * snapshot_size)
+                    && std::equal(file_pdf.begin(), file_pdf.end(), pdf_history.begin() + 45 * num_chains);
+    }
+    streamed.setHistorySink(nullptr);
+    file_sink.reset();
+    std::vector<double> first_state(history.begin(), history.begin() + snapshot_size);
+    std::vector<double> first_pdf(pdf_history.begin(), pdf_history.begin() + num_chains);
+    try{ // a sink with a different shape must reject the snapshot
+        DreamHistoryFile wrong_sink(filename, num_chains, num_dimensions + 1);
+        wrong_sink.save(first_state, first_pdf);
+        pass = false;
+    }catch(std::invalid_argument &){}
+    std::remove(filename.c_str());
+    #ifdef __linux__
+    try{ // writing to a full device must be reported
+        DreamHistoryFile full_sink("/dev/full", num_chains, num_dimensions);
+        full_sink.save(first_state, first_pdf);
+        full_sink.flush();
+        pass = false;
+    }catch(std::runtime_error &){}
+    #endif
+    if (verbose || !pass) reportPassFail(pass, "History", "file sink and reader");
+    passAll = passAll && pass;
+
+    reportPassFail(passAll, "History", "thinning and file sink");
+
+    return passAll;
+}
+
+bool DreamExternalTester::testHistoryStatistics(){
+    int num_dimensions = 2, num_chains = 10;
+    int num_burnup = 20, num_collect = 200;
+
+    CounterRandom01 random((usetimeseed) ? (unsigned long long) getRandomRandomSeed() : 42);
+    std::vector<double> initial_state = genUniformSamples({-1.0, -1.0}, {1.0, 1.0}, num_chains, random);
+
+    auto likelihood = [&](const std::vector<double> &candidates, std::vector<double> &values){
+        auto ix = candidates.begin();
+        for(auto &v : values){
+            v = getDensity<dist_gaussian>(*ix++, 0.0, 1.0) * getDensity<dist_gaussian>(*ix++, 1.0, 4.0);
+        }
+    };
+
+    TasmanianDREAM reference(num_chains, num_dimensions), thinned(num_chains, num_dimensions), streamed(num_chains, num_dimensions);
+    thinned.setHistoryThinning(4);
+    std::string filename = "dreamtest_statistics.bin";
+    auto file_sink = std::make_shared<DreamHistoryFile>(filename, num_chains, num_dimensions);
+    streamed.setHistorySink(file_sink);
+
+    for(auto state : {&reference, &thinned, &streamed}){
+        state->setState(initial_state);
+        CounterRandom01 sampler_random = random;
+        SampleDREAM(num_burnup, num_collect, likelihood, hypercube({-6.0, -6.0}, {6.0, 8.0}), *state, dist_uniform, 0.5, const_percent<90>, sampler_random);
+    }
+    streamed.setHistorySink(nullptr);
+    file_sink.reset();
+    std::remove(filename.c_str());
+
+    // compares the online statistics against direct computation over the saved history
+    auto match_history = [&](TasmanianDREAM const &state)->bool{
+        std::vector<double> const &history = state.getHistory();
+        std::vector<double> const &pdf_history = state.getHistoryPDF();
+        size_t num_samples = pdf_history.size(), num_snapshots = num_samples / num_chains;
+        std::vector<double> mean(num_dimensions, 0.0), cov(num_dimensions * num_dimensions, 0.0);
+        for(size_t i=0; i<num_samples; i++)
+            for(int j=0; j<num_dimensions; j++) mean[j] += history[i * num_dimensions + j] / (double) num_samples;
+        for(size_t i=0; i<num_samples; i++)
+            for(int j=0; j<num_dimensions; j++)
+                for(int k=0; k<num_dimensions; k++)
+                    cov[j * num_dimensions + k] += (history[i * num_dimensions + j] - mean[j]) * (history[i * num_dimensions + k] - mean[k]) / (double) num_samples;
+
+        std::vector<double> chain_mean(num_chains * num_dimensions, 0.0), chain_var(num_chains * num_dimensions, 0.0);
+        for(size_t s=0; s<num_snapshots; s++)
+            for(int c=0; c<num_chains * num_dimensions; c++) chain_mean[c] += history[s * num_chains * num_dimensions + c] / (double) num_snapshots;
+        for(size_t s=0; s<num_snapshots; s++)
+            for(int c=0; c<num_chains * num_dimensions; c++){
+                double d = history[s * num_chains * num_dimensions + c] - chain_mean[c];
+                chain_var[c] += d * d / (double) num_snapshots;
+            }
+
+        std::vector<double> online_mean, online_var, online_cov, online_chain_mean, online_chain_var;
+        state.getHistoryMeanVariance(online_mean, online_var);
+        state.getHistoryCovariance(online_cov);
+        state.getChainMeanVariance(online_chain_mean, online_chain_var);
+
+        auto close = [](std::vector<double> const &a, std::vector<double> const &b)->bool{
+            if (a.size() != b.size()) return false;
+            for(size_t i=0; i<a.size(); i++) if (std::abs(a[i] - b[i]) > 1.E-10) return false;
+            return true;
+        };
+        std::vector<double> var = {cov[0], cov[3]};
+        size_t imode = (size_t) std::distance(pdf_history.begin(), std::max_element(pdf_history.begin(), pdf_history.end()));
+        std::vector<double> mode(history.begin() + imode * num_dimensions, history.begin() + (imode + 1) * num_dimensions);
+        return close(mean, online_mean) && close(var, online_var) && close(cov, online_cov)
+            && close(chain_mean, online_chain_mean) && close(chain_var, online_chain_var)
+            && (mode == state.getApproximateMode());
+    };
+
+    bool pass = match_history(reference) && match_history(thinned);
+    if (verbose || !pass) reportPassFail(pass, "Statistics", "online mean and variance");
+    bool passAll = pass;
+
+    // the statistics include the snapshots sent to the sink
+    std::vector<double> mean_reference, var_reference, mean_streamed, var_streamed;
+    reference.getHistoryMeanVariance(mean_reference, var_reference);
+    streamed.getHistoryMeanVariance(mean_streamed, var_streamed);
+    pass = (mean_reference == mean_streamed) && (var_reference == var_streamed)
+        && (reference.getApproximateMode() == streamed.getApproximateMode())
+        && (reference.getGelmanRubin() == streamed.getGelmanRubin());
+    if (verbose || !pass) reportPassFail(pass, "Statistics", "history sink");
+    passAll = passAll && pass;
+
+    // converged chains give R-hat close to one, chains that do not mix are flagged
+    std::vector<double> rhat = reference.getGelmanRubin();
+    std::vector<double> ess = reference.getEffectiveSampleSize();
+    pass = (*std::max_element(rhat.begin(), rhat.end()) < 1.1)
+        && (*std::min_element(ess.begin(), ess.end()) > 0.0) && (*std::max_element(ess.begin(), ess.end()) <= (double) (num_chains * num_collect));
+
+    TasmanianDREAM stuck(num_chains, num_dimensions);
+    stuck.setState(genUniformSamples({-5.0, -5.0}, {5.0, 5.0}, num_chains, random));
+    SampleDREAM(0, 20, likelihood, hypercube({-6.0, -6.0}, {6.0, 8.0}), stuck, dist_uniform, 1.E-4, const_percent<0>, random); // jumps are too small
+    rhat = stuck.getGelmanRubin();
+    pass = pass && (*std::min_element(rhat.begin(), rhat.end()) > 1.1);
+
+    try{
+        TasmanianDREAM single(num_chains, num_dimensions);
+        single.setState(initial_state);
+        SampleDREAM(0, 1, likelihood, hypercube({-6.0, -6.0}, {6.0, 8.0}), single, dist_uniform, 0.5, const_one, random);
+        single.getGelmanRubin();
+        pass = false; // did not throw
+    }catch(std::runtime_error &){}
+    if (verbose || !pass) reportPassFail(pass, "Statistics", "Gelman-Rubin and sample size");
+    passAll = passAll && pass;
+
+    reportPassFail(passAll, "Statistics", "online history statistics");
+
+    return passAll;
+}
+
 bool DreamExternalTester::testKnownDistributions(){
     // Test Gaussian distribution
 
     bool pass1 = testGaussian3D();
     bool pass2 = testGaussian2D();
+    bool pass3 = testCounterRandom();
+    bool pass4 = testHistorySinks();
+    bool pass5 = testHistoryStatistics();
 
-    return pass1 && pass2;
+    return pass1 && pass2 && pass3 && pass4 && pass5;
 }
 
 bool DreamExternalTester::testCustomModel(){
@@ -520,7 +800,50 @@ bool DreamExternalTester::testGridModel(){
     passAll = passAll && pass;
     if (verbose || !pass) reportPassFail(pass, "Inference 2D", "grid frequency model");
 
-    reportPassFail(pass, "Inference 2D", "DREAM Bayesian grid model");
+    // the fused surrogate likelihood must match the likelihood of the grid outputs
+    pass = true;
+    std::vector<double> candidates = genUniformSamples(lower, upper, 50, get_rand);
+    std::vector<double> variance(num_outputs);
+    for(int i=0; i<num_outputs; i++) variance[i] = 0.01 + 0.001 * i;
+    LikelihoodGaussAnisotropic alikely(variance, data, 2);
+    for(int test_grid=0; test_grid<3; test_grid++){
+        TasGrid::TasmanianSparseGrid surrogate;
+        if (test_grid == 0){
+            surrogate.makeLocalPolynomialGrid(num_dimensions, num_outputs, 3, 2);
+        }else if (test_grid == 1){
+            surrogate.makeGlobalGrid(num_dimensions, num_outputs, 3, TasGrid::type_level, TasGrid::rule_clenshawcurtis);
+        }else{
+            surrogate = grid; // too many points, uses the fall back mode
+        }
+        surrogate.setDomainTransform(lower, upper);
+        if (surrogate.getNumNeeded() > 0){
+            std::vector<double> spoints = surrogate.getNeededPoints(), svalues(num_outputs * surrogate.getNumNeeded());
+            for(int i=0; i<surrogate.getNumNeeded(); i++)
+                getSinSinModel(spoints[2*i], spoints[2*i+1], 1.0 / ((double) num_outputs), num_outputs, &svalues[i * num_outputs]);
+            surrogate.loadNeededPoints(svalues);
+        }
+
+        LikelihoodGaussSurrogate fused_isotropic(surrogate, 0.01, data);
+        LikelihoodGaussSurrogate fused_anisotropic(surrogate, variance, data, 2);
+        if (fused_isotropic.isFused() != (test_grid < 2)) pass = false;
+
+        std::vector<double> outputs, reference(50), fused(50);
+        surrogate.evaluateBatch(candidates, outputs);
+        for(auto form : {regform, logform}){
+            likely.getLikelihood(form, outputs, reference);
+            fused_isotropic.getLikelihood(form, candidates, fused);
+            for(size_t i=0; i<reference.size(); i++)
+                if (std::abs(reference[i] - fused[i]) > 1.E-8 * (1.0 + std::abs(reference[i]))) pass = false;
+            alikely.getLikelihood(form, outputs, reference);
+            fused_anisotropic.getLikelihood(form, candidates, fused);
+            for(size_t i=0; i<reference.size(); i++)
+                if (std::abs(reference[i] - fused[i]) > 1.E-8 * (1.0 + std::abs(reference[i]))) pass = false;
+        }
+    }
+    passAll = passAll && pass;
+    if (verbose || !pass) reportPassFail(pass, "Inference 2D", "fused surrogate likelihood");
+
+    reportPassFail(passAll, "Inference 2D", "DREAM Bayesian grid model");
 
     return passAll;
 }
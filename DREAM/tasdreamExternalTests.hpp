@@ -168,6 +168,15 @@ protected:
     //! \brief Generate 2D Gaussian samples using DREAM and Sparse Grids.
     bool testGaussian2D();
 
+    //! \brief Test the counter-based random number generator and the reproducibility of the sampling.
+    bool testCounterRandom();
+
+    //! \brief Test the history thinning, the file sink and the lazy reader.
+    bool testHistorySinks();
+
+    //! \brief Test the online statistics of the history and the convergence diagnostics.
+    bool testHistoryStatistics();
+
     //! \brief Perform test for sampling from inferred posterior distributions.
     bool testPosteriorDistributions();
 
@@ -60,6 +60,107 @@ namespace TasDREAM{
 //! Generates random numbers uniformly distributed in (0, 1), uses the \b rand() command.
 inline double tsgCoreUniform01(){ return ((double) rand()) / ((double) RAND_MAX); }
 
+/*!
+ * \internal
+ * \ingroup DREAMPDF
+ * \brief Applies the Philox-4x32-10 bijection to the \b counter using the \b key, the result overwrites the counter.
+ *
+ * Implements the counter-based generator from Salmon, Moraes, Dror, Shaw,
+ * "Parallel random numbers: as easy as 1, 2, 3", SC 2011.
+ * \endinternal
+ */
+inline void philox4x32(std::array<std::uint32_t, 4> &counter, std::array<std::uint32_t, 2> key){
+    for(int round=0; round<10; round++){
+        std::uint64_t p0 = 0xD2511F53ull * (std::uint64_t) counter[0];
+        std::uint64_t p1 = 0xCD9E8D57ull * (std::uint64_t) counter[2];
+        counter = {{ (std::uint32_t) (p1 >> 32) ^ counter[1] ^ key[0], (std::uint32_t) p1,
+                     (std::uint32_t) (p0 >> 32) ^ counter[3] ^ key[1], (std::uint32_t) p0 }};
+        key[0] += 0x9E3779B9u;
+        key[1] += 0xBB67AE85u;
+    }
+}
+
+/*!
+ * \ingroup DREAMPDF
+ * \brief Counter-based random number generator, returns numbers uniformly distributed in (0, 1).
+ *
+ * The generator uses the Philox-4x32-10 algorithm and the sequence of numbers is uniquely defined
+ * by the triplet (seed, chain, iteration), i.e., there is no internal state shared between the streams.
+ * Different streams can be used by different threads without synchronization and the result
+ * of the sampling is reproducible regardless of the number of threads or the order of execution.
+ *
+ * The object can be used in place of any \b get_random01() function,
+ * e.g., applyUniformUpdate(), applyGaussianUpdate(), genUniformSamples() and genGaussianSamples(),
+ * and the overloads that accept the object by reference draw the random numbers in batches.
+ * The numbers have 53 bits of randomness and never reach 0 or 1, thus it is safe to take the logarithm.
+ */
+class CounterRandom01{
+public:
+    //! \brief Create the generator for the given \b seed and stream (\b chain, \b iteration).
+    CounterRandom01(unsigned long long random_seed = 0, int chain_index = 0, int iteration_index = 0)
+        : seed(random_seed), chain(chain_index), iteration(iteration_index), block(0), next(2){}
+
+    //! \brief Restart the generator at the beginning of the stream (\b chain, \b iteration), the seed is not modified.
+    void setStream(int chain_index, int iteration_index){
+        chain = chain_index;
+        iteration = iteration_index;
+        block = 0;
+        next = 2;
+    }
+    //! \brief Returns a new generator with the same seed and positioned at the beginning of the stream (\b chain, \b iteration).
+    CounterRandom01 getStream(int chain_index, int iteration_index) const{ return CounterRandom01(seed, chain_index, iteration_index); }
+
+    //! \brief Returns the seed.
+    unsigned long long getSeed() const{ return seed; }
+    //! \brief Returns the chain index of the current stream.
+    int getChain() const{ return chain; }
+    //! \brief Returns the iteration index of the current stream.
+    int getIteration() const{ return iteration; }
+
+    //! \brief Returns the next random number in the stream.
+    double operator()(){
+        if (next == 2){
+            generateBlock(buffer);
+            next = 0;
+        }
+        return buffer[next++];
+    }
+
+    //! \brief Writes the next \b num random numbers in \b x, the result is identical to calling operator() \b num times.
+    void fill(size_t num, double x[]){
+        while((next < 2) && (num > 0)){ *x++ = buffer[next++]; num--; }
+        while(num >= 2){
+            generateBlock(x);
+            x += 2;
+            num -= 2;
+        }
+        if (num > 0){
+            generateBlock(buffer);
+            *x = buffer[0];
+            next = 1;
+        }
+    }
+
+protected:
+    //! \brief Generates the next two random numbers in \b x.
+    void generateBlock(double x[]){
+        std::array<std::uint32_t, 4> counter = {{ (std::uint32_t) chain, (std::uint32_t) iteration, (std::uint32_t) block, (std::uint32_t) (block >> 32) }};
+        philox4x32(counter, {{ (std::uint32_t) seed, (std::uint32_t) (seed >> 32) }});
+        block++;
+        for(int i=0; i<2; i++){ // combine two 32-bit words into a 53-bit mantissa and shift by half a unit to exclude 0 and 1
+            std::uint64_t bits = ((((std::uint64_t) counter[2*i]) << 32) | ((std::uint64_t) counter[2*i+1])) >> 11;
+            x[i] = ((double) bits + 0.5) / 9007199254740992.0;
+        }
+    }
+
+private:
+    unsigned long long seed;
+    int chain, iteration;
+    unsigned long long block;
+    int next;
+    double buffer[2];
+};
+
 //! \brief Add a correction to every entry in \b x, use uniform samples over (-\b magnitude, \b magnitude).
 //! \ingroup DREAMPDF
 
@@ -69,6 +170,20 @@ inline void applyUniformUpdate(std::vector<double> &x, double magnitude, std::fu
     for(auto &v : x) v += magnitude * (2.0 * get_random01() -1.0);
 }
 
+/*!
+ * \ingroup DREAMPDF
+ * \brief Overload that draws the random numbers in a batch from a counter-based generator.
+ */
+inline void applyUniformUpdate(std::vector<double> &x, double magnitude, CounterRandom01 &random){
+    if (magnitude == 0.0) return;
+    double samples[64];
+    for(size_t i=0; i<x.size(); i+=64){
+        size_t num = std::min(x.size() - i, (size_t) 64);
+        random.fill(num, samples);
+        for(size_t j=0; j<num; j++) x[i+j] += magnitude * (2.0 * samples[j] - 1.0);
+    }
+}
+
 //! \brief  Add a correction to every entry in \b x, sue Gaussian distribution with zero mean and standard deviation equal to \b magnitude.
 //! \ingroup DREAMPDF
 
@@ -90,6 +205,27 @@ inline void applyGaussianUpdate(std::vector<double> &x, double magnitude, std::f
     }
 }
 
+/*!
+ * \ingroup DREAMPDF
+ * \brief Overload that draws the random numbers in a batch from a counter-based generator.
+ *
+ * The pairs of random numbers are used in the same order as the general applyGaussianUpdate(),
+ * hence the result is the same as calling the general overload with the same generator.
+ */
+inline void applyGaussianUpdate(std::vector<double> &x, double magnitude, CounterRandom01 &random){
+    if (magnitude == 0.0) return;
+    double samples[64];
+    for(size_t i=0; i<x.size(); i+=64){
+        size_t num = std::min(x.size() - i, (size_t) 64);
+        random.fill(num + num % 2, samples); // an odd tail still needs both the radius and the angle
+        for(size_t j=0; j<num; j+=2){
+            double r = magnitude * std::sqrt(-2.0 * std::log(samples[j])), t = 2.0 * DreamMaths::pi * samples[j+1]; // radius and angle
+            x[i+j] += r * std::cos(t);
+            if (j + 1 < num) x[i+j+1] += r * std::sin(t);
+        }
+    }
+}
+
 //! \brief Generate uniform random samples in the hypercube defined by \b lower and \b upper limits.
 //! \ingroup DREAMPDF
 
@@ -114,6 +250,25 @@ inline void genUniformSamples(const std::vector<double> &lower, const std::vecto
     }
 }
 
+/*!
+ * \ingroup DREAMPDF
+ * \brief Overload that draws the random numbers in a batch from a counter-based generator.
+ */
+inline void genUniformSamples(const std::vector<double> &lower, const std::vector<double> &upper, int num_samples, std::vector<double> &x, CounterRandom01 &random){
+    if (lower.size() != upper.size()) throw std::runtime_error("ERROR: genUniformSamples() requires lower and upper vectors with matching size.");
+    if (x.size() != lower.size() * num_samples) x.resize(lower.size() * num_samples);
+    random.fill(x.size(), x.data());
+
+    auto ix = x.begin();
+    while(ix != x.end()){
+        auto iu = upper.begin();
+        for(auto l : lower){
+            *ix = l + (*iu++ - l) * *ix;
+            ix++;
+        }
+    }
+}
+
 /*!
  * \ingroup DREAMPDF
  * \brief Overload that returns the vector.
@@ -149,6 +304,28 @@ inline void genGaussianSamples(const std::vector<double> &means, const std::vect
     }
 }
 
+/*!
+ * \ingroup DREAMPDF
+ * \brief Overload that draws the random numbers in a batch from a counter-based generator.
+ */
+inline void genGaussianSamples(const std::vector<double> &means, const std::vector<double> &deviations,
+                               int num_samples, std::vector<double> &x, CounterRandom01 &random){
+    if (means.size() != deviations.size()) throw std::runtime_error("ERROR: genGaussianSamples() means and deviations vectors must have the same size.");
+    if (x.size() != means.size() * num_samples) x.resize(means.size() * num_samples);
+
+    std::fill_n(x.data(), x.size(), 0.0);
+    applyGaussianUpdate(x, 1.0, random);
+
+    auto ix = x.begin();
+    while(ix != x.end()){
+        auto im = means.begin();
+        for(auto s : deviations){
+            *ix *= s;
+            *ix++ += *im++;
+        }
+    }
+}
+
 /*!
  * \ingroup DREAMPDF
  * \brief Overload that returns the vector.
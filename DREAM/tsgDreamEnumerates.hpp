@@ -32,6 +32,8 @@
 #define __TASMANIAN_DREAM_ENUMERATES_HPP
 
 #include <random>
+#include <array>
+#include <cstdint>
 
 #include "TasmanianSparseGrid.hpp"
 
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2017, Miroslav Stoyanov
+ *
+ * This file is part of
+ * Toolkit for Adaptive Stochastic Modeling And Non-Intrusive ApproximatioN: TASMANIAN
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * UT-BATTELLE, LLC AND THE UNITED STATES GOVERNMENT MAKE NO REPRESENTATIONS AND DISCLAIM ALL WARRANTIES, BOTH EXPRESSED AND IMPLIED.
+ * THERE ARE NO EXPRESS OR IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, OR THAT THE USE OF THE SOFTWARE WILL NOT INFRINGE ANY PATENT,
+ * COPYRIGHT, TRADEMARK, OR OTHER PROPRIETARY RIGHTS, OR THAT THE SOFTWARE WILL ACCOMPLISH THE INTENDED RESULTS OR THAT THE SOFTWARE OR ITS USE WILL NOT RESULT IN INJURY OR DAMAGE.
+ * THE USER ASSUMES RESPONSIBILITY FOR ALL LIABILITIES, PENALTIES, FINES, CLAIMS, CAUSES OF ACTION, AND COSTS AND EXPENSES, CAUSED BY, RESULTING FROM OR ARISING OUT OF,
+ * IN WHOLE OR IN PART THE USE, STORAGE OR DISPOSAL OF THE SOFTWARE.
+ */
+
+#ifndef __TASMANIAN_DREAM_HISTORY_CPP
+#define __TASMANIAN_DREAM_HISTORY_CPP
+
+#include "tsgDreamHistory.hpp"
+
+namespace TasDREAM{
+
+constexpr size_t dream_history_header_size = 3 * sizeof(char) + 2 * sizeof(int); // "TDH", num_chains, num_dimensions
+
+DreamHistoryFile::DreamHistoryFile(std::string const &filename, int num_chains, int num_dimensions, int chunk_snapshots) :
+    ofs(filename, std::ios::out | std::ios::binary | std::ios::trunc),
+    state_size(((size_t) num_chains) * ((size_t) num_dimensions)), snapshot_size(((size_t) num_chains) * ((size_t) num_dimensions + 1)), chunk_size((size_t) std::max(chunk_snapshots, 1)),
+    num_buffered(0), num_snapshots(0){
+    if (!ofs.good()) throw std::runtime_error(std::string("ERROR: cannot open the DREAM history file: ") + filename);
+    if ((num_chains < 1) || (num_dimensions < 1)) throw std::invalid_argument("ERROR: DreamHistoryFile, num_chains and num_dimensions must be positive");
+    ofs.write("TDH", 3 * sizeof(char));
+    TasGrid::IO::writeNumbers<TasGrid::mode_binary, TasGrid::IO::pad_none>(ofs, num_chains, num_dimensions);
+    buffer.resize(snapshot_size * chunk_size);
+}
+
+DreamHistoryFile::~DreamHistoryFile(){
+    try{
+        flush();
+    }catch(std::runtime_error &){} // destructors must not throw, call flush() explicitly to detect the error
+}
+
+void DreamHistoryFile::save(std::vector<double> const &state, std::vector<double> const &pdf_values){
+    if ((state.size() != state_size) || (pdf_values.size() != snapshot_size - state_size))
+        throw std::invalid_argument("ERROR: DreamHistoryFile::save(), the state and pdf values do not match the num_chains and num_dimensions of the file");
+    double *snapshot = &buffer[num_buffered * snapshot_size];
+    std::copy(state.begin(), state.end(), snapshot);
+    std::copy(pdf_values.begin(), pdf_values.end(), snapshot + state.size());
+    num_buffered++;
+    num_snapshots++;
+    if (num_buffered == chunk_size) flush();
+}
+
+void DreamHistoryFile::flush(){
+    if (num_buffered == 0) return;
+    ofs.write((char const*) buffer.data(), num_buffered * snapshot_size * sizeof(double));
+    ofs.flush();
+    if (!ofs.good()) throw std::runtime_error("ERROR: failed to write the snapshots to the DREAM history file");
+    num_buffered = 0;
+}
+
+DreamHistoryReader::DreamHistoryReader(std::string const &filename) : ifs(filename, std::ios::in | std::ios::binary), num_chains(0), num_dimensions(0), num_snapshots(0){
+    if (!ifs.good()) throw std::runtime_error(std::string("ERROR: cannot open the DREAM history file: ") + filename);
+    char tdh[3] = {' ', ' ', ' '};
+    ifs.read(tdh, 3 * sizeof(char));
+    if ((tdh[0] != 'T') || (tdh[1] != 'D') || (tdh[2] != 'H'))
+        throw std::runtime_error(std::string("ERROR: the file is not a DREAM history file: ") + filename);
+    num_chains     = TasGrid::IO::readNumber<TasGrid::mode_binary, int>(ifs);
+    num_dimensions = TasGrid::IO::readNumber<TasGrid::mode_binary, int>(ifs);
+    if (!ifs.good() || (num_chains < 1) || (num_dimensions < 1))
+        throw std::runtime_error(std::string("ERROR: corrupt header of the DREAM history file: ") + filename);
+
+    ifs.seekg(0, std::ios::end);
+    size_t num_bytes = (size_t) ifs.tellg() - dream_history_header_size;
+    num_snapshots = num_bytes / (((size_t) num_chains) * ((size_t) num_dimensions + 1) * sizeof(double));
+}
+
+void DreamHistoryReader::readSnapshots(size_t first, size_t num, std::vector<double> &history, std::vector<double> &pdf_history){
+    num = (first < num_snapshots) ? std::min(num, num_snapshots - first) : 0;
+    size_t state_size = ((size_t) num_chains) * ((size_t) num_dimensions);
+    history.resize(num * state_size);
+    pdf_history.resize(num * (size_t) num_chains);
+    if (num == 0) return;
+
+    ifs.clear();
+    ifs.seekg((std::streamoff) (dream_history_header_size + first * (state_size + (size_t) num_chains) * sizeof(double)), std::ios::beg);
+    for(size_t i=0; i<num; i++){
+        ifs.read((char*) &history[i * state_size], state_size * sizeof(double));
+        ifs.read((char*) &pdf_history[i * (size_t) num_chains], ((size_t) num_chains) * sizeof(double));
+    }
+    if (!ifs.good()) throw std::runtime_error("ERROR: failed to read the snapshots from the DREAM history file");
+}
+
+}
+
+#endif
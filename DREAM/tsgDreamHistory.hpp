@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2017, Miroslav Stoyanov
+ *
+ * This file is part of
+ * Toolkit for Adaptive Stochastic Modeling And Non-Intrusive ApproximatioN: TASMANIAN
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * UT-BATTELLE, LLC AND THE UNITED STATES GOVERNMENT MAKE NO REPRESENTATIONS AND DISCLAIM ALL WARRANTIES, BOTH EXPRESSED AND IMPLIED.
+ * THERE ARE NO EXPRESS OR IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, OR THAT THE USE OF THE SOFTWARE WILL NOT INFRINGE ANY PATENT,
+ * COPYRIGHT, TRADEMARK, OR OTHER PROPRIETARY RIGHTS, OR THAT THE SOFTWARE WILL ACCOMPLISH THE INTENDED RESULTS OR THAT THE SOFTWARE OR ITS USE WILL NOT RESULT IN INJURY OR DAMAGE.
+ * THE USER ASSUMES RESPONSIBILITY FOR ALL LIABILITIES, PENALTIES, FINES, CLAIMS, CAUSES OF ACTION, AND COSTS AND EXPENSES, CAUSED BY, RESULTING FROM OR ARISING OUT OF,
+ * IN WHOLE OR IN PART THE USE, STORAGE OR DISPOSAL OF THE SOFTWARE.
+ */
+
+#ifndef __TASMANIAN_DREAM_HISTORY_HPP
+#define __TASMANIAN_DREAM_HISTORY_HPP
+
+#include "tsgDreamEnumerates.hpp"
+
+/*!
+ * \internal
+ * \file tsgDreamHistory.hpp
+ * \brief Destinations for the DREAM history.
+ * \author Miroslav Stoyanov
+ * \ingroup TasmanianDREAM
+ *
+ * Defines the interface for the history sinks, the binary file writer and the lazy reader.
+ * \endinternal
+ */
+
+namespace TasDREAM{
+
+/*!
+ * \ingroup DREAMState
+ * \brief Interface for the classes that receive the history snapshots of a TasmanianDREAM state.
+ *
+ * By default, the TasmanianDREAM object stores the history in memory,
+ * a sink set with TasmanianDREAM::setHistorySink() receives the snapshots instead.
+ * Each snapshot consists of the state of all chains and the corresponding values of the probability density.
+ * Custom sinks can be implemented by inheriting from this class, e.g., to compress the data
+ * or to send the data over the network.
+ */
+class DreamHistorySink{
+public:
+    //! \brief Empty default constructor.
+    DreamHistorySink(){}
+    //! \brief Empty virtual destructor.
+    virtual ~DreamHistorySink(){}
+
+    //! \brief Receives the \b state of all chains (num_chains times num_dimensions) and the \b pdf_values (num_chains).
+    virtual void save(std::vector<double> const &state, std::vector<double> const &pdf_values) = 0;
+    //! \brief Hint that \b num_snapshots more snapshots will be saved, called by TasmanianDREAM::expandHistory().
+    virtual void expand(size_t num_snapshots){ (void) num_snapshots; }
+    //! \brief Write out any buffered data, called at the end of each SampleDREAM() call.
+    virtual void flush(){}
+};
+
+/*!
+ * \ingroup DREAMState
+ * \brief Writes the history into a binary file, the snapshots are buffered and written in chunks.
+ *
+ * The file starts with the characters "TDH" followed by the number of chains and dimensions as integers,
+ * followed by the snapshots with each snapshot holding the state of all chains and then the pdf values.
+ * All numbers are written in the native binary format of the machine.
+ * The file can be read back with DreamHistoryReader.
+ */
+class DreamHistoryFile : public DreamHistorySink{
+public:
+    /*!
+     * \brief Create a new file (or overwrite an existing one) for the given number of chains and dimensions.
+     *
+     * \param filename is the name of the file.
+     * \param num_chains is the number of chains of the state.
+     * \param num_dimensions is the number of dimensions of the state.
+     * \param chunk_snapshots is the number of snapshots kept in memory before writing to the file.
+     *
+     * \throws std::runtime_error if the file cannot be opened.
+     */
+    DreamHistoryFile(std::string const &filename, int num_chains, int num_dimensions, int chunk_snapshots = 64);
+    //! \brief Writes the remaining buffered snapshots and closes the file, write errors are ignored (see flush()).
+    ~DreamHistoryFile() override;
+
+    /*!
+     * \brief Adds the snapshot to the buffer and writes the buffer if full.
+     *
+     * \throws std::invalid_argument if the sizes of \b state and \b pdf_values do not match
+     *      the number of chains and dimensions given to the constructor.
+     */
+    void save(std::vector<double> const &state, std::vector<double> const &pdf_values) override;
+    /*!
+     * \brief Writes the buffered snapshots to the file.
+     *
+     * \throws std::runtime_error if the data cannot be written, e.g., the disk is full.
+     */
+    void flush() override;
+
+    //! \brief Returns the total number of saved snapshots, including the ones that are still in the buffer.
+    size_t getNumSnapshots() const{ return num_snapshots; }
+
+private:
+    std::ofstream ofs;
+    size_t state_size, snapshot_size, chunk_size;
+    size_t num_buffered, num_snapshots;
+    std::vector<double> buffer;
+};
+
+/*!
+ * \ingroup DREAMState
+ * \brief Reads a history file written by DreamHistoryFile, the snapshots are read on demand.
+ *
+ * Only the header is read on construction, hence even very large files
+ * can be processed in portions that fit in memory.
+ */
+class DreamHistoryReader{
+public:
+    /*!
+     * \brief Opens the file and reads the header.
+     *
+     * \throws std::runtime_error if the file cannot be opened or the header is not valid.
+     */
+    DreamHistoryReader(std::string const &filename);
+    //! \brief Default destructor.
+    ~DreamHistoryReader(){}
+
+    //! \brief Returns the number of chains.
+    int getNumChains() const{ return num_chains; }
+    //! \brief Returns the number of dimensions.
+    int getNumDimensions() const{ return num_dimensions; }
+    //! \brief Returns the number of snapshots in the file.
+    size_t getNumSnapshots() const{ return num_snapshots; }
+
+    /*!
+     * \brief Reads \b num snapshots starting with \b first, the result has the same format as TasmanianDREAM::getHistory().
+     *
+     * \param first is the index of the first snapshot to read.
+     * \param num is the number of snapshots to read, will be truncated to the number of snapshots in the file.
+     * \param history will be resized and overwritten with the states of the chains.
+     * \param pdf_history will be resized and overwritten with the pdf values.
+     *
+     * \throws std::runtime_error if reading from the file fails.
+     */
+    void readSnapshots(size_t first, size_t num, std::vector<double> &history, std::vector<double> &pdf_history);
+
+private:
+    std::ifstream ifs;
+    int num_chains, num_dimensions;
+    size_t num_snapshots;
+};
+
+}
+
+#endif
@@ -102,6 +102,111 @@ void LikelihoodGaussAnisotropic::getLikelihood(TypeSamplingForm form, double con
     if (form == regform) for(int i=0; i<num_samples; i++) likely[i] = std::exp(likely[i]);
 }
 
+void LikelihoodGaussSurrogate::setData(TasGrid::TasmanianSparseGrid const &model, double variance, std::vector<double> const &data_mean, size_t num_observe){
+    if (variance <= 0.0) throw std::invalid_argument("ERROR: LikelihoodGaussSurrogate, should have positive varience.");
+    setData(model, std::vector<double>(data_mean.size(), variance), data_mean, num_observe);
+}
+void LikelihoodGaussSurrogate::setData(TasGrid::TasmanianSparseGrid const &model, std::vector<double> const &variance, std::vector<double> const &data_mean, size_t num_observe){
+    if (variance.size() != data_mean.size()) throw std::invalid_argument("ERROR: LikelihoodGaussSurrogate, should have variance and data with same size.");
+    if (model.getNumLoaded() == 0) throw std::invalid_argument("ERROR: LikelihoodGaussSurrogate, the model grid has no loaded values.");
+    if (model.isFourier()) throw std::invalid_argument("ERROR: LikelihoodGaussSurrogate, cannot use a Fourier grid as a model.");
+    if (model.getNumOutputs() != (int) data_mean.size()) throw std::invalid_argument("ERROR: LikelihoodGaussSurrogate, the size of the data does not match the number of model outputs.");
+
+    grid = &model;
+    double scale = -0.5 * double(num_observe);
+    noise_variance = std::vector<double>(variance.size());
+    data_by_variance = std::vector<double>(variance.size());
+    for(size_t i=0; i<variance.size(); i++){
+        noise_variance[i] = scale / variance[i];
+        data_by_variance[i] = scale * data_mean[i] / variance[i];
+    }
+
+    int num_outputs = model.getNumOutputs();
+    int num_points = model.getNumPoints();
+    if (num_points > num_outputs){ // the gram matrix is too large, fall back to forming the outputs
+        projected_data = std::vector<double>();
+        gram = std::vector<double>();
+        return;
+    }
+
+    // the coefficients are stored point-by-point, i.e., as a num_outputs by num_points column-major matrix
+    const double *coeff = model.getHierarchicalCoefficients();
+    Utils::Wrapper2D<const double> wcoeff(num_outputs, coeff);
+    projected_data = std::vector<double>((size_t) num_points);
+    gram = std::vector<double>(Utils::size_mult(num_points, num_points));
+    std::vector<double> weighted(num_outputs);
+    for(int p=0; p<num_points; p++){
+        const double *c = wcoeff.getStrip(p);
+        for(int k=0; k<num_outputs; k++) weighted[k] = noise_variance[k] * c[k];
+        projected_data[p] = std::inner_product(c, c + num_outputs, data_by_variance.data(), 0.0);
+        #ifdef Tasmanian_ENABLE_BLAS
+        TasBLAS::dgemtv(num_outputs, num_points, coeff, weighted.data(), &gram[Utils::size_mult(p, num_points)]);
+        #else
+        for(int q=0; q<=p; q++){ // the gram matrix is symmetric
+            gram[Utils::size_mult(p, num_points) + q] = std::inner_product(weighted.begin(), weighted.end(), wcoeff.getStrip(q), 0.0);
+            gram[Utils::size_mult(q, num_points) + p] = gram[Utils::size_mult(p, num_points) + q];
+        }
+        #endif
+    }
+}
+
+void LikelihoodGaussSurrogate::getLikelihood(TypeSamplingForm form, std::vector<double> const &candidates, std::vector<double> &likely) const{
+    if (grid == nullptr) throw std::runtime_error("ERROR: LikelihoodGaussSurrogate, must call setData() before getLikelihood().");
+    int num_samples = (int) likely.size();
+    if (num_samples == 0) return;
+
+    if (gram.empty()){
+        std::vector<double> model;
+        grid->evaluateBatch(candidates, model);
+        int num_outputs = getNumOutputs();
+        Utils::Wrapper2D<const double> wrapped_model(num_outputs, model.data());
+        for(int i=0; i<num_samples; i++){
+            const double *sample = wrapped_model.getStrip(i);
+            likely[i] = 0.0;
+            for(int k=0; k<num_outputs; k++)
+                likely[i] += sample[k] * sample[k] * noise_variance[k] - 2.0 * sample[k] * data_by_variance[k];
+        }
+    }else{
+        size_t num_points = projected_data.size();
+        // the likelihood of a single sample, uses only the non-zero basis functions
+        auto quadratic_form = [&](int const indx[], double const vals[], int num_nz)->double{
+            double result = 0.0;
+            for(int a=0; a<num_nz; a++){
+                double const *grow = &gram[((size_t) indx[a]) * num_points];
+                double sum = 0.0;
+                for(int b=0; b<num_nz; b++) sum += grow[indx[b]] * vals[b];
+                result += vals[a] * (sum - 2.0 * projected_data[indx[a]]);
+            }
+            return result;
+        };
+        if (grid->isLocalPolynomial()){
+            std::vector<int> pntr, indx;
+            std::vector<double> vals;
+            grid->evaluateSparseHierarchicalFunctions(candidates, pntr, indx, vals);
+            for(int i=0; i<num_samples; i++)
+                likely[i] = quadratic_form(&indx[pntr[i]], &vals[pntr[i]], pntr[i+1] - pntr[i]);
+        }else{
+            std::vector<double> basis;
+            grid->evaluateHierarchicalFunctions(candidates, basis);
+            std::vector<int> indx(num_points);
+            std::vector<double> vals(num_points);
+            Utils::Wrapper2D<const double> wbasis((int) num_points, basis.data());
+            for(int i=0; i<num_samples; i++){
+                int num_nz = 0;
+                const double *phi = wbasis.getStrip(i);
+                for(size_t p=0; p<num_points; p++){
+                    if (phi[p] != 0.0){
+                        indx[num_nz] = (int) p;
+                        vals[num_nz++] = phi[p];
+                    }
+                }
+                likely[i] = quadratic_form(indx.data(), vals.data(), num_nz);
+            }
+        }
+    }
+    if (form == regform) for(auto &l : likely) l = std::exp(l);
+}
+
 extern "C"{ // for python purposes
 void *tsgMakeLikelihoodGaussIsotropic(int num_outputs, double variance, double const data[], int num_samples){
     return (void*) new LikelihoodGaussIsotropic(variance, std::vector<double>(data, data + num_outputs), (size_t) num_samples);
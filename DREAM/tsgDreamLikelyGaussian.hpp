@@ -192,6 +192,72 @@ private:
     std::vector<double> noise_variance;
 };
 
+/*!
+ * \brief Implements Gaussian likelihood fused with a sparse grid surrogate model.
+ * \ingroup DREAMLikelihood
+ *
+ * \par Fused Surrogate Likelihood
+ * If the model is a sparse grid with hierarchical functions \f$ \phi_p \f$ and coefficients \f$ c_p \f$,
+ * then the model output is \f$ y = \sum_p \phi_p(x) c_p = C^T \phi \f$ and the (anisotropic) Gaussian log-likelihood
+ * \f$ y^T W y - 2 y^T W d \f$ (with \f$ W = -0.5 n \Sigma^{-1} \f$) becomes
+ * \f$ \phi^T (C W C^T) \phi - 2 \phi^T (C W d) \f$.
+ * The matrix \f$ G = C W C^T \f$ and the vector \f$ b = C W d \f$ do not depend on \b x and are computed once by setData(),
+ * then the likelihood of each candidate costs one quadratic form in the non-zero basis functions
+ * and the model outputs are never formed.
+ *
+ * The matrix \b G has size equal to the square of the number of grid points, thus it is computed only if the grid
+ * has no more points than outputs; otherwise the likelihood falls back to TasGrid::TasmanianSparseGrid::evaluateBatch()
+ * followed by the formula of LikelihoodGaussAnisotropic.
+ *
+ * The object holds a reference to the grid which must remain alive while the likelihood is in use,
+ * and setData() must be called again if the loaded values of the grid change.
+ * Fourier grids are not supported, since the hierarchical coefficients are complex.
+ *
+ * Example:
+ * \code
+ *  auto model = TasGrid::read("foo");
+ *  TasDREAM::LikelihoodGaussSurrogate likely(model, 0.1, data);
+ *  TasDREAM::SampleDREAM<TasDREAM::logform>(..., TasDREAM::posterior<TasDREAM::logform>(likely, TasDREAM::uniform_prior), ...);
+ * \endcode
+ */
+class LikelihoodGaussSurrogate{
+public:
+    //! \brief Default constructor for convenience, an object constructed with the default cannot be used until \b setData() is called.
+    LikelihoodGaussSurrogate() : grid(nullptr){}
+    //! \brief Constructs the class and calls \b setData() with isotropic noise.
+    LikelihoodGaussSurrogate(TasGrid::TasmanianSparseGrid const &model, double variance, std::vector<double> const &data_mean, size_t num_observe = 1)
+        : grid(nullptr){ setData(model, variance, data_mean, num_observe); }
+    //! \brief Constructs the class and calls \b setData() with anisotropic noise.
+    LikelihoodGaussSurrogate(TasGrid::TasmanianSparseGrid const &model, std::vector<double> const &variance, std::vector<double> const &data_mean, size_t num_observe = 1)
+        : grid(nullptr){ setData(model, variance, data_mean, num_observe); }
+    //! \brief Default destructor.
+    ~LikelihoodGaussSurrogate(){}
+
+    /*!
+     * \brief Set the surrogate \b model, the noise and the data, see LikelihoodGaussIsotropic::setData().
+     *
+     * \throws std::invalid_argument if the grid has no loaded values, is a Fourier grid,
+     *      or if the number of outputs does not match the size of \b data_mean.
+     */
+    void setData(TasGrid::TasmanianSparseGrid const &model, double variance, std::vector<double> const &data_mean, size_t num_observe = 1);
+    //! \brief Overload using anisotropic noise, see LikelihoodGaussAnisotropic::setData().
+    void setData(TasGrid::TasmanianSparseGrid const &model, std::vector<double> const &variance, std::vector<double> const &data_mean, size_t num_observe = 1);
+
+    //! \brief Compute the likelihood of a set of \b candidates (model inputs), \b likely must have size equal to the number of candidates.
+    void getLikelihood(TypeSamplingForm form, std::vector<double> const &candidates, std::vector<double> &likely) const;
+
+    //! \brief Returns the number of model outputs.
+    int getNumOutputs() const{ return (int) noise_variance.size(); }
+    //! \brief Returns \b true if the fused formula is used, i.e., the model outputs are not formed.
+    bool isFused() const{ return !gram.empty(); }
+
+private:
+    TasGrid::TasmanianSparseGrid const *grid;
+    std::vector<double> noise_variance, data_by_variance; // same as in LikelihoodGaussAnisotropic, used by the fall back mode
+    std::vector<double> projected_data; // b = C W d
+    std::vector<double> gram; // G = C W C^T
+};
+
 
 }
 
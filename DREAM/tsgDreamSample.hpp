@@ -34,6 +34,7 @@
 #include "tsgDreamState.hpp"
 #include "tsgDreamCoreRandom.hpp"
 #include "tsgDreamCorePDF.hpp"
+#include "tsgDreamLikelyGaussian.hpp"
 
 /*!
  * \internal
@@ -309,6 +310,147 @@ DreamPDF posterior(DreamMergedLikelyModel likelihood_model,
     };
 }
 
+/*!
+ * \ingroup DREAMSampleCore
+ * \brief Overload that uses a likelihood fused with a sparse grid surrogate, see TasDREAM::LikelihoodGaussSurrogate.
+ *
+ * The \b likelihood is captured by reference and must remain alive during the sampling.
+ */
+template<TypeSamplingForm form = regform>
+DreamPDF posterior(LikelihoodGaussSurrogate const &likelihood,
+          DreamPrior prior){
+    return posterior<form>([&](const std::vector<double> &candidates, std::vector<double> &values)->void{
+        likelihood.getLikelihood(form, candidates, values);
+    }, prior);
+}
+
+
+/*!
+ * \internal
+ * \ingroup DREAMSampleCore
+ * \brief Implements the DREAM iterations, the random numbers and the independent updates are associated with a chain.
+ *
+ * The \b get_random01(i) returns the next random number for chain \b i,
+ * \b independent_update(i, x) perturbs the proposal \b x of chain \b i,
+ * and \b start_iteration(t) is called at the beginning of iteration \b t.
+ * The per-chain signatures allow the use of independent streams of random numbers, e.g., CounterRandom01.
+ *
+ * If \b parallel_chains is \b true and the \b state has an executor, the proposals and the acceptance tests
+ * are computed in parallel, which requires that the chain functions are thread-safe for different chains.
+ * The work vectors are allocated once per call and the new state is written into the double-buffer
+ * of the \b state, which is swapped (not copied) at the end of each iteration.
+ * \endinternal
+ */
+template<TypeSamplingForm form, class ChainUpdate, class ChainRandom, class IterationStart>
+void SampleDREAMChains(int num_burnup, int num_collect,
+                       DreamPDF &probability_distribution,
+                       DreamDomain &inside,
+                       TasmanianDREAM &state,
+                       ChainUpdate &&independent_update,
+                       std::function<double(void)> &differential_update,
+                       ChainRandom &&get_random01,
+                       IterationStart &&start_iteration,
+                       bool parallel_chains){
+
+    size_t num_chains = (size_t) state.getNumChains(), num_dimensions = (size_t) state.getNumDimensions();
+    double unitlength = (double) num_chains;
+
+    if (num_chains == 0) return; // no sampling with a null state
+
+    if (!state.isStateReady()) throw std::runtime_error("ERROR: DREAM sampling requires that the setState() has been called first on the TasmanianDREAM.");
+
+    if (!state.isPDFReady()) // initialize probability density (if not initialized already)
+        state.setPDFvalues(probability_distribution);
+
+    if (num_collect > 0) // pre-allocate memory for the new history
+        state.expandHistory(num_collect);
+
+    // all work vectors are allocated once and reused in all iterations
+    std::vector<double> candidates(num_chains * num_dimensions), values(num_chains);
+    std::vector<std::vector<double>> proposals(num_chains, std::vector<double>(num_dimensions));
+    std::vector<int> valid(num_chains); // keep track whether the samples need to be evaluated and later if accepted
+    std::vector<size_t> value_index(num_chains); // the index of the value of each valid candidate
+    state.prepareNextState();
+
+    // if parallel, process the chains in blocks using the executor of the state, otherwise go over the chains in order
+    constexpr size_t chains_per_task = 32;
+    bool use_executor = parallel_chains && state.isUsingExecutor();
+    auto for_each_chain = [&](std::function<void(size_t)> const &chain_work)->void{
+        if (use_executor){
+            TasGrid::Utils::runExecutorTasks(state.getExecutor(), (int) ((num_chains + chains_per_task - 1) / chains_per_task), [&](int task)->void{
+                size_t chain_end = std::min(num_chains, (size_t) (task + 1) * chains_per_task);
+                for(size_t i = (size_t) task * chains_per_task; i < chain_end; i++) chain_work(i);
+            });
+        }else{
+            for(size_t i=0; i<num_chains; i++) chain_work(i);
+        }
+    };
+
+    int total_iterations = std::max(num_burnup, 0) + std::max(num_collect, 0);
+    for(int t = 0; t < total_iterations; t++){
+        start_iteration(t);
+
+        for_each_chain([&](size_t i)->void{
+            std::vector<double> &propose = proposals[i];
+
+            size_t jindex = (size_t) (get_random01(i) * unitlength);
+            size_t kindex = (size_t) (get_random01(i) * unitlength);
+            if (jindex >= num_chains) jindex = num_chains - 1; // this is needed in case get_random01() returns 1
+            if (kindex >= num_chains) jindex = num_chains - 1;
+
+            state.getIJKdelta(i, jindex, kindex, differential_update(), propose); // propose = s_i + w ( s_k - s_j)
+            independent_update(i, propose); // propose += correction
+
+            valid[i] = (inside(propose)) ? 1 : 0;
+        });
+
+        size_t num_valid = 0; // pack the valid proposals into the candidates
+        candidates.resize(num_chains * num_dimensions);
+        for(size_t i=0; i<num_chains; i++){
+            if (valid[i] == 1){
+                std::copy_n(proposals[i].begin(), num_dimensions, candidates.begin() + num_valid * num_dimensions);
+                value_index[i] = num_valid++;
+            }
+        }
+        candidates.resize(num_valid * num_dimensions); // shrinking or growing within the capacity does not allocate
+        values.resize(num_valid);
+
+        if (!candidates.empty()) // block the pathological case of all proposals leaving the domain
+            probability_distribution(candidates, values);
+
+        for_each_chain([&](size_t i)->void{
+            bool keep_new = (valid[i] == 1); // if not valid, automatically reject
+            if (keep_new){ // apply random test
+                double new_value = values[value_index[i]];
+                if (new_value > state.getPDFvalue(i)){ // if the new value has higher probability, automatically accept
+                    keep_new = true;
+                }else{
+                    if (form == regform){
+                        keep_new = (new_value / state.getPDFvalue(i) >= get_random01(i)); // keep if the new value has higher probability
+                    }else{
+                        keep_new = (new_value - state.getPDFvalue(i) >= log(get_random01(i)));
+                    }
+                }
+            }
+
+            if (keep_new){
+                std::copy_n(proposals[i].begin(), num_dimensions, state.getNextChainState(i));
+                state.setNextPDFvalue(i, values[value_index[i]]);
+            }else{ // reject and reuse the old state
+                state.getChainState(i, state.getNextChainState(i));
+                state.setNextPDFvalue(i, state.getPDFvalue(i));
+            }
+            valid[i] = (keep_new) ? 1 : 0;
+        });
+
+        state.swapNextState();
+
+        if (t >= num_burnup)
+            state.saveStateHistory((size_t) std::count(valid.begin(), valid.end(), 1));
+    }
+
+    state.flushHistory();
+}
 
 /*!
  * \brief Core template for the sampling algorithm.
@@ -422,93 +564,11 @@ void SampleDREAM(int num_burnup, int num_collect,
                  std::function<void(std::vector<double> &x)> independent_update = no_update,
                  std::function<double(void)> differential_update = const_one,
                  std::function<double(void)> get_random01 = tsgCoreUniform01){
-
-    size_t num_chains = (size_t) state.getNumChains(), num_dimensions = (size_t) state.getNumDimensions();
-    double unitlength = (double) num_chains;
-
-    if (num_chains == 0) return; // no sampling with a null state
-
-    if (!state.isStateReady()) throw std::runtime_error("ERROR: DREAM sampling requires that the setState() has been called first on the TasmanianDREAM.");
-
-    if (!state.isPDFReady()) // initialize probability density (if not initialized already)
-        state.setPDFvalues(probability_distribution);
-
-    if (num_collect > 0) // pre-allocate memory for the new history
-        state.expandHistory(num_collect);
-
-    int total_iterations = std::max(num_burnup, 0) + std::max(num_collect, 0);
-    for(int t = 0; t < total_iterations; t++){
-        std::vector<double> candidates, values;
-        candidates.reserve(num_chains * num_dimensions);
-        values.reserve(num_chains);
-
-        std::vector<bool> valid(num_chains, true); // keep track whether the samples need to be evaluated
-
-        for(size_t i=0; i<num_chains; i++){
-            std::vector<double> propose(num_dimensions);
-
-            size_t jindex = (size_t) (get_random01() * unitlength);
-            size_t kindex = (size_t) (get_random01() * unitlength);
-            if (jindex >= num_chains) jindex = num_chains - 1; // this is needed in case get_random01() returns 1
-            if (kindex >= num_chains) jindex = num_chains - 1;
-
-            state.getIJKdelta(i, jindex, kindex, differential_update(), propose); // propose = s_i + w ( s_k - s_j)
-            independent_update(propose); // propose += correction
-
-            if (inside(propose)){
-                candidates.insert(candidates.end(), propose.begin(), propose.end());
-                values.resize(values.size() + 1);
-            }else{
-                valid[i] = false;
-            }
-        }
-
-        if (!candidates.empty()) // block the pathological case of all proposals leaving the domain
-            probability_distribution(candidates, values);
-
-        std::vector<double> new_state(num_chains * num_dimensions), new_values(num_chains);
-
-        auto icand = candidates.begin(); // loop over all candidates and values, accept or reject
-        auto ival = values.begin();
-
-        size_t accepted = 0;
-
-        for(size_t i=0; i<num_chains; i++){
-            bool keep_new = valid[i]; // if not valid, automatically reject
-            if (valid[i]){ // apply random test
-                if (*ival > state.getPDFvalue(i)){ // if the new value has higher probability, automatically accept
-                    keep_new = true;
-                }else{
-                    if (form == regform){
-                        keep_new = (*ival / state.getPDFvalue(i) >= get_random01()); // keep if the new value has higher probability
-                    }else{
-                        keep_new = (*ival - state.getPDFvalue(i) >= log(get_random01()));
-                    }
-                    //std::cout << "Trsh = " << *ival / state.getPDFvalue(i) << "   " << ((keep_new) ? "Accept" : "Reject") << std:: endl;
-                }
-            }
-
-            if (keep_new){
-                std::copy_n(icand, num_dimensions, new_state.begin() + i * num_dimensions);
-                new_values[i] = *ival;
-                accepted++; // accepted one more proposal
-            }else{ // reject and reuse the old state
-                state.getChainState((int) i, &*(new_state.begin() + i * num_dimensions));
-                new_values[i] = state.getPDFvalue(i);
-            }
-
-            if (valid[i]){ // kept or rejected, if this sample was valid then move to the next sample in the list
-                std::advance(icand, num_dimensions);
-                ival++;
-            }
-        }
-
-        state.setState(new_state);
-        state.setPDFvalues(new_values);
-
-        if (t >= num_burnup)
-            state.saveStateHistory(accepted);
-    }
+    SampleDREAMChains<form>(num_burnup, num_collect, probability_distribution, inside, state,
+                            [&](size_t, std::vector<double> &x)->void{ independent_update(x); },
+                            differential_update,
+                            [&](size_t)->double{ return get_random01(); },
+                            [](int)->void{}, false);
 }
 
 
@@ -540,6 +600,50 @@ void SampleDREAM(int num_burnup, int num_collect,
     }
 }
 
+/*!
+ * \ingroup DREAMSampleCore
+ * \brief Overload of \b SampleDREAM() that uses a counter-based generator with an independent stream for each chain and iteration.
+ *
+ * The random numbers for chain \b i at iteration \b t are drawn from the stream
+ * (\b random.getSeed(), \b i, \b random.getIteration() + \b t), which includes the selection of the chains
+ * for the differential update, the independent update and the acceptance test.
+ * Hence, the samples are independent of the order in which the chains are processed
+ * and the result is bit-reproducible for a given seed.
+ * On exit, the iteration of \b random is advanced by the total number of iterations,
+ * so that subsequent calls with the same \b random object continue with new streams.
+ *
+ * The \b differential_update is called once per chain and should be deterministic (e.g., const_percent())
+ * or otherwise the results will not be reproducible.
+ *
+ * If the \b state has an executor, see TasmanianDREAM::setExecutor(), the chains are processed in parallel
+ * and the result is identical to the sequential mode.
+ */
+template<TypeSamplingForm form = regform>
+void SampleDREAM(int num_burnup, int num_collect,
+                 DreamPDF probability_distribution,
+                 DreamDomain inside,
+                 TasmanianDREAM &state,
+                 TypeDistribution dist, double magnitude,
+                 std::function<double(void)> differential_update,
+                 CounterRandom01 &random){
+    if ((dist != dist_uniform) && (dist != dist_gaussian)) magnitude = 0.0; // assuming none
+    std::vector<CounterRandom01> streams((size_t) state.getNumChains(), random);
+    SampleDREAMChains<form>(num_burnup, num_collect, probability_distribution, inside, state,
+                            [&](size_t i, std::vector<double> &x)->void{
+                                if (dist == dist_uniform){
+                                    applyUniformUpdate(x, magnitude, streams[i]);
+                                }else{
+                                    applyGaussianUpdate(x, magnitude, streams[i]);
+                                }
+                            },
+                            differential_update,
+                            [&](size_t i)->double{ return streams[i](); },
+                            [&](int t)->void{
+                                for(size_t i=0; i<streams.size(); i++) streams[i].setStream((int) i, random.getIteration() + t);
+                            }, true);
+    random.setStream(random.getChain(), random.getIteration() + std::max(num_burnup, 0) + std::max(num_collect, 0));
+}
+
 }
 
 #endif
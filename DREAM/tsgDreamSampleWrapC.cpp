@@ -76,20 +76,28 @@ void tsgGenUniformSamples(int num_dimensions, int num_samples, double const lowe
     srand((unsigned int) ((random_seed == -1) ? static_cast<long unsigned>(std::time(nullptr)) : random_seed));
     std::string rtype(random_type);
 
+    CounterRandom01 philox((random_seed == -1) ? static_cast<unsigned long long>(std::time(nullptr)) : (unsigned long long) random_seed);
     auto randgen = [&]()->
     std::function<double(void)>{
         if (rtype == "default"){
             return [&]()->double{ return tsgCoreUniform01(); };
         }else if (rtype == "minstd_rand"){
             return [&]()->double{ return unif(park_miller); };
+        }else if (rtype == "philox"){
+            return [&]()->double{ return philox(); };
         }else{
             return [&]()->double{ return random_callback(); };
         }
     }();
 
-    std::vector<double> result = TasDREAM::genUniformSamples(Utils::copyArray(lower, num_dimensions),
-                                                             Utils::copyArray(upper, num_dimensions),
-                                                             num_samples, randgen);
+    std::vector<double> result;
+    if (rtype == "philox"){
+        TasDREAM::genUniformSamples(Utils::copyArray(lower, num_dimensions), Utils::copyArray(upper, num_dimensions), num_samples, result, philox);
+    }else{
+        result = TasDREAM::genUniformSamples(Utils::copyArray(lower, num_dimensions),
+                                             Utils::copyArray(upper, num_dimensions),
+                                             num_samples, randgen);
+    }
     std::copy(result.begin(), result.end(), samples);
 }
 
@@ -101,20 +109,28 @@ void tsgGenGaussianSamples(int num_dimensions, int num_samples, double const mea
     srand((unsigned int) ((random_seed == -1) ? static_cast<long unsigned>(std::time(nullptr)) : random_seed));
     std::string rtype(random_type);
 
+    CounterRandom01 philox((random_seed == -1) ? static_cast<unsigned long long>(std::time(nullptr)) : (unsigned long long) random_seed);
     auto randgen = [&]()->
     std::function<double(void)>{
         if (rtype == "default"){
             return [&]()->double{ return tsgCoreUniform01(); };
         }else if (rtype == "minstd_rand"){
             return [&]()->double{ return unif(park_miller); };
+        }else if (rtype == "philox"){
+            return [&]()->double{ return philox(); };
         }else{
             return [&]()->double{ return random_callback(); };
         }
     }();
 
-    std::vector<double> result = TasDREAM::genGaussianSamples(Utils::copyArray(mean, num_dimensions),
-                                                              Utils::copyArray(deviation, num_dimensions),
-                                                              num_samples, randgen);
+    std::vector<double> result;
+    if (rtype == "philox"){
+        TasDREAM::genGaussianSamples(Utils::copyArray(mean, num_dimensions), Utils::copyArray(deviation, num_dimensions), num_samples, result, philox);
+    }else{
+        result = TasDREAM::genGaussianSamples(Utils::copyArray(mean, num_dimensions),
+                                              Utils::copyArray(deviation, num_dimensions),
+                                              num_samples, randgen);
+    }
     std::copy(result.begin(), result.end(), samples);
 }
 
@@ -141,12 +157,15 @@ void tsgDreamSample(int form,
     srand((unsigned int) ((random_seed == -1) ? static_cast<long unsigned>(std::time(nullptr)) : random_seed));
     std::string rtype(random_type);
 
+    CounterRandom01 philox((random_seed == -1) ? static_cast<unsigned long long>(std::time(nullptr)) : (unsigned long long) random_seed);
     auto randgen = [&]()->
     std::function<double(void)>{
         if (rtype == "default"){
             return [&]()->double{ return tsgCoreUniform01(); };
         }else if (rtype == "minstd_rand"){
             return [&]()->double{ return unif(park_miller); };
+        }else if (rtype == "philox"){
+            return [&]()->double{ return philox(); };
         }else{
             return [&]()->double{ return random_callback(); };
         }
@@ -172,6 +191,20 @@ void tsgDreamSample(int form,
                 iupdate_callback((int) x.size(), x.data());
             }, diff_update, randgen);
         }
+    }else if (rtype == "philox"){ // independent stream for each chain and iteration
+        if (IO::intToForm(form) == regform){
+            SampleDREAM<regform>(num_burnup, num_collect, [&](const std::vector<double> &candidates, std::vector<double> &values)->
+            void{
+                int num_samples = (int) candidates.size() / num_dimensions;
+                distribution(num_samples, num_dimensions, candidates.data(), values.data());
+            }, domain, state, dist, iupdate_magnitude, diff_update, philox);
+        }else{
+            SampleDREAM<logform>(num_burnup, num_collect, [&](const std::vector<double> &candidates, std::vector<double> &values)->
+            void{
+                int num_samples = (int) candidates.size() / num_dimensions;
+                distribution(num_samples, num_dimensions, candidates.data(), values.data());
+            }, domain, state, dist, iupdate_magnitude, diff_update, philox);
+        }
     }else{
         if (IO::intToForm(form) == regform){
             SampleDREAM<regform>(num_burnup, num_collect, [&](const std::vector<double> &candidates, std::vector<double> &values)->
@@ -35,15 +35,18 @@
 
 namespace TasDREAM{
 
-TasmanianDREAM::TasmanianDREAM() : num_chains(0), num_dimensions(0), init_state(false), init_values(false), accepted(0){}
+TasmanianDREAM::TasmanianDREAM() : num_chains(0), num_dimensions(0), init_state(false), init_values(false), accepted(0), num_proposals(0),
+                                     thinning_stride(1), num_snapshots(0), num_saved(0), mode_pdf(0.0){}
 
 TasmanianDREAM::TasmanianDREAM(int cnum_chains, int cnum_dimensions) :
-num_chains(cnum_chains), num_dimensions(cnum_dimensions), init_state(false), init_values(false), accepted(0){
+num_chains(cnum_chains), num_dimensions(cnum_dimensions), init_state(false), init_values(false), accepted(0), num_proposals(0),
+thinning_stride(1), num_snapshots(0), num_saved(0), mode_pdf(0.0){
     if (cnum_chains < 1) throw std::invalid_argument("ERROR: num_chains must be positive");
     if (cnum_dimensions < 1) throw std::invalid_argument("ERROR: num_dimensions must be positive");
 }
 TasmanianDREAM::TasmanianDREAM(int cnum_chains, const TasGrid::TasmanianSparseGrid &grid) :
-num_chains(cnum_chains), num_dimensions(grid.getNumDimensions()), init_state(false), init_values(false), accepted(0){
+num_chains(cnum_chains), num_dimensions(grid.getNumDimensions()), init_state(false), init_values(false), accepted(0), num_proposals(0),
+thinning_stride(1), num_snapshots(0), num_saved(0), mode_pdf(0.0){
     if (cnum_chains < 1) throw std::invalid_argument("ERROR: num_chains must be positive");
     if (grid.getNumDimensions() < 1) throw std::invalid_argument("ERROR: num_dimensions must be positive");
 }
@@ -92,54 +95,191 @@ void TasmanianDREAM::getIJKdelta(size_t i, size_t j, size_t k, double w, std::ve
     }
 }
 
-void TasmanianDREAM::expandHistory(int num_snapshots){
-    history.reserve(history.size() + num_snapshots * num_dimensions * num_chains);
-    pdf_history.reserve(pdf_history.size() + num_snapshots * num_chains);
+void TasmanianDREAM::expandHistory(int num_new_snapshots){
+    size_t num_new = (((size_t) num_new_snapshots) + thinning_stride - 1) / thinning_stride;
+    if (history_sink){
+        history_sink->expand(num_new);
+    }else{
+        history.reserve(history.size() + num_new * num_dimensions * num_chains);
+        pdf_history.reserve(pdf_history.size() + num_new * num_chains);
+    }
 }
 
 void TasmanianDREAM::saveStateHistory(size_t num_accepted){
-    history.insert(history.end(), state.begin(), state.end());
-    pdf_history.insert(pdf_history.end(), pdf_values.begin(), pdf_values.end());
     accepted += num_accepted;
+    num_proposals += num_chains;
+    if ((num_snapshots++ % thinning_stride) != 0) return; // thinned out
+    updateStatistics();
+    if (history_sink){
+        history_sink->save(state, pdf_values);
+    }else{
+        history.insert(history.end(), state.begin(), state.end());
+        pdf_history.insert(pdf_history.end(), pdf_values.begin(), pdf_values.end());
+    }
+}
+
+void TasmanianDREAM::setHistoryThinning(int stride){
+    if (stride < 1) throw std::invalid_argument("ERROR: the history thinning stride must be positive");
+    thinning_stride = (size_t) stride;
+}
+
+void TasmanianDREAM::updateStatistics(){
+    if (num_saved == 0){
+        history_mean = std::vector<double>(num_dimensions, 0.0);
+        history_scatter = std::vector<double>(num_dimensions * num_dimensions, 0.0);
+        chain_means = std::vector<double>(num_chains * num_dimensions, 0.0);
+        chain_scatter = std::vector<double>(num_chains * num_dimensions, 0.0);
+        mode_sample = std::vector<double>(num_dimensions, 0.0);
+        snapshot_mean.resize(num_dimensions);
+        snapshot_deviations.resize((num_chains + 1) * num_dimensions);
+        mode_pdf = pdf_values[0];
+        std::copy_n(state.begin(), num_dimensions, mode_sample.begin());
+    }
+
+    // per-chain statistics, Welford's update with one new sample per chain
+    num_saved++;
+    double inv_count = 1.0 / ((double) num_saved);
+    for(size_t i=0; i<num_chains * num_dimensions; i++){
+        double delta = state[i] - chain_means[i];
+        chain_means[i] += delta * inv_count;
+        chain_scatter[i] += delta * (state[i] - chain_means[i]);
+    }
+
+    // global statistics, merge the mean and scatter of the snapshot with the accumulated values (Chan et al.)
+    std::fill(snapshot_mean.begin(), snapshot_mean.end(), 0.0);
+    for(size_t c=0; c<num_chains; c++)
+        for(size_t j=0; j<num_dimensions; j++) snapshot_mean[j] += state[c * num_dimensions + j];
+    for(auto &m : snapshot_mean) m /= (double) num_chains;
+
+    // the deviations from the snapshot mean are stored by dimension, the extra row is the scaled shift of the mean
+    // then the merged scatter is a single symmetric rank update with the num_chains + 1 rows
+    double count_old = (double) ((num_saved - 1) * num_chains), count_new = (double) num_chains;
+    double weight = std::sqrt(count_old * count_new / (count_old + count_new));
+    size_t num_rows = num_chains + 1;
+    for(size_t j=0; j<num_dimensions; j++){
+        double *deviation = &snapshot_deviations[j * num_rows];
+        for(size_t c=0; c<num_chains; c++) deviation[c] = state[c * num_dimensions + j] - snapshot_mean[j];
+        deviation[num_chains] = weight * (snapshot_mean[j] - history_mean[j]);
+        history_mean[j] += (snapshot_mean[j] - history_mean[j]) * count_new / (count_old + count_new);
+    }
+    for(size_t j=0; j<num_dimensions; j++){
+        double const *deviation_j = &snapshot_deviations[j * num_rows];
+        for(size_t k=j; k<num_dimensions; k++){
+            double const *deviation_k = &snapshot_deviations[k * num_rows];
+            double sum = 0.0;
+            for(size_t r=0; r<num_rows; r++) sum += deviation_j[r] * deviation_k[r];
+            history_scatter[j * num_dimensions + k] += sum;
+        }
+        for(size_t k=0; k<j; k++) history_scatter[j * num_dimensions + k] = history_scatter[k * num_dimensions + j];
+    }
+
+    // running maximum, the first occurrence is kept in case of ties
+    for(size_t c=0; c<num_chains; c++){
+        if (pdf_values[c] > mode_pdf){
+            mode_pdf = pdf_values[c];
+            std::copy_n(state.begin() + c * num_dimensions, num_dimensions, mode_sample.begin());
+        }
+    }
 }
 
 void TasmanianDREAM::getHistoryMeanVariance(std::vector<double> &mean, std::vector<double> &var) const{
     mean.resize(num_dimensions);
     var.resize(num_dimensions);
-    std::fill(mean.begin(), mean.end(), 0.0);
-    std::fill(var.begin(), var.end(), 0.0);
-
-    auto ih = history.begin();
-    while(ih != history.end()){
-        auto im = mean.begin();
-        auto iv = var.begin();
-        for(size_t i=0; i<num_dimensions; i++){
-            *iv++ += *ih * *ih;
-            *im++ += *ih++;
-        }
+    if (num_saved == 0){
+        std::fill(mean.begin(), mean.end(), 0.0);
+        std::fill(var.begin(), var.end(), 0.0);
+        return;
+    }
+    double n = (double) (num_saved * num_chains);
+    for(size_t j=0; j<num_dimensions; j++){
+        mean[j] = history_mean[j];
+        var[j] = history_scatter[j * num_dimensions + j] / n;
+    }
+}
+
+void TasmanianDREAM::getHistoryCovariance(std::vector<double> &cov) const{
+    cov.resize(num_dimensions * num_dimensions);
+    if (num_saved == 0){
+        std::fill(cov.begin(), cov.end(), 0.0);
+        return;
+    }
+    double n = (double) (num_saved * num_chains);
+    std::transform(history_scatter.begin(), history_scatter.end(), cov.begin(), [&](double s)->double{ return s / n; });
+}
+
+void TasmanianDREAM::getChainMeanVariance(std::vector<double> &means, std::vector<double> &variances) const{
+    means.resize(num_chains * num_dimensions);
+    variances.resize(num_chains * num_dimensions);
+    if (num_saved == 0){
+        std::fill(means.begin(), means.end(), 0.0);
+        std::fill(variances.begin(), variances.end(), 0.0);
+        return;
     }
+    double n = (double) num_saved;
+    std::copy(chain_means.begin(), chain_means.end(), means.begin());
+    std::transform(chain_scatter.begin(), chain_scatter.end(), variances.begin(), [&](double s)->double{ return s / n; });
+}
 
-    double n = (double) (history.size() / num_dimensions);
-    for(auto &m : mean) m /= n;
+void TasmanianDREAM::getChainVariances(std::vector<double> &within, std::vector<double> &between, std::vector<double> &pooled) const{
+    if ((num_chains < 2) || (num_saved < 2))
+        throw std::runtime_error("ERROR: the convergence diagnostics require at least two chains and two saved snapshots.");
+    double n = (double) num_saved, m = (double) num_chains;
+    within = std::vector<double>(num_dimensions, 0.0);
+    between = std::vector<double>(num_dimensions, 0.0);
+    pooled = std::vector<double>(num_dimensions);
+    for(size_t c=0; c<num_chains; c++){
+        for(size_t j=0; j<num_dimensions; j++){
+            within[j] += chain_scatter[c * num_dimensions + j] / (n - 1.0); // sample variance of the chain
+            double d = chain_means[c * num_dimensions + j] - history_mean[j]; // the overall mean is the mean of the chain means
+            between[j] += d * d;
+        }
+    }
+    for(size_t j=0; j<num_dimensions; j++){
+        within[j] /= m;
+        between[j] *= n / (m - 1.0);
+        pooled[j] = (n - 1.0) / n * within[j] + between[j] / n;
+    }
+}
 
-    auto im = mean.begin();
-    for(auto &v : var){
-        v /= n;
-        v -= *im * *im;
-        im++;
+void TasmanianDREAM::getGelmanRubin(std::vector<double> &rhat) const{
+    std::vector<double> within, between, pooled;
+    getChainVariances(within, between, pooled);
+    rhat.resize(num_dimensions);
+    for(size_t j=0; j<num_dimensions; j++){
+        if (within[j] > 0.0){
+            rhat[j] = std::sqrt(pooled[j] / within[j]);
+        }else{ // chains that do not move are converged only if they are at the same place
+            rhat[j] = (between[j] > 0.0) ? std::numeric_limits<double>::infinity() : 1.0;
+        }
     }
 }
 
+void TasmanianDREAM::getEffectiveSampleSize(std::vector<double> &ess) const{
+    std::vector<double> within, between, pooled;
+    getChainVariances(within, between, pooled);
+    double total = (double) (num_saved * num_chains);
+    ess.resize(num_dimensions);
+    for(size_t j=0; j<num_dimensions; j++)
+        ess[j] = (between[j] > 0.0) ? std::min(total, total * pooled[j] / between[j]) : total;
+}
+
 void TasmanianDREAM::getApproximateMode(std::vector<double> &mode) const{
-    auto imax = std::max_element(pdf_history.begin(), pdf_history.end());
+    mode = mode_sample;
     mode.resize(num_dimensions);
-    std::copy_n(history.begin() + std::distance(pdf_history.begin(), imax) * num_dimensions, num_dimensions, mode.data());
 }
 
 void TasmanianDREAM::clearHistory(){
     history = std::vector<double>();
     pdf_history = std::vector<double>();
     accepted = 0;
+    num_proposals = 0;
+    num_snapshots = 0;
+    num_saved = 0;
+    history_mean = std::vector<double>();
+    history_scatter = std::vector<double>();
+    chain_means = std::vector<double>();
+    chain_scatter = std::vector<double>();
+    mode_sample = std::vector<double>();
 }
 
 extern "C"{ // for python purposes
@@ -31,7 +31,7 @@
 #ifndef __TASMANIAN_DREAM_STATE_HPP
 #define __TASMANIAN_DREAM_STATE_HPP
 
-#include "tsgDreamEnumerates.hpp"
+#include "tsgDreamHistory.hpp"
 
 //! \internal
 //! \file tsgDreamState.hpp
@@ -91,7 +91,7 @@ public:
     int getNumDimensions() const{ return (int) num_dimensions; }
     //! \brief Return the number of chains.
     int getNumChains() const{ return (int) num_chains; }
-    //! \brief Return the number of saved vectors in the history.
+    //! \brief Return the number of saved vectors in the history held in memory, see also setHistorySink().
     size_t getNumHistory() const{ return pdf_history.size(); }
 
     //! \brief Return \b true if the state has already been initialized with \b setState().
@@ -149,6 +149,44 @@ public:
     //! \brief Return a const reference to the internal state vector.
     const std::vector<double>& getChainState() const{ return state; }
 
+    //! \brief Allocate the buffers for the next state and pdf values, the current state is not modified.
+
+    //! Used by the \b DREAM sampler and probably should not be called by the user.
+    //! The buffers persist between calls, i.e., the memory is allocated only once.
+    void prepareNextState(){
+        next_state.resize(num_chains * num_dimensions);
+        next_pdf_values.resize(num_chains);
+    }
+    //! \brief Return a pointer to the next state of the \b i-th chain, must call \b prepareNextState() first.
+
+    //! Used by the \b DREAM sampler and probably should not be called by the user.
+    double* getNextChainState(size_t i){ return &next_state[i * num_dimensions]; }
+    //! \brief Set the next pdf value of the \b i-th chain, must call \b prepareNextState() first.
+
+    //! Used by the \b DREAM sampler and probably should not be called by the user.
+    void setNextPDFvalue(size_t i, double value){ next_pdf_values[i] = value; }
+    //! \brief Make the next state and pdf values current, the buffers are swapped and no data is copied.
+
+    //! Used by the \b DREAM sampler and probably should not be called by the user.
+    void swapNextState(){
+        std::swap(state, next_state);
+        std::swap(pdf_values, next_pdf_values);
+        init_values = true;
+    }
+
+    //! \brief Set the executor used by \b SampleDREAM() to process the chains in parallel, see TasGrid::ParallelExecutor.
+
+    //! The chains are processed in parallel only if the random numbers are drawn from independent streams,
+    //! i.e., when \b SampleDREAM() is called with TasDREAM::CounterRandom01.
+    //! In parallel mode, the \b inside() domain and the \b differential_update() are called concurrently from multiple threads
+    //! and must be thread-safe, while the probability distribution is still called once per iteration.
+    //! Empty executor restores the sequential mode.
+    void setExecutor(TasGrid::ParallelExecutor new_executor){ executor = std::move(new_executor); }
+    //! \brief Returns \b true if an executor has been set, see \b setExecutor().
+    bool isUsingExecutor() const{ return !!executor; }
+    //! \brief Return the executor set with \b setExecutor().
+    const TasGrid::ParallelExecutor& getExecutor() const{ return executor; }
+
     //! \brief Return the value of the probability_distribution of the \b i-th chain.
 
     //! Used by the \b DREAM sampler and probably should not be called by the user.
@@ -162,8 +200,36 @@ public:
     //! \brief Appends the current state to the history.
 
     //! Used by the \b DREAM sampler and probably should not be called by the user; \b num_accepted is the number of new chains in the state.
+    //! If thinning is enabled, only one in every \b stride snapshots is saved, but all accepted proposals are counted.
+    //! If a sink is set, the snapshot is sent to the sink instead of the history held in memory.
     void saveStateHistory(size_t num_accepted);
 
+    //! \brief Write out any history buffered in the sink, called at the end of the \b DREAM sampler.
+    void flushHistory(){ if (history_sink) history_sink->flush(); }
+
+    //! \brief Save only one in every \b stride snapshots, i.e., thin the history, the default is 1 (no thinning).
+
+    //! Consecutive snapshots of an MCMC chain are strongly correlated and thinning reduces the storage
+    //! without significant loss of information. The acceptance rate is still computed using all snapshots.
+    //! \throws std::invalid_argument if \b stride is not positive.
+    void setHistoryThinning(int stride);
+    //! \brief Returns the thinning stride, see setHistoryThinning().
+    int getHistoryThinning() const{ return (int) thinning_stride; }
+
+    //! \brief Send the history snapshots to the \b sink instead of the memory, e.g., a DreamHistoryFile.
+
+    //! The snapshots that are already in memory are not affected and an empty pointer restores the in-memory history.
+    //! Copies of the state share the sink.
+    //! Example:
+    //! \code
+    //! TasDREAM::TasmanianDREAM state(num_chains, num_dimensions);
+    //! state.setHistorySink(std::make_shared<TasDREAM::DreamHistoryFile>("history.bin", num_chains, num_dimensions));
+    //! state.setHistoryThinning(10);
+    //! \endcode
+    void setHistorySink(std::shared_ptr<DreamHistorySink> sink){ history_sink = std::move(sink); }
+    //! \brief Returns \b true if the history is sent to a sink, see setHistorySink().
+    bool isUsingHistorySink() const{ return !!history_sink; }
+
     //! \brief Return a const reference to the internal state vector.
     const std::vector<double>& getHistory() const{ return history; }
 
@@ -171,9 +237,68 @@ public:
     const std::vector<double>& getHistoryPDF() const{ return pdf_history; }
 
     //! \brief Compute the means and variance of the saved history.
+
+    //! The statistics are updated incrementally by \b saveStateHistory(), i.e., the cost does not depend on the size of the history
+    //! and the result includes the snapshots sent to a history sink, but not the snapshots skipped by thinning.
     void getHistoryMeanVariance(std::vector<double> &mean, std::vector<double> &var) const;
 
+    //! \brief Return the covariance matrix of the saved history, \b cov has size num_dimensions squared.
+
+    //! Similar to \b getHistoryMeanVariance(), the covariance uses the incrementally updated statistics
+    //! and the diagonal entries are equal to the variance.
+    void getHistoryCovariance(std::vector<double> &cov) const;
+
+    //! \brief Return the means and variances of the saved history for each chain, the vectors have size num_chains times num_dimensions.
+    void getChainMeanVariance(std::vector<double> &means, std::vector<double> &variances) const;
+
+    /*!
+     * \brief Return the Gelman-Rubin potential scale reduction factor (R-hat) for each dimension.
+     *
+     * Computed from the per-chain statistics of the saved history, see Gelman and Rubin, Statistical Science, 1992,
+     * \f$ \hat R = \sqrt{ \left( \frac{n-1}{n} W + \frac{1}{n} B \right) / W } \f$,
+     * where \b n is the number of snapshots, \b W is the average of the within-chain variances
+     * and \b B / \b n is the variance of the chain means.
+     * Values close to 1 (e.g., below 1.1) indicate convergence, hence sampling can be done in segments
+     * until the criteria is satisfied, e.g.,
+     * \code
+     * TasDREAM::CounterRandom01 random(42);
+     * do{
+     *     TasDREAM::SampleDREAM(0, 100, distribution, domain, state, TasDREAM::dist_gaussian, 0.1, TasDREAM::const_one, random);
+     *     auto rhat = state.getGelmanRubin();
+     * }while(*std::max_element(rhat.begin(), rhat.end()) > 1.1);
+     * \endcode
+     *
+     * \throws std::runtime_error if there are fewer than two chains or fewer than two saved snapshots.
+     */
+    void getGelmanRubin(std::vector<double> &rhat) const;
+    //! \brief Overload that returns the vector.
+    std::vector<double> getGelmanRubin() const{
+        std::vector<double> rhat;
+        getGelmanRubin(rhat);
+        return rhat;
+    }
+
+    /*!
+     * \brief Return an estimate of the effective sample size for each dimension.
+     *
+     * Uses the between and within chain variances, \f$ n_{eff} = m n \hat V / B \f$, capped at \f$ m n \f$,
+     * where \b m is the number of chains and \f$ \hat V \f$ is the pooled variance used by getGelmanRubin().
+     * The estimate is crude, i.e., it does not use the autocorrelation of the chains,
+     * but it is computed without scanning the history.
+     *
+     * \throws std::runtime_error if there are fewer than two chains or fewer than two saved snapshots.
+     */
+    void getEffectiveSampleSize(std::vector<double> &ess) const;
+    //! \brief Overload that returns the vector.
+    std::vector<double> getEffectiveSampleSize() const{
+        std::vector<double> ess;
+        getEffectiveSampleSize(ess);
+        return ess;
+    }
+
     //! \brief Return the sample with highest probability, searchers within the history.
+
+    //! The running maximum is updated by \b saveStateHistory(), similar to \b getHistoryMeanVariance().
     void getApproximateMode(std::vector<double> &mode) const;
 
     //! \brief Overload that returns the vector.
@@ -186,18 +311,35 @@ public:
     //! \brief Clear the stored history (does not touch the state).
     void clearHistory();
 
-    //! \brief Returns the acceptance rate of the current history.
-    double getAcceptanceRate() const{ return ((pdf_history.empty()) ? 0 : ((double) accepted) / ((double) pdf_history.size())); }
+    //! \brief Returns the acceptance rate of the current history, includes the snapshots skipped by thinning or sent to a sink.
+    double getAcceptanceRate() const{ return ((num_proposals == 0) ? 0 : ((double) accepted) / ((double) num_proposals)); }
 
     // file I/O
 private:
     size_t num_chains, num_dimensions;
     bool init_state, init_values;
 
-    size_t accepted;
+    size_t accepted, num_proposals;
+    size_t thinning_stride, num_snapshots;
+    std::shared_ptr<DreamHistorySink> history_sink;
+
+    // statistics of the saved history, updated incrementally
+    size_t num_saved; // number of saved snapshots
+    std::vector<double> history_mean, history_scatter; // the scatter matrix is the sum of the outer products of the deviations
+    std::vector<double> chain_means, chain_scatter; // per-chain, per-dimension
+    double mode_pdf;
+    std::vector<double> mode_sample;
+    std::vector<double> snapshot_mean, snapshot_deviations; // scratch space for updateStatistics(), avoids allocations on every snapshot
+
+    //! \brief Add the current state to the statistics.
+    void updateStatistics();
+    //! \brief Compute the within chain (W) and the pooled (V) variances, and the between chain variance (B), used by R-hat and ESS.
+    void getChainVariances(std::vector<double> &within, std::vector<double> &between, std::vector<double> &pooled) const;
 
     std::vector<double> state, history;
     std::vector<double> pdf_values, pdf_history;
+    std::vector<double> next_state, next_pdf_values;
+    TasGrid::ParallelExecutor executor;
 };
 
 }
@@ -274,6 +274,12 @@ class RandomGenerator(object):
        numbers distributed uniformly in (0, 1), e.g.,
        from random import uniform
        RandomGenerator(callableRNG = lambda : uniform(0.0, 1.0))
+    5) RandomGenerator("philox", iSeed)
+       Uses the counter-based Philox-4x32-10 generator, where the random
+       numbers for each chain and iteration come from an independent stream
+       defined by the seed, the chain and the iteration indexes;
+       the result is reproducible and independent of the order in which
+       the chains are processed.
     '''
     def __init__(self, sType = "default", iSeed = -1, callableRNG = lambda : 1):
         '''
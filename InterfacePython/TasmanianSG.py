@@ -226,6 +226,8 @@ class TasmanianSparseGrid:
         self.pLibTSG.tsgFinishConstruction.argtypes = [c_void_p]
         self.pLibTSG.tsgPrintStats.argtypes = [c_void_p]
         self.pLibTSG.tsgEnableAcceleration.argtypes = [c_void_p, c_char_p]
+        self.pLibTSG.tsgSetEvaluationThreads.argtypes = [c_void_p, c_int, c_int, c_int]
+        self.pLibTSG.tsgIsUsingExecutor.argtypes = [c_void_p]
         self.pLibTSG.tsgGetAccelerationType.argtypes = [c_void_p]
         self.pLibTSG.tsgIsAccelerationAvailable.argtypes = [c_char_p]
         self.pLibTSG.tsgSetGPUID.argtypes = [c_void_p, c_int]
@@ -2096,6 +2098,37 @@ class TasmanianSparseGrid:
             sAccelerationType = bytes(sAccelerationType, encoding='utf8')
         self.pLibTSG.tsgEnableAcceleration(self.pGrid, c_char_p(sAccelerationType))
 
+    def setEvaluationThreads(self, iNumThreads, iBlockSize = 0, bPinThreads = False):
+        '''
+        sets the number of threads used by evaluateBatch() and
+        evaluateHierarchicalFunctions(), independent of OpenMP
+        the threads form a pool owned by the grid object and the
+        points are split into blocks processed by the threads
+
+        iNumThreads: non-negative integer
+                     total number of threads, including the caller
+                     0 restores the default OpenMP mode
+
+        iBlockSize: integer
+                    number of points in a single block
+                    non-positive value uses the default of 128
+
+        bPinThreads: boolean
+                     if True, the threads are pinned to cores (Linux)
+                     and the blocks are assigned statically, i.e.,
+                     the same part of the output is always computed
+                     on the same core (NUMA first-touch placement)
+        '''
+        if (iNumThreads < 0):
+            raise TasmanianInputError("iNumThreads", "ERROR: the number of threads must be non-negative")
+        self.pLibTSG.tsgSetEvaluationThreads(self.pGrid, iNumThreads, iBlockSize, 1 if bPinThreads else 0)
+
+    def isUsingEvaluationThreads(self):
+        '''
+        returns True if setEvaluationThreads() has set a thread pool
+        '''
+        return (self.pLibTSG.tsgIsUsingExecutor(self.pGrid) != 0)
+
     def getAccelerationType(self):
         '''
         returns the type of acceleration set by enableAcceleration
@@ -35,10 +35,90 @@
 
 #include "tsgUtils.hpp"
 
+#if defined(__unix__) || defined(__APPLE__)
+#define __TASMANIAN_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 template<class T> std::unique_ptr<T> make_unique_ptr(){ return std::unique_ptr<T>(new T()); }
 
 namespace TasGrid{
 
+namespace IO{
+/*!
+ * \internal
+ * \ingroup TasmanianIO
+ * \brief Read-only view of the content of a file, uses a memory map if available or a single read into a buffer otherwise.
+ *
+ * Mapping the file avoids the intermediate buffering of std::ifstream,
+ * the pages are loaded on demand and shared across processes reading the same file.
+ * Grids read from a mapped container keep a shared pointer to the file and reference
+ * the points, values and surpluses directly in the mapping (see MappedVector).
+ * The class owns the mapping, hence it cannot be copied.
+ * \endinternal
+ */
+class MappedFile{
+public:
+    //! \brief Open and map the file, throws std::runtime_error if the file cannot be opened.
+    MappedFile(const char *filename) : data(nullptr), num_bytes(0){
+        #ifdef __TASMANIAN_USE_MMAP
+        int fd = open(filename, O_RDONLY);
+        if (fd == -1) throw std::runtime_error(std::string("ERROR: occurred when trying to open file: ") + filename);
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0){
+            close(fd);
+            throw std::runtime_error(std::string("ERROR: occurred when trying to open file: ") + filename);
+        }
+        num_bytes = (size_t) file_stat.st_size;
+        if (num_bytes > 0){
+            void *map = mmap(nullptr, num_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map == MAP_FAILED){
+                close(fd);
+                throw std::runtime_error(std::string("ERROR: occurred when trying to map file: ") + filename);
+            }
+            data = static_cast<char*>(map);
+        }
+        close(fd); // the mapping remains valid after closing the file
+        #else
+        std::ifstream ifs(filename, std::ios::in | std::ios::binary | std::ios::ate);
+        if (!ifs.good()) throw std::runtime_error(std::string("ERROR: occurred when trying to open file: ") + filename);
+        num_bytes = (size_t) ifs.tellg();
+        buffer.resize(num_bytes);
+        ifs.seekg(0);
+        ifs.read(buffer.data(), num_bytes);
+        data = buffer.data();
+        #endif
+    }
+    //! \brief Copying would release the mapping twice.
+    MappedFile(MappedFile const&) = delete;
+    //! \brief Copying would release the mapping twice.
+    MappedFile& operator =(MappedFile const&) = delete;
+    //! \brief Release the mapping.
+    ~MappedFile(){
+        #ifdef __TASMANIAN_USE_MMAP
+        if (data != nullptr) munmap(data, num_bytes);
+        #endif
+    }
+    //! \brief Returns a pointer to the beginning of the data.
+    char* begin() const{ return data; }
+    //! \brief Returns the number of bytes.
+    size_t size() const{ return num_bytes; }
+
+private:
+    char *data;
+    size_t num_bytes;
+    #ifndef __TASMANIAN_USE_MMAP
+    std::vector<char> buffer;
+    #endif
+};
+}
+
+constexpr int TasmanianSparseGrid::canonical_block_size;
+constexpr int TasmanianSparseGrid::default_executor_block_size;
+
 const char* TasmanianSparseGrid::getVersion(){ return TASMANIAN_VERSION_STRING; }
 const char* TasmanianSparseGrid::getLicense(){ return TASMANIAN_LICENSE; }
 const char* TasmanianSparseGrid::getGitCommitHash(){ return TASMANIAN_GIT_COMMIT_HASH; }
@@ -53,12 +133,13 @@ bool TasmanianSparseGrid::isOpenMPEnabled(){
     #endif // _OPENMP
 }
 
-TasmanianSparseGrid::TasmanianSparseGrid() : acceleration(accel_none), gpu_id(0), usingDynamicConstruction(false){
+TasmanianSparseGrid::TasmanianSparseGrid() : acceleration(accel_none), gpu_id(0), usingDynamicConstruction(false), executor_block_size(default_executor_block_size){
 #ifdef Tasmanian_ENABLE_BLAS
     acceleration = accel_cpu_blas;
 #endif // Tasmanian_ENABLE_BLAS
 }
-TasmanianSparseGrid::TasmanianSparseGrid(const TasmanianSparseGrid &source) : acceleration(accel_none), gpu_id(0), usingDynamicConstruction(false)
+TasmanianSparseGrid::TasmanianSparseGrid(const TasmanianSparseGrid &source) : acceleration(accel_none), gpu_id(0), usingDynamicConstruction(false),
+                                                                           executor_block_size(default_executor_block_size)
 {
     copyGrid(&source);
 #ifdef Tasmanian_ENABLE_BLAS
@@ -104,24 +185,23 @@ void TasmanianSparseGrid::write(const char *filename, bool binary) const{
     ofs.close();
 }
 void TasmanianSparseGrid::read(const char *filename){
-    std::ifstream ifs;
-    char TSG[3];
-    bool binary_format = mode_ascii;
-    ifs.open(filename, std::ios::in | std::ios::binary);
-    if (!ifs.good()) throw std::runtime_error(std::string("ERROR: occurred when trying to open file: ") + filename);
-    ifs.read(TSG, 3 * sizeof(char));
-    if ((TSG[0] == 'T') && (TSG[1] == 'S') && (TSG[2] == 'G')){
-        binary_format = mode_binary;
-    }
-    ifs.close();
-    if (binary_format == mode_binary){
-        ifs.open(filename, std::ios::in | std::ios::binary);
-    }else{
-        ifs.open(filename);
+    auto mapped_file = std::make_shared<IO::MappedFile>(filename);
+    bool binary_format = ((mapped_file->size() >= 3) && (std::string(mapped_file->begin(), 3) == "TSG")) ? mode_binary : mode_ascii;
+    #ifndef __TASMANIAN_USE_MMAP
+    if (binary_format == mode_ascii){ // the ascii format has to be opened in text mode, e.g., to handle Windows line endings
+        std::ifstream ifs(filename);
+        if (!ifs.good()) throw std::runtime_error(std::string("ERROR: occurred when trying to open file: ") + filename);
+        read(ifs, mode_ascii);
+        return;
+    }
+    #endif
+    if ((binary_format == mode_binary) && (mapped_file->size() >= 4) && (mapped_file->begin()[3] == '6')){
+        readContainer(mapped_file->begin(), mapped_file->size(), false, mapped_file); // the grid references the mapped pages
+        return;
     }
-    if (!ifs.good()) throw std::runtime_error(std::string("ERROR: occurred when trying to open file: ") + filename);
+    IO::MemoryBuffer buffer(mapped_file->begin(), mapped_file->size());
+    std::istream ifs(&buffer);
     read(ifs, binary_format);
-    ifs.close();
 }
 
 void TasmanianSparseGrid::write(std::ostream &ofs, bool binary) const{
@@ -282,6 +362,8 @@ void TasmanianSparseGrid::updateGlobalGrid(int depth, TypeDepth type, const std:
 
         if (!level_limits.empty()) llimits = level_limits; // if level_limits is empty, use the existing llimits (if any)
 
+        base->clearCachedData();
+        base->clearCachedWeights();
         get<GridGlobal>()->updateGrid(depth, type, anisotropic_weights, llimits);
     }else{
         throw std::runtime_error("ERROR: updateGlobalGrid() called, but the grid is not global");
@@ -302,6 +384,8 @@ void TasmanianSparseGrid::updateSequenceGrid(int depth, TypeDepth type, const st
         if ((!level_limits.empty()) && (level_limits.size() != (size_t) dims)) throw std::invalid_argument("ERROR: updateSequenceGrid() requires level_limits with either 0 or dimensions entries");
 
         if (!level_limits.empty()) llimits = level_limits; // if level_limits is empty, use the existing llimits (if any)
+        base->clearCachedData();
+        base->clearCachedWeights();
         get<GridSequence>()->updateGrid(depth, type, anisotropic_weights, llimits);
     }else{
         throw std::runtime_error("ERROR: updateSequenceGrid called, but the grid is not sequence");
@@ -323,6 +407,8 @@ void TasmanianSparseGrid::updateFourierGrid(int depth, TypeDepth type, std::vect
     if ((!level_limits.empty()) && (level_limits.size() != (size_t) dims)) throw std::invalid_argument("ERROR: updateSequenceGrid() requires level_limits with either 0 or dimensions entries");
 
     if (!level_limits.empty()) llimits = level_limits; // if level_limits is empty, use the existing llimits (if any)
+    base->clearCachedData();
+    base->clearCachedWeights();
     get<GridFourier>()->updateGrid(depth, type, anisotropic_weights, llimits);
 }
 
@@ -343,7 +429,8 @@ void TasmanianSparseGrid::getPoints(double *x) const{
 }
 
 void TasmanianSparseGrid::getQuadratureWeights(double *weights) const{
-    base->getQuadratureWeights(weights);
+    std::vector<double> const &cached_weights = base->getCachedQuadratureWeights(); // the weights change only when the points change
+    std::copy(cached_weights.begin(), cached_weights.end(), weights);
     mapConformalWeights(base->getNumDimensions(), base->getNumPoints(), weights);
     if (domain_transform_a.size() != 0){
         double scale = getQuadratureScale(base->getNumDimensions(), base->getRule());
@@ -367,6 +454,9 @@ void TasmanianSparseGrid::getInterpolationWeights(const double x[], double weigh
 }
 
 void TasmanianSparseGrid::loadNeededPoints(const double *vals){
+    base->setExecutor(executor);
+    base->clearCachedData();
+    if (base->getNumNeeded() > 0) base->clearCachedWeights(); // merging the needed points, loading values on fixed points keeps the weights
     #ifdef Tasmanian_ENABLE_CUDA
     if (engine){
         engine->setDevice();
@@ -385,15 +475,15 @@ void TasmanianSparseGrid::loadNeededPoints(const std::vector<double> &vals){
 }
 
 void TasmanianSparseGrid::evaluate(const double x[], double y[]) const{
-    Data2D<double> x_tmp;
-    base->evaluate(formCanonicalPoints(x, x_tmp, 1), y);
+    auto x_tmp = canonical_workspaces.acquire(); // reused across calls, single point evaluations do not allocate memory
+    base->evaluate(formCanonicalPoints(x, *x_tmp, 1), y);
 }
 
 void TasmanianSparseGrid::evaluateBatch(const double x[], int num_x, double y[]) const{
-    Data2D<double> x_tmp;
-    const double *x_canonical = formCanonicalPoints(x, x_tmp, num_x);
     #ifdef Tasmanian_ENABLE_CUDA
     if (engine){
+        Data2D<double> x_tmp; // the gpu needs all points at once
+        const double *x_canonical = formCanonicalPoints(x, x_tmp, num_x);
         engine->setDevice();
         if (acceleration == accel_gpu_cublas){
             base->evaluateCudaMixed(engine.get(), x_canonical, num_x, y);
@@ -403,13 +493,41 @@ void TasmanianSparseGrid::evaluateBatch(const double x[], int num_x, double y[])
         return;
     }
     #endif
-    #ifdef Tasmanian_ENABLE_BLAS
-    if (acceleration == accel_cpu_blas){
-        base->evaluateBlas(x_canonical, num_x, y);
-        return;
-    }
-    #endif
-    base->evaluateBatch(x_canonical, num_x, y);
+    Utils::Wrapper2D<double> ywrap(base->getNumOutputs(), y);
+    evaluateCanonicalBlocks(x, num_x, [&](const double x_canonical[], int num_block, int offset)->void{
+        #ifdef Tasmanian_ENABLE_BLAS
+        if (acceleration == accel_cpu_blas){
+            base->evaluateBlas(x_canonical, num_block, ywrap.getStrip(offset));
+            return;
+        }
+        #endif
+        base->evaluateBatch(x_canonical, num_block, ywrap.getStrip(offset));
+    });
+}
+void TasmanianSparseGrid::evaluateBatch(const double x[], int num_x, int outputs_begin, int outputs_end, double y[]) const{
+    int num_outputs = getNumOutputs();
+    if ((outputs_end < 0) || (outputs_end > num_outputs)) outputs_end = num_outputs;
+    if ((outputs_begin < 0) || (outputs_begin >= outputs_end))
+        throw std::invalid_argument("ERROR: evaluateBatch() called with an invalid range of outputs");
+    std::vector<int> outputs((size_t) (outputs_end - outputs_begin));
+    std::iota(outputs.begin(), outputs.end(), outputs_begin);
+    Utils::Wrapper2D<double> ywrap((int) outputs.size(), y);
+    evaluateCanonicalBlocks(x, num_x, [&](const double x_canonical[], int num_block, int offset)->void{
+        base->evaluateBatchOutputs(x_canonical, num_block, outputs.data(), (int) outputs.size(), ywrap.getStrip(offset));
+    });
+}
+void TasmanianSparseGrid::evaluateBatch(const float x[], int num_x, float y[]) const{
+    // the basis is always computed in double precision, the points are converted one block at a time
+    Utils::Wrapper2D<float> ywrap(base->getNumOutputs(), y);
+    evaluateCanonicalBlocks(x, num_x, [&](const double x_canonical[], int num_block, int offset)->void{
+        #ifdef Tasmanian_ENABLE_BLAS
+        if (acceleration == accel_cpu_blas){
+            base->evaluateBlas(x_canonical, num_block, ywrap.getStrip(offset));
+            return;
+        }
+        #endif
+        base->evaluateBatch(x_canonical, num_block, ywrap.getStrip(offset));
+    });
 }
 #ifdef Tasmanian_ENABLE_CUDA
 void TasmanianSparseGrid::evaluateBatchGPU(const double gpu_x[], int cpu_num_x, double gpu_y[]) const{
@@ -447,12 +565,44 @@ void TasmanianSparseGrid::evaluate(const std::vector<double> &x, std::vector<dou
     y.resize((size_t) getNumOutputs());
     evaluate(x.data(), y.data());
 }
+void TasmanianSparseGrid::setEvaluationThreads(int num_threads, int block_size, bool pin_threads){
+    if (num_threads < 0)
+        throw std::invalid_argument("ERROR: setEvaluationThreads() called with negative number of threads: " + std::to_string(num_threads));
+    if (num_threads == 0){
+        setExecutor(ParallelExecutor(), block_size);
+    }else{
+        setExecutor(makeThreadPoolExecutor(num_threads, pin_threads), block_size);
+    }
+}
 void TasmanianSparseGrid::evaluateBatch(const std::vector<double> &x, std::vector<double> &y) const{
     int num_outputs = getNumOutputs();
     size_t num_x = x.size() / getNumDimensions();
     y.resize(num_outputs * num_x);
     evaluateBatch(x.data(), (int) num_x, y.data());
 }
+void TasmanianSparseGrid::evaluateBatch(std::vector<float> const &x, std::vector<float> &y) const{
+    int num_x = (int) (x.size() / getNumDimensions());
+    y.resize(Utils::size_mult(num_x, getNumOutputs()));
+    evaluateBatch(x.data(), num_x, y.data());
+}
+void TasmanianSparseGrid::evaluateBatch(std::vector<double> const &x, int outputs_begin, int outputs_end, std::vector<double> &y) const{
+    int num_outputs = getNumOutputs();
+    if ((outputs_end < 0) || (outputs_end > num_outputs)) outputs_end = num_outputs;
+    size_t num_x = x.size() / getNumDimensions();
+    y.resize(num_x * (size_t) std::max(outputs_end - outputs_begin, 0));
+    evaluateBatch(x.data(), (int) num_x, outputs_begin, outputs_end, y.data());
+}
+void TasmanianSparseGrid::evaluateBatch(std::vector<double> const &x, std::vector<int> const &outputs, std::vector<double> &y) const{
+    int num_outputs = getNumOutputs();
+    if (outputs.empty() || std::any_of(outputs.begin(), outputs.end(), [&](int k)->bool{ return ((k < 0) || (k >= num_outputs)); }))
+        throw std::invalid_argument("ERROR: evaluateBatch() called with an invalid list of outputs");
+    int num_x = (int) (x.size() / getNumDimensions());
+    y.resize(Utils::size_mult(num_x, (int) outputs.size()));
+    Utils::Wrapper2D<double> ywrap((int) outputs.size(), y.data());
+    evaluateCanonicalBlocks(x.data(), num_x, [&](const double x_canonical[], int num_block, int offset)->void{
+        base->evaluateBatchOutputs(x_canonical, num_block, outputs.data(), (int) outputs.size(), ywrap.getStrip(offset));
+    });
+}
 void TasmanianSparseGrid::integrate(std::vector<double> &q) const{
     size_t num_outputs = getNumOutputs();
     q.resize(num_outputs);
@@ -538,41 +688,6 @@ void TasmanianSparseGrid::mapCanonicalToTransformed(int num_dimensions, int num_
         }
     }
 }
-void TasmanianSparseGrid::mapTransformedToCanonical(int num_dimensions, int num_points, TypeOneDRule rule, double x[]) const{
-    if ((rule == rule_gausslaguerre) || (rule == rule_gausslaguerreodd)){ // canonical (0, +infty)
-        for(int i=0; i<num_points * num_dimensions; i++){
-            int j = i % num_dimensions;
-            x[i] -= domain_transform_a[j];
-            x[i] *= domain_transform_b[j];
-        }
-    }else if ((rule == rule_gausshermite) || (rule == rule_gausshermiteodd)){ // (-infty, +infty)
-        std::vector<double> sqrt_b(num_dimensions);
-        for(int j=0; j<num_dimensions; j++) sqrt_b[j] = std::sqrt(domain_transform_b[j]);
-        for(int i=0; i<num_points * num_dimensions; i++){
-            int j = i % num_dimensions;
-            x[i] -= domain_transform_a[j];
-            x[i] *= sqrt_b[j];
-        }
-    }else if (rule == rule_fourier){   // map to [0,1]^d
-        for(int i=0; i<num_points * num_dimensions; i++){
-            int j = i % num_dimensions;
-            x[i] -= domain_transform_a[j];
-            x[i] /= domain_transform_b[j]-domain_transform_a[j];
-        }
-    }else{ // canonical [-1,1]
-        std::vector<double> rate(num_dimensions);
-        std::vector<double> shift(num_dimensions);
-        for(int j=0; j<num_dimensions; j++){
-            rate[j]  = 2.0 / (domain_transform_b[j] - domain_transform_a[j]);
-            shift[j] = (domain_transform_b[j] + domain_transform_a[j]) / (domain_transform_b[j] - domain_transform_a[j]);
-        }
-        for(int i=0; i<num_points * num_dimensions; i++){
-            int j = i % num_dimensions;
-            x[i] *= rate[j];
-            x[i] -= shift[j];
-        }
-    }
-}
 double TasmanianSparseGrid::getQuadratureScale(int num_dimensions, TypeOneDRule rule) const{
     double scale = 1.0;
     // gauss- (chebyshev1, chebyshev2, gegenbauer) are special case of jacobi
@@ -652,19 +767,47 @@ void TasmanianSparseGrid::mapConformalCanonicalToTransformed(int num_dimensions,
         }
     }
 }
-void TasmanianSparseGrid::mapConformalTransformedToCanonical(int num_dimensions, int num_points, Data2D<double> &x) const{
-    if (conformal_asin_power.size() != 0){
-        // precompute constants, transform is sum exp(c_k + p_k * log(x))
-        std::vector<std::vector<double>> c(num_dimensions), p(num_dimensions), dc(num_dimensions), dp(num_dimensions);
+template<typename T> void TasmanianSparseGrid::mapToCanonical(int num_x, const T x[], double x_canonical[]) const{
+    int num_dimensions = base->getNumDimensions();
+    TypeOneDRule rule = base->getRule();
+    // the linear transform is written as canonical = (x - offset) * rate + shift
+    std::vector<double> offset, rate, shift;
+    if (!domain_transform_a.empty()){
+        offset.resize(num_dimensions, 0.0);
+        rate.resize(num_dimensions);
+        shift.resize(num_dimensions, 0.0);
+        for(int j=0; j<num_dimensions; j++){
+            if ((rule == rule_gausslaguerre) || (rule == rule_gausslaguerreodd)){ // canonical (0, +infty)
+                offset[j] = domain_transform_a[j];
+                rate[j]   = domain_transform_b[j];
+            }else if ((rule == rule_gausshermite) || (rule == rule_gausshermiteodd)){ // (-infty, +infty)
+                offset[j] = domain_transform_a[j];
+                rate[j]   = std::sqrt(domain_transform_b[j]);
+            }else if (rule == rule_fourier){   // map to [0,1]^d
+                offset[j] = domain_transform_a[j];
+                rate[j]   = 1.0 / (domain_transform_b[j] - domain_transform_a[j]);
+            }else{ // canonical [-1,1]
+                rate[j]  =  2.0 / (domain_transform_b[j] - domain_transform_a[j]);
+                shift[j] = -(domain_transform_b[j] + domain_transform_a[j]) / (domain_transform_b[j] - domain_transform_a[j]);
+            }
+        }
+    }
+
+    // constants of the conformal map, transform is sum exp(c_k + p_k * log(x))
+    std::vector<std::vector<double>> c, p, dc, dp;
+    std::vector<double> cm;
+    if (!conformal_asin_power.empty()){
+        c.resize(num_dimensions);
+        p.resize(num_dimensions);
+        dc.resize(num_dimensions);
+        dp.resize(num_dimensions);
+        cm.resize(num_dimensions, 0.0);
+        double lgamma_half = std::lgamma(0.5);
         for(int j=0; j<num_dimensions; j++){
             c[j].resize(conformal_asin_power[j] + 1);
             p[j].resize(conformal_asin_power[j] + 1);
             dc[j].resize(conformal_asin_power[j] + 1);
             dp[j].resize(conformal_asin_power[j] + 1);
-        }
-        double lgamma_half = std::lgamma(0.5);
-        std::vector<double> cm(num_dimensions, 0.0);
-        for(int j=0; j<num_dimensions; j++){
             double factorial = 0.0;
             for(int k=0; k<=conformal_asin_power[j]; k++){
                 p[j][k] = (double)(2*k+1);
@@ -675,41 +818,73 @@ void TasmanianSparseGrid::mapConformalTransformedToCanonical(int num_dimensions,
                 factorial += std::log((double)(k+1));
             }
         }
-        for(int i=0; i<num_points; i++){
-            double *this_x = x.getStrip(i);
-            for(int j=0; j<num_dimensions; j++){
-                if (this_x[j] != 0.0){ // zero maps to zero and makes the log unstable
-                    double sign = (this_x[j] > 0.0) ? 1.0 : -1.0;
-                    this_x[j] = std::abs(this_x[j]);
-                    double b = this_x[j];
-                    double logx = log(this_x[j]);
-                    double r = this_x[j];
-                    double dr = 1.0;
-                    for(int k=1; k<=conformal_asin_power[j]; k++){
-                        r  += std::exp( c[j][k] +  p[j][k] * logx);
-                        dr += std::exp(dc[j][k] + dp[j][k] * logx);
-                   }
-                    r /= cm[j];
-                    r -= b; // transformed_x -b = 0
-                    while(std::abs(r) > Maths::num_tol){
-                        this_x[j] -= r * cm[j] / dr;
-
-                        logx = std::log(std::abs(this_x[j]));
-                        r = this_x[j];
-                        dr = 1.0;
-                        for(int k=1; k<=conformal_asin_power[j]; k++){
-                            r  += std::exp( c[j][k] +  p[j][k] * logx);
-                            dr += std::exp(dc[j][k] + dp[j][k] * logx);
-                       }
-                        r /= cm[j];
-                        r -= b;
-                   }
-                    this_x[j] *= sign;
-                }
+    }
+    // inverts the conformal map using Newton's method, the result for b has the sign of b
+    auto conformal_inverse = [&](int j, double b)->double{
+        if (b == 0.0) return 0.0; // zero maps to zero and makes the log unstable
+        double sign = (b > 0.0) ? 1.0 : -1.0;
+        b = std::abs(b);
+        double t = b;
+        double r, dr;
+        do{
+            double logx = std::log(std::abs(t));
+            r  = t;
+            dr = 1.0;
+            for(int k=1; k<=conformal_asin_power[j]; k++){
+                r  += std::exp( c[j][k] +  p[j][k] * logx);
+                dr += std::exp(dc[j][k] + dp[j][k] * logx);
             }
+            r /= cm[j];
+            r -= b; // transformed_x -b = 0
+            if (std::abs(r) > Maths::num_tol) t -= r * cm[j] / dr;
+        }while(std::abs(r) > Maths::num_tol);
+        return sign * t;
+    };
+
+    // each point is read once, passes through both transforms and is written once
+    Utils::Wrapper2D<const T> xwrap(num_dimensions, x);
+    Utils::Wrapper2D<double> cwrap(num_dimensions, x_canonical);
+    for(int i=0; i<num_x; i++){
+        const T *this_x = xwrap.getStrip(i);
+        double *this_c = cwrap.getStrip(i);
+        for(int j=0; j<num_dimensions; j++){
+            double v = (double) this_x[j];
+            if (!cm.empty()) v = conformal_inverse(j, v);
+            if (!rate.empty()) v = (v - offset[j]) * rate[j] + shift[j];
+            this_c[j] = v;
         }
     }
 }
+template<typename T> void TasmanianSparseGrid::evaluateCanonicalBlocks(const T x[], int num_x, std::function<void(const double x_canonical[], int num_block, int offset)> eval) const{
+    bool is_canonical = std::is_same<T, double>::value && domain_transform_a.empty() && conformal_asin_power.empty();
+    int num_dimensions = base->getNumDimensions();
+    Utils::Wrapper2D<const T> xwrap(num_dimensions, x);
+    if (executor){
+        Utils::runExecutorTasks(executor, num_x / executor_block_size + ((num_x % executor_block_size == 0) ? 0 : 1), [&](int task)->void{
+            int offset = task * executor_block_size;
+            int num_block = std::min(executor_block_size, num_x - offset);
+            if (is_canonical){
+                eval(reinterpret_cast<const double*>(xwrap.getStrip(offset)), num_block, offset);
+            }else{
+                auto x_block = canonical_workspaces.acquire(); // reused by the following tasks
+                x_block->resize(num_dimensions, num_block);
+                mapToCanonical(num_block, xwrap.getStrip(offset), x_block->getStrip(0));
+                eval(x_block->getStrip(0), num_block, offset);
+            }
+        });
+        return;
+    }
+    if (is_canonical){
+        eval(reinterpret_cast<const double*>(x), num_x, 0); // nothing to do, x is already canonical
+        return;
+    }
+    std::vector<double> x_block(Utils::size_mult(std::min(num_x, canonical_block_size), num_dimensions));
+    for(int offset=0; offset<num_x; offset += canonical_block_size){
+        int num_block = std::min(canonical_block_size, num_x - offset);
+        mapToCanonical(num_block, xwrap.getStrip(offset), x_block.data());
+        eval(x_block.data(), num_block, offset);
+    }
+}
 void TasmanianSparseGrid::mapConformalWeights(int num_dimensions, int num_points, double weights[]) const{
     if (conformal_asin_power.size() != 0){
         // precompute constants, transform is sum exp(c_k + p_k * log(x))
@@ -753,9 +928,8 @@ void TasmanianSparseGrid::mapConformalWeights(int num_dimensions, int num_points
 const double* TasmanianSparseGrid::formCanonicalPoints(const double *x, Data2D<double> &x_temp, int num_x) const{
     if ((domain_transform_a.size() != 0) || (conformal_asin_power.size() != 0)){
         int num_dimensions = base->getNumDimensions();
-        x_temp.resize(num_dimensions, num_x); std::copy(x, x + ((size_t) num_dimensions) * ((size_t) num_x), x_temp.getStrip(0));
-        mapConformalTransformedToCanonical(num_dimensions, num_x, x_temp);
-        if (domain_transform_a.size() != 0) mapTransformedToCanonical(num_dimensions, num_x, base->getRule(), x_temp.getStrip(0));
+        x_temp.resize(num_dimensions, num_x);
+        mapToCanonical(num_x, x, x_temp.getStrip(0));
         return x_temp.getStrip(0);
     }else{
         return x;
@@ -898,16 +1072,26 @@ void TasmanianSparseGrid::setSurplusRefinement(double tolerance, TypeRefinement
 }
 
 void TasmanianSparseGrid::clearRefinement(){
-    if (!empty()) base->clearRefinement();
+    if (!empty()){
+        base->clearCachedData();
+        base->clearCachedWeights();
+        base->clearRefinement();
+    }
 }
 void TasmanianSparseGrid::mergeRefinement(){
-    if (!empty()) base->mergeRefinement();
+    if (!empty()){
+        base->clearCachedData();
+        base->clearCachedWeights();
+        base->mergeRefinement();
+    }
 }
 
 void TasmanianSparseGrid::beginConstruction(){
     if (!usingDynamicConstruction){
         if (getNumLoaded() > 0) clearRefinement();
         usingDynamicConstruction = true;
+        base->clearCachedData();
+        base->clearCachedWeights();
         base->beginConstruction();
     }
 }
@@ -980,13 +1164,20 @@ void TasmanianSparseGrid::loadConstructedPoints(const double x[], int numx, cons
     if (!usingDynamicConstruction) throw std::runtime_error("ERROR: loadConstructedPoint() called before beginConstruction()");
     Data2D<double> x_tmp;
     const double *x_canonical = formCanonicalPoints(x, x_tmp, numx);
+    base->setExecutor(executor);
+    base->clearCachedData();
+    base->clearCachedWeights();
     if (numx == 1)
         base->loadConstructedPoint(x_canonical, Utils::copyArray(y, getNumOutputs()));
     else
         base->loadConstructedPoint(x_canonical, numx, y);
 }
 void TasmanianSparseGrid::finishConstruction(){
-    if (usingDynamicConstruction) base->finishConstruction();
+    if (usingDynamicConstruction){
+        base->clearCachedData();
+        base->clearCachedWeights();
+        base->finishConstruction();
+    }
     usingDynamicConstruction = false;
 }
 
@@ -994,6 +1185,8 @@ void TasmanianSparseGrid::removePointsByHierarchicalCoefficient(double tolerance
     if (!isLocalPolynomial()){
         throw std::runtime_error("ERROR: removePointsBySurplus() called for a grid that is not Local Polynomial.");
     }else{
+        base->clearCachedData();
+        base->clearCachedWeights();
         if (get<GridLocalPolynomial>()->removePointsByHierarchicalCoefficient(tolerance, output, scale_correction) == 0){
             clear();
         }
@@ -1001,8 +1194,10 @@ void TasmanianSparseGrid::removePointsByHierarchicalCoefficient(double tolerance
 }
 
 void TasmanianSparseGrid::evaluateHierarchicalFunctions(const double x[], int num_x, double y[]) const{
-    Data2D<double> x_tmp;
-    base->evaluateHierarchicalFunctions(formCanonicalPoints(x, x_tmp, num_x), num_x, y);
+    Utils::Wrapper2D<double> ywrap(base->getNumPoints() * ((isFourier()) ? 2 : 1), y);
+    evaluateCanonicalBlocks(x, num_x, [&](const double x_canonical[], int num_block, int offset)->void{
+        base->evaluateHierarchicalFunctions(x_canonical, num_block, ywrap.getStrip(offset));
+    });
 }
 void TasmanianSparseGrid::evaluateHierarchicalFunctions(const std::vector<double> &x, std::vector<double> &y) const{
     int num_points = getNumPoints();
@@ -1119,6 +1314,8 @@ void TasmanianSparseGrid::evaluateSparseHierarchicalFunctionsStatic(const double
 }
 
 void TasmanianSparseGrid::setHierarchicalCoefficients(const double c[]){
+    base->clearCachedData();
+    if (base->getNumNeeded() > 0) base->clearCachedWeights();
     base->setHierarchicalCoefficients(c, acceleration);
 }
 void TasmanianSparseGrid::setHierarchicalCoefficients(const std::vector<double> &c){
@@ -1128,7 +1325,8 @@ void TasmanianSparseGrid::setHierarchicalCoefficients(const std::vector<double>
 }
 void TasmanianSparseGrid::integrateHierarchicalFunctions(double integrals[]) const{
     if (empty()) throw std::runtime_error("ERROR: cannot compute the integrals for a basis in an empty grid.");
-    base->integrateHierarchicalFunctions(integrals);
+    std::vector<double> const &cached_integrals = base->getCachedHierarchicalIntegrals();
+    std::copy(cached_integrals.begin(), cached_integrals.end(), integrals);
     if (domain_transform_a.size() != 0){
         double scale = getQuadratureScale(base->getNumDimensions(), base->getRule());
         for(int i=0; i<getNumPoints(); i++) integrals[i] *= scale;
@@ -1288,52 +1486,73 @@ void TasmanianSparseGrid::writeAscii(std::ostream &ofs) const{
     ofs << "TASMANIAN SG end" << endl;
 }
 void TasmanianSparseGrid::writeBinary(std::ostream &ofs) const{
-    const char *TSG = "TSG5"; // last char indicates version (update only if necessary, no need to sync with getVersionMajor())
-    ofs.write(TSG, 4 * sizeof(char)); // mark Tasmanian files
-    char flag;
-    // use Integers to indicate grid types, empty 'e', global 'g', sequence 's', pwpoly 'p', wavelet 'w', Fourier 'f'
+    // use characters to indicate grid types, empty 'e', global 'g', sequence 's', pwpoly 'p', wavelet 'w', Fourier 'f'
+    char grid_type = 'e';
     if (isGlobal()){
-        flag = 'g'; ofs.write(&flag, sizeof(char));
+        grid_type = 'g';
     }else if (isSequence()){
-        flag = 's'; ofs.write(&flag, sizeof(char));
+        grid_type = 's';
     }else if (isLocalPolynomial()){
-        flag = 'p'; ofs.write(&flag, sizeof(char));
+        grid_type = 'p';
     }else if (isWavelet()){
-        flag = 'w'; ofs.write(&flag, sizeof(char));
+        grid_type = 'w';
     }else if (isFourier()){
-        flag = 'f'; ofs.write(&flag, sizeof(char));
-    }else{
-        flag = 'e'; ofs.write(&flag, sizeof(char));
+        grid_type = 'f';
     }
-    if (!empty()) base->write(ofs, mode_binary);
-    // domain transform: custom 'y', canonical: 'n'
+    IO::SectionWriter sections(ofs, grid_type);
+    if (!empty()) base->writeSections(sections);
     if (domain_transform_a.size() != 0){
-        flag = 'y'; ofs.write(&flag, sizeof(char));
-        ofs.write((char*) domain_transform_a.data(), base->getNumDimensions() * sizeof(double));
-        ofs.write((char*) domain_transform_b.data(), base->getNumDimensions() * sizeof(double));
-    }else{
-        flag = 'n'; ofs.write(&flag, sizeof(char));
+        std::ostream &os = sections.addSection("domain");
+        IO::writeVector<mode_binary, IO::pad_none>(domain_transform_a, os);
+        IO::writeVector<mode_binary, IO::pad_none>(domain_transform_b, os);
+    }
+    if (conformal_asin_power.size() != 0)
+        IO::writeVector<mode_binary, IO::pad_none>(conformal_asin_power, sections.addSection("asin"));
+    if (!llimits.empty())
+        IO::writeVector<mode_binary, IO::pad_none>(llimits, sections.addSection("limits"));
+    if (usingDynamicConstruction)
+        base->writeConstructionData(sections.addSection("dynamic"), mode_binary);
+    sections.finish();
+}
+void TasmanianSparseGrid::readContainer(const char *data, size_t num_bytes, bool verify_checksums, std::shared_ptr<const void> const &data_owner){
+    IO::SectionReader sections(data, num_bytes, data_owner);
+    if (verify_checksums) sections.verify();
+    clear();
+    char grid_type = sections.getGridType();
+    if (grid_type == 'g'){
+        base = make_unique_ptr<GridGlobal>();
+    }else if (grid_type == 's'){
+        base = make_unique_ptr<GridSequence>();
+    }else if (grid_type == 'p'){
+        base = make_unique_ptr<GridLocalPolynomial>();
+    }else if (grid_type == 'w'){
+        base = make_unique_ptr<GridWavelet>();
+    }else if (grid_type == 'f'){
+        base = make_unique_ptr<GridFourier>();
+    }else if (grid_type != 'e'){
+        throw std::runtime_error("ERROR: wrong binary file format, unknown grid type");
     }
-    // conformal transforms: none 'n', asin 'a'
-    if (conformal_asin_power.size() != 0){
-        flag = 'a'; ofs.write(&flag, sizeof(char));
-        ofs.write((char*) conformal_asin_power.data(), base->getNumDimensions() * sizeof(int));
-    }else{
-        flag = 'n'; ofs.write(&flag, sizeof(char));
+    if (empty()) return;
+    base->readSections(sections);
+    if (sections.hasSection("domain")){
+        domain_transform_a.resize(base->getNumDimensions());
+        domain_transform_b.resize(base->getNumDimensions());
+        std::istream &is = sections.getSection("domain");
+        IO::readVector<mode_binary>(is, domain_transform_a);
+        IO::readVector<mode_binary>(is, domain_transform_b);
     }
-    if (!llimits.empty()){
-        flag = 'y'; ofs.write(&flag, sizeof(char));
-        ofs.write((char*) llimits.data(), base->getNumDimensions() * sizeof(int));
-    }else{
-        flag = 'n'; ofs.write(&flag, sizeof(char));
+    if (sections.hasSection("asin")){
+        conformal_asin_power.resize(base->getNumDimensions());
+        IO::readVector<mode_binary>(sections.getSection("asin"), conformal_asin_power);
     }
-    if (usingDynamicConstruction){
-        flag = 'c'; ofs.write(&flag, sizeof(char));
-        base->writeConstructionData(ofs, mode_binary);
-    }else{
-        flag = 's'; ofs.write(&flag, sizeof(char));
+    if (sections.hasSection("limits")){
+        llimits.resize(base->getNumDimensions());
+        IO::readVector<mode_binary>(sections.getSection("limits"), llimits);
+    }
+    if (sections.hasSection("dynamic")){
+        usingDynamicConstruction = true;
+        base->readConstructionData(sections.getSection("dynamic"), mode_binary);
     }
-    flag = 'e'; ofs.write(&flag, sizeof(char)); // E stands for END
 }
 void TasmanianSparseGrid::readAscii(std::istream &ifs){
     std::string T;
@@ -1438,8 +1657,22 @@ void TasmanianSparseGrid::readBinary(std::istream &ifs){
     if ((TSG[0] != 'T') || (TSG[1] != 'S') || (TSG[2] != 'G')){
         throw std::runtime_error("ERROR: wrong binary file format, first 3 bytes are not 'TSG'");
     }
+    if (TSG[3] == '6'){ // container format, the header gives the total size
+        std::vector<char> container(sizeof(IO::ContainerHeader));
+        std::copy_n(TSG.begin(), 4, container.begin());
+        ifs.read(&(container[4]), sizeof(IO::ContainerHeader) - 4);
+        IO::ContainerHeader header;
+        std::memcpy(&header, container.data(), sizeof(IO::ContainerHeader));
+        if (!ifs.good() || (header.endian != IO::container_endian) || (header.total_bytes < sizeof(IO::ContainerHeader)))
+            throw std::runtime_error("ERROR: wrong binary file format, corrupt container header");
+        container.resize((size_t) header.total_bytes);
+        ifs.read(&(container[sizeof(IO::ContainerHeader)]), (std::streamsize) (header.total_bytes - sizeof(IO::ContainerHeader)));
+        if (!ifs.good()) throw std::runtime_error("ERROR: wrong binary file format, the file is truncated");
+        readContainer(container.data(), container.size(), true); // the data is already in memory, verify the checksums
+        return;
+    }
     if (TSG[3] != '5'){
-        throw std::runtime_error("ERROR: wrong binary file format, version number is not '5'");
+        throw std::runtime_error("ERROR: wrong binary file format, version number is not '5' or '6'");
     }
     ifs.read(TSG.data(), sizeof(char)); // what type of grid is it?
     clear();
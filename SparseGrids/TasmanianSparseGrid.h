@@ -136,6 +136,8 @@ void tsgPrintStats(void *grid);
 void tsgEnableAcceleration(void *grid, const char *accel);
 //int tsgGetAccelerationTypeInt(void *grid){ return AccelerationMeta::getIOAccelerationInt(((TasmanianSparseGrid*) grid)->getAccelerationType()); } // int to acceleration type
 const char* tsgGetAccelerationType(void *grid);
+void tsgSetEvaluationThreads(void *grid, int num_threads, int block_size, int pin_threads);
+int tsgIsUsingExecutor(void *grid);
 void tsgSetGPUID(void *grid, int gpuID);
 int tsgGetGPUID(void *grid);
 int tsgGetNumGPUs();
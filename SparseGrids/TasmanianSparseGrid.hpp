@@ -158,6 +158,9 @@ namespace TasGrid{
  * has lower overhead in both file size and operations required to read/write,
  * the ASCII format is portable without considerations of endians and
  * for small grids the files are human-readable which helps debugging.
+ * The binary files hold the components of the grid (points, values, surpluses, etc.)
+ * in separate 64-byte aligned sections protected by checksums,
+ * binary files written by older versions of Tasmanian can still be read.
  * - read(), TasGrid::readGrid()
  * - write()
  *
@@ -237,7 +240,7 @@ namespace TasGrid{
  * libraries such as BLAS, cuBLAS and MAGAMA.
  * See the documentation for TasGrid::TypeAcceleration for details.
  * - evaluate()
- * - evaluateBatch()
+ * - evaluateBatch(), including single precision overloads for the CPU and BLAS modes
  * - evaluateFast()
  * - integrate()
  *
@@ -249,6 +252,8 @@ namespace TasGrid{
  * - enableAcceleration(), getAccelerationType(), favorSparseAcceleration()
  * - setGPUID(), getGPUID(), getNumGPUs()
  * - isAccelerationAvailable(), getGPUName(), getGPUMemory()
+ * - setExecutor(), isUsingExecutor(), see also TasGrid::makeThreadPoolExecutor()
+ * - setEvaluationThreads(), getExecutorBlockSize()
  *
  * \par Get Grid Meta-data
  * Various method that read the number of points, grid type, specifics about
@@ -302,7 +307,15 @@ public:
 
     //! \brief Write the grid to the given \b filename using either \b binary or ASCII format.
     void write(const char *filename, bool binary = mode_binary) const;
-    //! \brief Read the grid from the given \b filename, automatically detect the format.
+    /*!
+     * \brief Read the grid from the given \b filename, automatically detect the format.
+     *
+     * Binary files are memory mapped (where supported) and the points, model values and hierarchical coefficients
+     * are not copied, the grid reads them directly from the mapped file, which is shared by all processes
+     * that load the same file. The file must not be modified or truncated while the grid (or a copy of the grid) exists.
+     * The grid is read-only in the sense that any modification, e.g., loading values or refinement,
+     * first makes a private copy of the affected data.
+     */
     void read(const char *filename); // auto-check if format is binary or ascii
 
     //! \brief Write the grid to the given stream \b ofs using either \b binary or ASCII format.
@@ -683,6 +696,10 @@ public:
      * The quadrature is designed to work with weight of constant 1 unless the grid
      * \b rule is associated with a special weight. See TasGrid::TypeOneDRule for details.
      *
+     * The weights are computed on the first call and cached in the grid object,
+     * the cache is reused by integrate() and is discarded only when the set of points changes,
+     * e.g., loading new values for the same points does not recompute the weights.
+     *
      * \return A vector of size getNumPoints() holding the quadrature weights;
      * the order of the weights matches the getPoints().
      */
@@ -859,8 +876,73 @@ public:
      * \code
      * grid.evaluateBatch(x.data(), x.size() / grid.getNumDimensions(), y.data()); // using raw arrays
      * \endcode
+     *
+     * The container overload resizes \b y in the calling thread, hence the new pages are placed on the NUMA node of the caller.
+     * When pinned threads are used, see setEvaluationThreads(), the raw-array overload can write into memory
+     * that has not been touched yet, e.g., allocated with \b new \b double[] or \b std::malloc(),
+     * and each page of \b y will be placed on the NUMA node of the pinned thread that computes it.
      */
     void evaluateBatch(const double x[], int num_x, double y[]) const;
+    /*!
+     * \brief Computes only the outputs in the range \b outputs_begin to \b outputs_end - 1 for a batch of points.
+     *
+     * The result is the same as taking the corresponding columns of evaluateBatch(),
+     * but the basis functions are evaluated once and only the selected outputs of the surpluses
+     * (or loaded values) are used, hence the cost scales with the number of selected outputs
+     * and the grid does not have to be copied, compare to copyGrid() with an output range.
+     *
+     * \param[in] x is the same as in evaluateBatch().
+     * \param[in] outputs_begin is the first output to compute.
+     * \param[in] outputs_end is one more than the last output to compute,
+     *            if negative or larger than getNumOutputs() all outputs after \b outputs_begin are computed.
+     * \param[out] y is logically divided into strips of size \b outputs_end - \b outputs_begin,
+     *            one strip per point in \b x; the vector will be resized.
+     *
+     * \b Note: the selected outputs are always evaluated on the CPU, the BLAS and GPU acceleration modes are ignored.
+     *
+     * \throws std::invalid_argument if \b outputs_begin is not a valid output or the range is empty.
+     */
+    void evaluateBatch(std::vector<double> const &x, int outputs_begin, int outputs_end, std::vector<double> &y) const;
+    /*!
+     * \brief Overload that uses raw-arrays and an output range.
+     *
+     * Same as the vector overload, the \b y array must have size at least \b num_x times the number of selected outputs.
+     */
+    void evaluateBatch(const double x[], int num_x, int outputs_begin, int outputs_end, double y[]) const;
+    /*!
+     * \brief Computes only the outputs with indexes listed in \b outputs for a batch of points.
+     *
+     * Similar to the overload that uses a range of outputs, but the outputs are selected
+     * by an arbitrary list of indexes; the strips of \b y follow the order of \b outputs.
+     *
+     * \throws std::invalid_argument if \b outputs is empty or contains an index outside of the range 0 to getNumOutputs() - 1.
+     */
+    void evaluateBatch(std::vector<double> const &x, std::vector<int> const &outputs, std::vector<double> &y) const;
+    /*!
+     * \brief Computes the approximation at a batch of points using single precision arithmetic.
+     *
+     * Same as the double precision evaluateBatch(), but the points and the result are in single precision.
+     * The points are converted to double precision before the domain transform and the basis functions
+     * are computed in double precision, only the accumulation of the basis times the coefficients
+     * (or the matrix-matrix product in the BLAS mode) is done in single precision.
+     *
+     * The single precision copy of the coefficients is created on the first call and reused
+     * until the coefficients of the grid are modified, e.g., by loadNeededPoints().
+     * The copy is created in a thread-safe way, hence multiple threads can call this method concurrently.
+     *
+     * \param x is the same as in evaluateBatch().
+     * \param y will be resized to the number of points in \b x times getNumOutputs().
+     *
+     * \b Note: only the CPU and BLAS acceleration modes have single precision variants,
+     *           the GPU modes fall back to the CPU implementation.
+     */
+    void evaluateBatch(std::vector<float> const &x, std::vector<float> &y) const;
+    /*!
+     * \brief Overload of the single precision evaluateBatch() that uses raw-arrays.
+     *
+     * The \b y array must have size at least \b num_x times getNumOutputs().
+     */
+    void evaluateBatch(const float x[], int num_x, float y[]) const;
     /*!
      * \brief Overload that uses GPU raw-arrays.
      *
@@ -1567,6 +1649,63 @@ public:
      */
     static bool isAccelerationAvailable(TypeAcceleration acc);
 
+    /*!
+     * \brief Set an executor that replaces the OpenMP parallelism for the batch evaluations and the surplus computations.
+     *
+     * By default, the parallel loops use OpenMP (if enabled in CMake), which can oversubscribe the system
+     * when the grid is used inside an application that manages its own threads.
+     * If an executor is set, the CPU and BLAS modes of evaluateBatch() and evaluateHierarchicalFunctions()
+     * split the points into blocks and run the blocks as tasks of the executor,
+     * and the surpluses of Sequence and Local Polynomial grids computed by loadNeededPoints()
+     * (e.g., following a refinement) are processed in tasks of the executor one level at a time.
+     * The OpenMP loops called from within a task are restricted to one thread.
+     *
+     * \param new_executor is the executor to use, see TasGrid::ParallelExecutor;
+     *        an empty executor restores the default OpenMP mode.
+     * \param block_size is the number of points in a single task of evaluateBatch(),
+     *        larger blocks reduce the scheduling overhead while smaller blocks balance the load better;
+     *        non-positive value uses the default of 128 points.
+     *
+     * The executor is not copied with the grid (similar to the acceleration mode),
+     * but persists when a new grid is made or read using this object.
+     * A built-in thread pool executor is provided by TasGrid::makeThreadPoolExecutor().
+     *
+     * Example:
+     * \code
+     * auto grid = TasGrid::makeLocalPolynomialGrid(4, 1, 10);
+     * grid.setExecutor(TasGrid::makeThreadPoolExecutor(8)); // use a pool with 8 threads
+     * \endcode
+     */
+    void setExecutor(ParallelExecutor new_executor, int block_size = 0){
+        executor = std::move(new_executor);
+        executor_block_size = (block_size > 0) ? block_size : default_executor_block_size;
+    }
+    //! \brief Returns \b true if an executor has been set, see setExecutor().
+    bool isUsingExecutor() const{ return !!executor; }
+    //! \brief Returns the number of points in a single task of the executor, see setExecutor().
+    int getExecutorBlockSize() const{ return executor_block_size; }
+
+    /*!
+     * \brief Set the number of threads, the block size and the thread affinity used by evaluateBatch().
+     *
+     * Convenience method that sets an executor with a dedicated thread pool,
+     * equivalent to \b setExecutor(TasGrid::makeThreadPoolExecutor(num_threads, pin_threads), block_size).
+     *
+     * \param num_threads is the number of threads to use, including the calling thread;
+     *        zero restores the default OpenMP mode, i.e., removes the executor.
+     * \param block_size is the number of points in a single task, see setExecutor().
+     * \param pin_threads if \b true, the threads of the pool are pinned to the CPUs available to the process
+     *        and spread across the NUMA nodes (Linux only), the blocks are partitioned statically between the threads
+     *        and the calling thread only waits, see TasGrid::ThreadPool;
+     *        hence, repeated calls with the same number of points assign the same part of the output
+     *        to the same core, and the output pages are first touched by the NUMA node that later uses them.
+     *        The std::vector overloads of evaluateBatch() resize the output in the calling thread,
+     *        use the raw-array overloads with untouched memory to have the pages first touched by the pool.
+     *
+     * \throws std::invalid_argument if \b num_threads is negative.
+     */
+    void setEvaluationThreads(int num_threads, int block_size = 0, bool pin_threads = false);
+
     /*!
      * \brief Select the current CUDA device.
      *
@@ -1808,14 +1947,6 @@ protected:
      * \endinternal
      */
     void mapCanonicalToTransformed(int num_dimensions, int num_points, TypeOneDRule rule, double x[]) const;
-    /*!
-     * \internal
-     * \brief Apply the inverse map from transformed to canonical points.
-     *
-     * Similar to mapCanonicalToTransformed(), uses the inverse transform.
-     * \endinternal
-     */
-    void mapTransformedToCanonical(int num_dimensions, int num_points, TypeOneDRule rule, double x[]) const;
     /*!
      * \internal
      * \brief Returns the quadrature scale factor associated with the linear transform.
@@ -1836,12 +1967,28 @@ protected:
     void mapConformalCanonicalToTransformed(int num_dimensions, int num_points, double x[]) const;
     /*!
      * \internal
-     * \brief Applies the inverse non-linear transformation to the points.
+     * \brief Maps the transformed points \b x to canonical points, applies the inverse of both transformations.
      *
-     * Using the set conformal transform (private variables), applies the inverse non-linear transform.
+     * Writes the result into \b x_canonical, the points are read once and pass through the inverse
+     * non-linear transform followed by the inverse linear transform, the constants of both transforms
+     * are computed once per call. The input can be given in either single or double precision.
+     * \endinternal
+     */
+    template<typename T> void mapToCanonical(int num_x, const T x[], double x_canonical[]) const;
+    /*!
+     * \internal
+     * \brief Calls \b eval for blocks of the canonical equivalent of the points \b x.
+     *
+     * If an executor is set, the blocks have \b executor_block_size points and are processed as tasks of the executor,
+     * and the output of each block is written only by the thread that runs the task.
+     * If no transforms are set and \b x is in double precision, then \b eval is called once with \b x.
+     * Otherwise, each block of at most \b canonical_block_size points is mapped to a buffer that is reused
+     * across the blocks, and \b eval is called with the canonical points, the size of the block
+     * and the \b offset of the first point of the block.
+     * Thus, the memory overhead is independent of \b num_x.
      * \endinternal
      */
-    void mapConformalTransformedToCanonical(int num_dimensions, int num_points, Data2D<double> &x) const;
+    template<typename T> void evaluateCanonicalBlocks(const T x[], int num_x, std::function<void(const double x_canonical[], int num_block, int offset)> eval) const;
     /*!
      * \internal
      * \brief Computes the quadrature weight correction for the conformal map.
@@ -1904,7 +2051,8 @@ protected:
      * \internal
      * \brief Write the grid to a stream using binary format.
      *
-     * Uses an open stream, writes the grid.
+     * Uses an open stream, writes the grid using the container format with a section directory,
+     * see IO::SectionWriter.
      * \endinternal
      */
     void writeBinary(std::ostream &ofs) const;
@@ -1912,14 +2060,31 @@ protected:
      * \internal
      * \brief Read the grid from a stream using binary format.
      *
-     * Uses an open stream, read the grid.
+     * Uses an open stream, read the grid, accepts both the container format and the older sequential format.
      * \throws std::runtime_error if Tasmanian detects a problem with the file format.
      * \endinternal
      */
     void readBinary(std::istream &ifs);
+    /*!
+     * \internal
+     * \brief Read the grid from the binary container held in memory, e.g., a memory mapped file.
+     *
+     * The header and the directory are always validated, the checksums of the payloads are verified
+     * only if \b verify_checksums is \b true, which requires reading the entire container.
+     * If \b data_owner is provided, it must keep the \b data alive and the points, values and surpluses
+     * of the grid become read-only views into the \b data (copied only if the grid is modified),
+     * otherwise the data is copied.
+     * \throws std::runtime_error if the container is corrupt, e.g., a checksum does not match.
+     * \endinternal
+     */
+    void readContainer(const char *data, size_t num_bytes, bool verify_checksums,
+                       std::shared_ptr<const void> const &data_owner = std::shared_ptr<const void>());
     #endif // __TASMANIAN_DOXYGEN_SKIP_INTERNAL
 
 private:
+    static constexpr int canonical_block_size = 4096; // number of points mapped to canonical together by evaluateCanonicalBlocks()
+    static constexpr int default_executor_block_size = 128; // default number of points in a single task of the executor
+
     std::unique_ptr<BaseCanonicalGrid> base;
 
     std::vector<double> domain_transform_a, domain_transform_b;
@@ -1931,6 +2096,11 @@ private:
 
     bool usingDynamicConstruction;
 
+    ParallelExecutor executor;
+    int executor_block_size; // number of points in a single task of the executor
+
+    Utils::WorkspacePool<Data2D<double>> canonical_workspaces; // canonical points used by the single point evaluate()
+
     #ifdef Tasmanian_ENABLE_CUDA
     mutable std::unique_ptr<CudaEngine> engine;
     mutable std::unique_ptr<AccelerationDomainTransform> acc_domain;
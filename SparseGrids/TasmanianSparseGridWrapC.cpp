@@ -456,6 +456,8 @@ void tsgPrintStats(void *grid){ ((TasmanianSparseGrid*) grid)->printStats(); }
 void tsgEnableAcceleration(void *grid, const char *accel){ ((TasmanianSparseGrid*) grid)->enableAcceleration(AccelerationMeta::getIOAccelerationString(accel)); }
 //int tsgGetAccelerationTypeInt(void *grid){ return AccelerationMeta::getIOAccelerationInt(((TasmanianSparseGrid*) grid)->getAccelerationType()); } // int to acceleration type
 const char* tsgGetAccelerationType(void *grid){ return AccelerationMeta::getIOAccelerationString(((TasmanianSparseGrid*) grid)->getAccelerationType()); }
+void tsgSetEvaluationThreads(void *grid, int num_threads, int block_size, int pin_threads){ ((TasmanianSparseGrid*) grid)->setEvaluationThreads(num_threads, block_size, (pin_threads != 0)); }
+int tsgIsUsingExecutor(void *grid){ return (((TasmanianSparseGrid*) grid)->isUsingExecutor()) ? 1 : 0; }
 
 void tsgSetGPUID(void *grid, int gpuID){ ((TasmanianSparseGrid*) grid)->setGPUID(gpuID); }
 int tsgGetGPUID(void *grid){ return ((TasmanianSparseGrid*) grid)->getGPUID(); }
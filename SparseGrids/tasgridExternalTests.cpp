@@ -1862,6 +1862,40 @@ bool ExternalTester::testAcceleration(const BaseFunction *f, TasmanianSparseGrid
         }
     }
 
+    // evaluate a subset of the outputs, the last output by range and all outputs in reverse order by list
+    grid->evaluateBatch(x, outs - 1, outs, test_y);
+    double err = 0.0;
+    for(int i=0; i<num_x; i++) err = std::max(err, std::abs(test_y[i] - baseline_y[i*outs + outs - 1]));
+    std::vector<int> reversed(outs);
+    for(int k=0; k<outs; k++) reversed[k] = outs - k - 1;
+    grid->evaluateBatch(x, reversed, test_y);
+    for(int i=0; i<num_x; i++)
+        for(int k=0; k<outs; k++) err = std::max(err, std::abs(test_y[i*outs + k] - baseline_y[i*outs + reversed[k]]));
+    if (err > 1.E-11){
+        pass = false;
+        cout << "Failed output subset evaluation, observed error: " << err << " for function: " << f->getDescription() << endl;
+        grid->printStats();
+    }
+
+    // single precision evaluations, compared against double precision at the same (rounded) points
+    std::vector<float> xf(x.begin(), x.end()), test_yf;
+    std::vector<double> xd(xf.begin(), xf.end()), ref_y;
+    grid->enableAcceleration(accel_none);
+    grid->evaluateBatch(xd, ref_y);
+    double scale = 1.0;
+    for(auto v : ref_y) scale = std::max(scale, std::abs(v));
+    for(auto a : {accel_none, accel_cpu_blas}){
+        grid->enableAcceleration(a);
+        grid->evaluateBatch(xf, test_yf);
+        err = 0.0;
+        for(size_t i=0; i<ref_y.size(); i++) err = std::max(err, std::abs(((double) test_yf[i]) - ref_y[i]));
+        if ((test_yf.size() != ref_y.size()) || (err > 1.E-5 * scale)){
+            pass = false;
+            cout << "Failed single precision evaluation, observed error: " << err << " for function: " << f->getDescription() << endl;
+            grid->printStats();
+        }
+    }
+
     //cout << "End of acceleration test." << endl;
     return pass;
 }
@@ -137,6 +137,13 @@ int testInterfaceC(){
     for(i=0; i<numx; i++) if (fabs(external_result[i] - internal_result[i]) > err) err = fabs(external_result[i] - internal_result[i]);
     if (err > 1.E-13){ printf("ERROR: mismatch in external and internal sparse hierarchical matrix.\n"); return 0; }
 
+    tsgSetEvaluationThreads(grid, 3, 4, 1); // small blocks, so that all threads get work
+    if (tsgIsUsingExecutor(grid) != 1){ printf("ERROR: tsgSetEvaluationThreads() did not set the thread pool.\n"); return 0; }
+    tsgEvaluateBatch(grid, x2, numx, external_result);
+    for(i=0; i<numx; i++) if (fabs(external_result[i] - internal_result[i]) > 1.E-15){ printf("ERROR: mismatch in tsgEvaluateBatch() using evaluation threads.\n"); return 0; }
+    tsgSetEvaluationThreads(grid, 0, 0, 0);
+    if (tsgIsUsingExecutor(grid) != 0){ printf("ERROR: tsgSetEvaluationThreads() did not restore the default mode.\n"); return 0; }
+
     free(pntr);
     free(indx);
     free(vals);
@@ -244,6 +244,360 @@ bool GridUnitTester::testAPIconsistency(){
     if (verbose) cout << setw(wfirst) << "API variation" << setw(wsecond) << "level limits" << setw(wthird) << ((pass) ? "Pass" : "FAIL") << endl;
     passAll = pass && passAll;
 
+    // test the binary container format, round trip and detection of corrupt data
+    pass = true;
+    grid.makeLocalPolynomialGrid(2, 1, 4, 2, rule_localp);
+    gridLoadEN2(&grid);
+    grid.setDomainTransform({-2.0, 1.0}, {1.0, 2.0});
+    grid.setSurplusRefinement(1.E-4, refine_classic);
+    std::stringstream container;
+    grid.write(container, mode_binary);
+    std::string container_data = container.str();
+    TasmanianSparseGrid grid_copy;
+    grid_copy.read(container, mode_binary);
+    std::vector<double> ycopy;
+    grid.evaluate(x, vy);
+    grid_copy.evaluate(x, ycopy);
+    pass = pass && doesMatch(vy, ycopy) && (grid.getNumNeeded() == grid_copy.getNumNeeded()) && grid_copy.isSetDomainTransfrom();
+    uint64_t first_payload; // offset of the first section, stored after the 64-byte header and the 8-byte tag
+    std::memcpy(&first_payload, &(container_data[72]), sizeof(uint64_t));
+    container_data[(size_t) first_payload] ^= 1; // flip a bit in the payload
+    std::stringstream corrupt(container_data);
+    try{
+        grid_copy.read(corrupt, mode_binary);
+        pass = false;
+    }catch(std::runtime_error &){}
+
+    { // the checksum does not depend on the way the data is split into chunks
+        std::string payload = container.str();
+        IO::Checksum chunked;
+        size_t chunk = 1, offset = 0;
+        while(offset < payload.size()){
+            size_t count = std::min(chunk, payload.size() - offset);
+            chunked.update(&(payload[offset]), count);
+            offset += count;
+            chunk = (chunk % 13) + 1;
+        }
+        pass = pass && (chunked.get() == IO::checksum(payload.data(), payload.size()));
+    }
+
+    { // a destination that cannot seek gets the same container
+        struct AppendBuffer : public std::streambuf{
+            std::string data;
+            int_type overflow(int_type c) override{ data.push_back(traits_type::to_char_type(c)); return c; }
+            std::streamsize xsputn(const char *s, std::streamsize n) override{ data.append(s, (size_t) n); return n; }
+        };
+        AppendBuffer append_buffer;
+        std::ostream append_stream(&append_buffer);
+        grid.write(append_stream, mode_binary);
+        pass = pass && (append_buffer.data == container.str());
+    }
+
+    { // a section size that overflows the offset is rejected even if the directory checksum matches
+        container_data = container.str();
+        IO::ContainerHeader header;
+        std::memcpy(&header, container_data.data(), sizeof(IO::ContainerHeader));
+        std::vector<IO::ContainerSection> directory(header.num_sections);
+        std::memcpy(directory.data(), &(container_data[sizeof(IO::ContainerHeader)]), directory.size() * sizeof(IO::ContainerSection));
+        directory[0].num_bytes = ~directory[0].offset + 1; // offset + num_bytes wraps around to zero
+        header.directory_checksum = IO::checksum(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(IO::ContainerSection));
+        std::memcpy(&(container_data[0]), &header, sizeof(IO::ContainerHeader));
+        std::memcpy(&(container_data[sizeof(IO::ContainerHeader)]), directory.data(), directory.size() * sizeof(IO::ContainerSection));
+        std::stringstream wrapped(container_data);
+        try{
+            grid_copy.read(wrapped, mode_binary);
+            pass = false;
+        }catch(std::runtime_error &){}
+    }
+
+    if (verbose) cout << setw(wfirst) << "API variation" << setw(wsecond) << "binary container" << setw(wthird) << ((pass) ? "Pass" : "FAIL") << endl;
+    passAll = pass && passAll;
+
+    // test the read-only views into a container that is kept in memory, e.g., a memory mapped file
+    pass = true;
+    {
+        grid.makeLocalPolynomialGrid(2, 1, 4, 2, rule_localp);
+        gridLoadEN2(&grid);
+        std::stringstream container_stream;
+        grid.write(container_stream, mode_binary);
+        auto owner = std::make_shared<std::string>(container_stream.str());
+        std::string const original = *owner;
+        IO::SectionReader sections(owner->data(), owner->size(), owner);
+        MultiIndexSet mapped_points;
+        mapped_points.read(sections, "points");
+        StorageSet mapped_values;
+        mapped_values.read(sections, "values");
+        Data2D<double> mapped_surpluses = IO::readData2D<double>(sections, "surplus", 1, mapped_points.getNumIndexes());
+        StorageSet const &cvalues = mapped_values; // the const methods do not copy the data
+        Data2D<double> const &csurpluses = mapped_surpluses;
+        auto in_container = [&](void const *p)->bool{
+            return (static_cast<char const*>(p) >= owner->data()) && (static_cast<char const*>(p) < owner->data() + owner->size());
+        };
+        std::vector<double> surpluses(csurpluses.getStrip(0), csurpluses.getStrip(0) + csurpluses.getTotalEntries());
+        pass = mapped_points.isReadOnly() && mapped_values.isReadOnly() && mapped_surpluses.isReadOnly()
+               && in_container(mapped_points.getIndex(0)) && in_container(cvalues.getValues(0)) && in_container(csurpluses.getStrip(0))
+               && (csurpluses.getIStrip(1) == csurpluses.getStrip(1)) && mapped_surpluses.isReadOnly()
+               && (mapped_points.getNumIndexes() == grid.getNumPoints()) && doesMatch(surpluses, grid.getHierarchicalCoefficients(), 0.0);
+        MultiIndexSet points_copy = mapped_points; // copies share the view
+        pass = pass && points_copy.isReadOnly() && (points_copy.getIndex(0) == mapped_points.getIndex(0));
+        mapped_surpluses.getStrip(0)[0] += 1.0; // the non-const access makes a private copy
+        mapped_values.getValues(0)[0] += 1.0;
+        points_copy.getVector()[0] += 1;
+        pass = pass && !mapped_surpluses.isReadOnly() && !mapped_values.isReadOnly() && !points_copy.isReadOnly() && mapped_points.isReadOnly()
+               && !in_container(csurpluses.getStrip(0)) && (*owner == original);
+    }
+    {
+        std::string filename = "tasgrid_mapped_read.grid";
+        std::vector<TasmanianSparseGrid> reference(3);
+        reference[0].makeLocalPolynomialGrid(2, 1, 4, 2, rule_localp);
+        reference[1].makeSequenceGrid(2, 1, 4, type_level, rule_leja);
+        reference[2].makeGlobalGrid(2, 1, 3, type_level, rule_clenshawcurtis);
+        std::vector<double> xtest = {0.3, -0.4, 0.1, 0.2, -0.7, 0.9}, yref, ymapped;
+        for(auto &ref : reference){
+            gridLoadEN2(&ref);
+            ref.write(filename.c_str(), mode_binary);
+            TasmanianSparseGrid mapped;
+            mapped.read(filename.c_str());
+            std::remove(filename.c_str()); // the mapping is valid after the file is unlinked
+            ref.evaluateBatch(xtest, yref);
+            mapped.evaluateBatch(xtest, ymapped);
+            pass = pass && doesMatch(yref, ymapped, 0.0) && doesMatch(ref.getLoadedPoints(), mapped.getLoadedPoints(), 0.0);
+            if (!ref.isGlobal()){
+                std::vector<double> coefficients(ref.getHierarchicalCoefficients(), ref.getHierarchicalCoefficients() + ref.getNumPoints());
+                pass = pass && doesMatch(coefficients, mapped.getHierarchicalCoefficients(), 0.0);
+            }
+
+            TasmanianSparseGrid mapped_copy = mapped; // the copy shares the mapping
+            if (ref.isGlobal()){
+                ref.setAnisotropicRefinement(type_iptotal, 10, 0);
+                mapped.setAnisotropicRefinement(type_iptotal, 10, 0);
+            }else if (ref.isSequence()){
+                ref.setSurplusRefinement(1.E-4, 0);
+                mapped.setSurplusRefinement(1.E-4, 0);
+            }else{
+                ref.setSurplusRefinement(1.E-4, refine_classic);
+                mapped.setSurplusRefinement(1.E-4, refine_classic);
+            }
+            gridLoadEN2(&ref); // modifying the grid makes a private copy of the data
+            gridLoadEN2(&mapped);
+            ref.evaluateBatch(xtest, yref);
+            mapped.evaluateBatch(xtest, ymapped);
+            pass = pass && (ref.getNumPoints() == mapped.getNumPoints()) && doesMatch(yref, ymapped, 0.0);
+            mapped_copy.evaluateBatch(xtest, ymapped);
+            pass = pass && (mapped_copy.getNumPoints() < mapped.getNumPoints()) && (ymapped.size() == yref.size());
+        }
+    }
+
+    if (verbose) cout << setw(wfirst) << "API variation" << setw(wsecond) << "mapped read" << setw(wthird) << ((pass) ? "Pass" : "FAIL") << endl;
+    passAll = pass && passAll;
+
+    // test that the cached single precision coefficients follow the changes in the model values
+    pass = true;
+    grid.makeSequenceGrid(2, 1, 4, type_level, rule_leja);
+    std::vector<double> seq_points, seq_values;
+    grid.getNeededPoints(seq_points);
+    for(size_t i=0; i<seq_points.size(); i+=2) seq_values.push_back(std::exp(seq_points[i] + seq_points[i+1]));
+    grid.loadNeededPoints(seq_values);
+    std::vector<float> xf = {0.3f, -0.4f, 0.1f, 0.2f}, yf_first, yf_second;
+    grid.evaluateBatch(xf, yf_first);
+    for(auto &v : seq_values) v *= 2.0;
+    grid.loadNeededPoints(seq_values);
+    grid.evaluateBatch(xf, yf_second);
+    if ((yf_first.size() != 2) || (yf_second.size() != 2)) pass = false;
+    for(size_t i=0; pass && (i<yf_first.size()); i++)
+        if (std::abs(yf_second[i] - 2.0f * yf_first[i]) > 1.E-5) pass = false;
+
+    if (verbose) cout << setw(wfirst) << "API variation" << setw(wsecond) << "single precision" << setw(wthird) << ((pass) ? "Pass" : "FAIL") << endl;
+    passAll = pass && passAll;
+
+    // test that the cached quadrature weights are reused for new values and recomputed for new points
+    pass = true;
+    grid.makeLocalPolynomialGrid(2, 1, 3, 1, rule_localp);
+    std::vector<double> lp_points, lp_values;
+    grid.getNeededPoints(lp_points);
+    auto lp_model = [&]()->void{
+        lp_values.clear();
+        for(size_t i=0; i<lp_points.size(); i+=2) lp_values.push_back(lp_points[i] * lp_points[i] + lp_points[i+1]);
+    };
+    lp_model();
+    grid.loadNeededPoints(lp_values);
+    std::vector<double> lp_integral_first, lp_integral_second;
+    grid.integrate(lp_integral_first);
+    for(auto &v : lp_values) v *= 2.0;
+    grid.loadNeededPoints(lp_values);
+    grid.integrate(lp_integral_second);
+    if (std::abs(lp_integral_second[0] - 2.0 * lp_integral_first[0]) > Maths::num_tol) pass = false;
+    grid.setSurplusRefinement(1.E-4, refine_classic);
+    grid.getNeededPoints(lp_points);
+    lp_model();
+    grid.loadNeededPoints(lp_values);
+    std::vector<double> lp_weights = grid.getQuadratureWeights();
+    if ((int) lp_weights.size() != grid.getNumPoints()) pass = false;
+    if (std::abs(std::accumulate(lp_weights.begin(), lp_weights.end(), 0.0) - 4.0) > Maths::num_tol) pass = false;
+
+    if (verbose) cout << setw(wfirst) << "API variation" << setw(wsecond) << "cached weights" << setw(wthird) << ((pass) ? "Pass" : "FAIL") << endl;
+    passAll = pass && passAll;
+
+    // test that the domain transform applied in blocks matches the canonical grid, using more points than a single block
+    pass = true;
+    grid.makeSequenceGrid(2, 1, 5, type_level, rule_rleja);
+    std::vector<double> canonical_points = grid.getNeededPoints();
+    std::vector<double> canonical_values(canonical_points.size() / 2);
+    for(size_t i=0; i<canonical_values.size(); i++) canonical_values[i] = std::exp(canonical_points[2*i] - 0.5 * canonical_points[2*i+1]);
+    grid.loadNeededPoints(canonical_values);
+    auto transformed_grid = grid;
+    transformed_grid.setDomainTransform({1.0, -3.0}, {3.0, 5.0});
+    std::vector<double> xcanonical(2 * 5000), xtransformed(2 * 5000);
+    for(size_t i=0; i<xcanonical.size(); i += 2){
+        xcanonical[i]     = std::sin((double) i);
+        xcanonical[i + 1] = std::cos((double) i);
+        xtransformed[i]     = 2.0 + xcanonical[i];
+        xtransformed[i + 1] = 1.0 + 4.0 * xcanonical[i + 1];
+    }
+    std::vector<double> ycanonical, ytransformed;
+    grid.evaluateBatch(xcanonical, ycanonical);
+    transformed_grid.evaluateBatch(xtransformed, ytransformed);
+    for(size_t i=0; i<ycanonical.size(); i++)
+        if (std::abs(ycanonical[i] - ytransformed[i]) > Maths::num_tol) pass = false;
+    std::vector<float> xftransformed(xtransformed.begin(), xtransformed.end()), yftransformed;
+    transformed_grid.evaluateBatch(xftransformed, yftransformed);
+    for(size_t i=0; i<ycanonical.size(); i++)
+        if (std::abs(ycanonical[i] - yftransformed[i]) > 1.E-5) pass = false;
+
+    if (verbose) cout << setw(wfirst) << "API variation" << setw(wsecond) << "blocked transform" << setw(wthird) << ((pass) ? "Pass" : "FAIL") << endl;
+    passAll = pass && passAll;
+
+    // test that the executor is used and gives the same result as the default mode
+    pass = true;
+    int num_executor_tasks = 0;
+    auto counting_executor = [&](int num_tasks, std::function<void(int)> const &task)->void{
+        for(int t=0; t<num_tasks; t++) task(t);
+        num_executor_tasks += num_tasks;
+    };
+    for(int use_pool=0; use_pool<2; use_pool++){
+        TasmanianSparseGrid reference_grid = makeLocalPolynomialGrid(2, 2, 4, 2, rule_semilocalp);
+        TasmanianSparseGrid executor_grid;
+        if (use_pool == 0) executor_grid.setExecutor(counting_executor); else executor_grid.setExecutor(makeThreadPoolExecutor(3));
+        executor_grid.makeLocalPolynomialGrid(2, 2, 4, 2, rule_semilocalp);
+        if (!executor_grid.isUsingExecutor()) pass = false;
+        for(int iteration=0; iteration<2; iteration++){
+            std::vector<double> exec_points = reference_grid.getNeededPoints();
+            std::vector<double> exec_values(exec_points.size());
+            for(size_t i=0; i<exec_points.size(); i+=2){
+                exec_values[i]     = std::exp(exec_points[i] + exec_points[i+1]);
+                exec_values[i + 1] = std::cos(exec_points[i] - exec_points[i+1]);
+            }
+            reference_grid.loadNeededPoints(exec_values);
+            executor_grid.loadNeededPoints(exec_values);
+            reference_grid.setSurplusRefinement(1.E-4, refine_classic, 0);
+            executor_grid.setSurplusRefinement(1.E-4, refine_classic, 0);
+        }
+        std::vector<double> yreference, yexecutor;
+        reference_grid.evaluateBatch(xcanonical, yreference);
+        executor_grid.evaluateBatch(xcanonical, yexecutor);
+        for(size_t i=0; i<yreference.size(); i++)
+            if (std::abs(yreference[i] - yexecutor[i]) > Maths::num_tol) pass = false;
+    }
+    if (num_executor_tasks == 0) pass = false;
+
+    if (verbose) cout << setw(wfirst) << "API variation" << setw(wsecond) << "executor" << setw(wthird) << ((pass) ? "Pass" : "FAIL") << endl;
+    passAll = pass && passAll;
+
+    // test the per-grid thread count, block size and pinning
+    pass = true;
+    {
+        ThreadPool pinned_pool(3, true); // static partition must cover each task exactly once
+        std::vector<int> task_count(37, 0);
+        pinned_pool.run((int) task_count.size(), [&](int t)->void{ task_count[t]++; });
+        if (std::any_of(task_count.begin(), task_count.end(), [](int c)->bool{ return (c != 1); })) pass = false;
+
+        // the same task runs in the same pinned worker, never in the calling thread
+        std::vector<std::thread::id> first_owner(task_count.size()), second_owner(task_count.size());
+        pinned_pool.run((int) first_owner.size(), [&](int t)->void{ first_owner[t] = std::this_thread::get_id(); });
+        pinned_pool.run((int) second_owner.size(), [&](int t)->void{ second_owner[t] = std::this_thread::get_id(); });
+        std::thread::id single_owner;
+        pinned_pool.run(1, [&](int)->void{ single_owner = std::this_thread::get_id(); });
+        if ((pinned_pool.getNumThreads() != 3) || (first_owner != second_owner) || (single_owner == std::this_thread::get_id())
+            || (std::find(first_owner.begin(), first_owner.end(), std::this_thread::get_id()) != first_owner.end())) pass = false;
+
+        std::vector<int> pinned_cpus = ThreadPool::getPinnedCPUs(); // each allowed CPU is listed once
+        std::vector<int> sorted_cpus = pinned_cpus;
+        std::sort(sorted_cpus.begin(), sorted_cpus.end());
+        if (std::unique(sorted_cpus.begin(), sorted_cpus.end()) != sorted_cpus.end()) pass = false;
+        #ifdef __linux__
+        if (pinned_cpus.empty()) pass = false;
+        #endif
+
+        TasmanianSparseGrid reference_grid = makeSequenceGrid(2, 1, 6, type_level, rule_leja);
+        TasmanianSparseGrid threaded_grid  = makeSequenceGrid(2, 1, 6, type_level, rule_leja);
+        std::vector<double> thread_points = reference_grid.getNeededPoints();
+        std::vector<double> thread_values(thread_points.size() / 2);
+        for(size_t i=0; i<thread_values.size(); i++) thread_values[i] = std::exp(thread_points[2*i] - thread_points[2*i+1]);
+        reference_grid.loadNeededPoints(thread_values);
+        threaded_grid.loadNeededPoints(thread_values);
+        std::vector<double> yreference;
+        reference_grid.evaluateBatch(xcanonical, yreference);
+        int num_x = (int) (xcanonical.size() / 2);
+        for(int pin=0; pin<2; pin++){
+            for(int block_size : {0, 1, 7}){
+                threaded_grid.setEvaluationThreads(3, block_size, (pin == 1));
+                if (!threaded_grid.isUsingExecutor()) pass = false;
+                if (threaded_grid.getExecutorBlockSize() != ((block_size > 0) ? block_size : 128)) pass = false;
+                std::vector<double> ythreaded(yreference.size());
+                threaded_grid.evaluateBatch(xcanonical.data(), num_x, ythreaded.data());
+                for(size_t i=0; i<yreference.size(); i++)
+                    if (std::abs(yreference[i] - ythreaded[i]) > Maths::num_tol) pass = false;
+                std::vector<double> yvector; // the vector overload gives the same result
+                threaded_grid.evaluateBatch(xcanonical, yvector);
+                if (!doesMatch(yreference, yvector)) pass = false;
+            }
+        }
+        threaded_grid.setEvaluationThreads(0);
+        if (threaded_grid.isUsingExecutor()) pass = false;
+        try{
+            threaded_grid.setEvaluationThreads(-1);
+            pass = false; // should have thrown
+        }catch(std::invalid_argument &){}
+    }
+
+    if (verbose) cout << setw(wfirst) << "API variation" << setw(wsecond) << "evaluation threads" << setw(wthird) << ((pass) ? "Pass" : "FAIL") << endl;
+    passAll = pass && passAll;
+
+    // test the incremental update of the surpluses after refinement, compare to recomputing all surpluses
+    pass = true;
+    {
+        auto match_recomputed = [&](TasmanianSparseGrid const &refined)->bool{
+            TasmanianSparseGrid recomputed = refined; // no needed points, loading the values will recompute all surpluses
+            size_t num_values = ((size_t) refined.getNumOutputs()) * ((size_t) refined.getNumLoaded());
+            recomputed.loadNeededPoints(std::vector<double>(refined.getLoadedValues(), refined.getLoadedValues() + num_values));
+            std::vector<double> surpluses(refined.getHierarchicalCoefficients(), refined.getHierarchicalCoefficients() + num_values);
+            return doesMatch(surpluses, recomputed.getHierarchicalCoefficients(), Maths::num_tol);
+        };
+        for(int num_threads : {0, 3}){
+            for(auto criteria : {refine_classic, refine_parents_first, refine_fds}){
+                TasmanianSparseGrid refined = makeLocalPolynomialGrid(2, 2, 3, 2, rule_localp);
+                refined.setEvaluationThreads(num_threads);
+                gridLoadEN2(&refined);
+                for(int i=0; i<2; i++){
+                    refined.setSurplusRefinement(1.E-3, criteria, -1);
+                    gridLoadEN2(&refined);
+                }
+                if (!match_recomputed(refined)) pass = false;
+            }
+            TasmanianSparseGrid refined = makeSequenceGrid(2, 2, 3, type_level, rule_leja);
+            refined.setEvaluationThreads(num_threads);
+            gridLoadEN2(&refined);
+            for(int i=0; i<2; i++){
+                refined.setAnisotropicRefinement(type_iptotal, 10, 0);
+                gridLoadEN2(&refined);
+            }
+            if (!match_recomputed(refined)) pass = false;
+        }
+    }
+
+    if (verbose) cout << setw(wfirst) << "API variation" << setw(wsecond) << "incremental surpluses" << setw(wthird) << ((pass) ? "Pass" : "FAIL") << endl;
+    passAll = pass && passAll;
+
     // test integer-to-enumerate and string-to-enumerate conversion
     pass = true;
     std::vector<TypeAcceleration> allacc = {accel_none, accel_cpu_blas, accel_gpu_default, accel_gpu_cublas, accel_gpu_cuda, accel_gpu_magma};
@@ -472,6 +826,18 @@ std::vector<std::function<void(void)>> GridUnitTester::getInvalidArgumentCalls()
             auto grid = makeLocalPolynomialGrid(2, 1, 3);
             grid.setDomainTransform({1.0, 2.0}, {4.0});  // b is too small
         },
+        [](void)->void{
+            auto grid = makeLocalPolynomialGrid(2, 2, 3);
+            gridLoadEN2(&grid);
+            std::vector<double> y;
+            grid.evaluateBatch({0.3, 0.3}, 2, 3, y);  // output range is empty
+        },
+        [](void)->void{
+            auto grid = makeLocalPolynomialGrid(2, 2, 3);
+            gridLoadEN2(&grid);
+            std::vector<double> y;
+            grid.evaluateBatch({0.3, 0.3}, std::vector<int>{0, 2}, y);  // output 2 is out of range
+        },
         [](void)->void{
             CustomTabulated custom;
             custom.read("phantom.file");
@@ -70,8 +70,23 @@ public:
      * - \b holds the coordinates of the canonical point to cache
      */
     CacheLagrange(int num_dimensions, const std::vector<int> &max_levels, const OneDimensionalWrapper &rule, const double x[]){
+        cacheValues(num_dimensions, max_levels, rule, x);
+    }
+    //! \brief Default constructor, creates an empty cache to be filled with cacheValues().
+    CacheLagrange(){}
+    //! \brief Destructor, clear all used data.
+    ~CacheLagrange(){}
+
+    /*!
+     * \brief Recomputes the cache for a new point \b x, the parameters are the same as in the constructor.
+     *
+     * The internal vectors are resized but not released, hence a cache that is reused across multiple points
+     * will not perform any memory allocations once it has grown to the required size.
+     */
+    void cacheValues(int num_dimensions, const std::vector<int> &max_levels, const OneDimensionalWrapper &rule, const double x[]){
         cache.resize(num_dimensions);
-        offsets = rule.getPointsCount();
+        const std::vector<int> &counts = rule.getPointsCount();
+        offsets.assign(counts.begin(), counts.end());
 
         for(int dim=0; dim<num_dimensions; dim++){
             cache[dim].resize(offsets[max_levels[dim] + 1]);
@@ -79,8 +94,6 @@ public:
                 cacheLevel(level, x[dim], rule, &(cache[dim][offsets[level]]));
         }
     }
-    //! \brief Destructor, clear all used data.
-    ~CacheLagrange(){}
 
     //! \brief Computes the values of all Lagrange polynomials for the given level at the given x
     static void cacheLevel(int level, double x, const OneDimensionalWrapper &rule, T *cache){
@@ -112,6 +125,87 @@ private:
     std::vector<int> offsets;
 };
 
+/*!
+ * \internal
+ * \ingroup TasmanianAcceleration
+ * \brief Cache that holds the values of 1D Lagrange polynomials for a batch of points.
+ *
+ * Similar to CacheLagrange, but the values are computed for a block of canonical points at once.
+ * For each dimension, the cache is organized in levels and nodes, and the values associated
+ * with a single node are stored contiguously for all points in the batch, i.e.,
+ * the layout is (levels x nodes x batch).
+ * Thus, the products across dimensions can be accumulated with simple contiguous loops
+ * over the batch, which is friendly to the compiler auto-vectorization.
+ * \endinternal
+ */
+template <typename T>
+class CacheLagrangeBatch{
+public:
+    /*!
+     * \brief Constructor that takes into account \b num_x canonical points \b x.
+     *
+     * The parameters have the same meaning as in CacheLagrange, with the addition of
+     * - \b num_x is the number of points in the batch
+     * - \b x holds the coordinates of the points, organized in strips of size \b num_dimensions
+     */
+    CacheLagrangeBatch(int num_dimensions, const std::vector<int> &max_levels, const OneDimensionalWrapper &rule, int num_x, const double x[])
+        : num_batch(num_x), offsets(rule.getPointsCount()), cache(num_dimensions){
+        std::vector<double> xdim(num_x);
+        std::vector<T> work(num_x);
+        for(int dim=0; dim<num_dimensions; dim++){
+            for(int i=0; i<num_x; i++) xdim[i] = x[((size_t) i) * ((size_t) num_dimensions) + dim];
+            cache[dim].resize(((size_t) offsets[max_levels[dim] + 1]) * ((size_t) num_x));
+            for(int level=0; level <= max_levels[dim]; level++)
+                cacheLevel(level, num_x, xdim.data(), rule, work.data(), &(cache[dim][((size_t) offsets[level]) * ((size_t) num_x)]));
+        }
+    }
+    //! \brief Destructor, clear all used data.
+    ~CacheLagrangeBatch(){}
+
+    /*!
+     * \brief Computes the values of all Lagrange polynomials for the given level at the \b num_x points in \b x.
+     *
+     * The \b work array must have size at least \b num_x and the \b cache must have size
+     * \b num_x times the number of points on the level.
+     */
+    static void cacheLevel(int level, int num_x, const double x[], const OneDimensionalWrapper &rule, T work[], T *cache){
+        const double *nodes = rule.getNodes(level);
+        const double *coeff = rule.getCoefficients(level);
+        int num_points = rule.getNumPoints(level);
+
+        std::fill_n(cache, num_x, 1.0);
+        for(int j=0; j<num_points-1; j++){
+            const T *prev = &(cache[((size_t) j) * ((size_t) num_x)]);
+            T *next = &(cache[((size_t) j + 1) * ((size_t) num_x)]);
+            for(int i=0; i<num_x; i++) next[i] = prev[i] * (x[i] - nodes[j]);
+        }
+        if (rule.getType() == rule_clenshawcurtis0){
+            for(int i=0; i<num_x; i++) work[i] = x[i] * x[i] - 1.0;
+        }else{
+            std::fill_n(work, num_x, 1.0);
+        }
+        T *last = &(cache[((size_t) num_points - 1) * ((size_t) num_x)]);
+        for(int i=0; i<num_x; i++) last[i] *= work[i] * coeff[num_points-1];
+        for(int j=num_points-2; j>=0; j--){
+            T *current = &(cache[((size_t) j) * ((size_t) num_x)]);
+            for(int i=0; i<num_x; i++){
+                work[i] *= (x[i] - nodes[j+1]);
+                current[i] *= work[i] * coeff[j];
+            }
+        }
+    }
+
+    //! \brief Return the Lagrange values for all points in the batch, given \b dimension, \b level and offset local to the level
+    const T* getLagrange(int dimension, int level, int local) const{
+        return &(cache[dimension][((size_t) (offsets[level] + local)) * ((size_t) num_batch)]);
+    }
+
+private:
+    int num_batch;
+    std::vector<int> offsets;
+    std::vector<std::vector<T>> cache;
+};
+
 
 }
 
@@ -44,6 +44,7 @@
 #include <functional>
 #include <algorithm>
 #include <type_traits>
+#include <memory>
 
 #include "TasmanianConfig.hpp" // contains build options passed down from CMake
 #include "tsgUtils.hpp" // contains array wrapper and size_mult for int-to-size_t
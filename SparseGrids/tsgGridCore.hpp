@@ -42,16 +42,19 @@
  * \endinternal
  */
 
+#include <mutex>
+
 #include "tsgDConstructGridGlobal.hpp"
 #include "tsgCudaLoadStructures.hpp"
 #include "tsgHierarchyManipulator.hpp"
+#include "tsgThreadPool.hpp"
 
 #ifndef __TASMANIAN_DOXYGEN_SKIP
 namespace TasGrid{
 
 class BaseCanonicalGrid{
 public:
-    BaseCanonicalGrid(){}
+    BaseCanonicalGrid() : float_ready(false), weights_ready(false), integrals_ready(false){}
     virtual ~BaseCanonicalGrid(){}
 
     virtual bool isGlobal() const{ return false; }
@@ -71,6 +74,8 @@ public:
 
     virtual void write(std::ostream&, bool) const = 0;
     virtual void read(std::istream&, bool) = 0;
+    virtual void writeSections(IO::SectionWriter &sections) const = 0;
+    virtual void readSections(IO::SectionReader &sections) = 0;
 
     virtual void getLoadedPoints(double *x) const = 0;
     virtual void getNeededPoints(double *x) const = 0;
@@ -86,9 +91,12 @@ public:
     virtual void integrate(double q[], double *conformal_correction) const = 0;
 
     virtual void evaluateBatch(const double x[], int num_x, double y[]) const = 0;
+    virtual void evaluateBatchOutputs(const double x[], int num_x, const int outputs[], int num_selected, double y[]) const = 0;
+    virtual void evaluateBatch(const double x[], int num_x, float y[]) const = 0; // single precision, see getFloatCoefficients()
 
     #ifdef Tasmanian_ENABLE_BLAS
     virtual void evaluateBlas(const double x[], int num_x, double y[]) const = 0;
+    virtual void evaluateBlas(const double x[], int num_x, float y[]) const = 0;
     #endif
 
     #ifdef Tasmanian_ENABLE_CUDA
@@ -115,11 +123,73 @@ public:
 
     virtual void clearAccelerationData() = 0;
 
+    // must be called when the values or the hierarchical coefficients change, e.g., by loadNeededPoints()
+    void clearCachedData(){
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        float_coefficients = std::vector<float>();
+        float_ready = false;
+    }
+    // must be called when the points change (loaded or needed), e.g., merging a refinement
+    void clearCachedWeights(){
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        quadrature_weights = std::vector<double>();
+        hierarchical_integrals = std::vector<double>();
+        weights_ready = false;
+        integrals_ready = false;
+    }
+
+    // the result of getQuadratureWeights() and integrateHierarchicalFunctions(), computed on the first call and reused until clearCachedWeights()
+    const std::vector<double>& getCachedQuadratureWeights() const{
+        return getCachedVector(weights_ready, quadrature_weights, [&](double w[])->void{ getQuadratureWeights(w); });
+    }
+    const std::vector<double>& getCachedHierarchicalIntegrals() const{
+        return getCachedVector(integrals_ready, hierarchical_integrals, [&](double w[])->void{ integrateHierarchicalFunctions(w); });
+    }
+
+    // set by TasmanianSparseGrid before loading values, an empty executor falls back to the OpenMP loops
+    void setExecutor(ParallelExecutor const &new_executor){ executor = new_executor; }
+
 protected:
+    // returns a single precision copy of the coefficients (values or surpluses depending on the grid)
+    // the copy is created on the first call and reused until clearCachedData(), the creation is thread-safe
+    const float* getFloatCoefficients(const double source[], size_t num_entries) const{
+        if (!float_ready.load(std::memory_order_acquire)){
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            if (!float_ready.load(std::memory_order_relaxed)){
+                float_coefficients.resize(num_entries);
+                std::transform(source, source + num_entries, float_coefficients.begin(), [](double v)->float{ return (float) v; });
+                float_ready.store(true, std::memory_order_release);
+            }
+        }
+        return float_coefficients.data();
+    }
+
     int num_dimensions, num_outputs;
     MultiIndexSet points;
     MultiIndexSet needed;
     StorageSet values;
+
+    ParallelExecutor executor;
+
+private:
+    template<class ComputeMethod>
+    const std::vector<double>& getCachedVector(std::atomic<bool> &ready, std::vector<double> &cache, ComputeMethod compute) const{
+        if (!ready.load(std::memory_order_acquire)){
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            if (!ready.load(std::memory_order_relaxed)){
+                cache.resize((size_t) getNumPoints());
+                compute(cache.data());
+                ready.store(true, std::memory_order_release);
+            }
+        }
+        return cache;
+    }
+
+    mutable std::vector<float> float_coefficients;
+    mutable std::atomic<bool> float_ready;
+    mutable std::vector<double> quadrature_weights, hierarchical_integrals;
+    mutable std::atomic<bool> weights_ready, integrals_ready;
+    mutable std::mutex cache_mutex;
 };
 
 }
@@ -58,7 +58,7 @@ template<bool iomode> void GridFourier::write(std::ostream &os) const{
     if (num_outputs > 0){
         values.write<iomode>(os);
         IO::writeFlag<iomode, IO::pad_auto>((fourier_coefs.getNumStrips() != 0), os);
-        if (fourier_coefs.getNumStrips() != 0) IO::writeVector<iomode, IO::pad_line>(fourier_coefs.getVector(), os);
+        if (fourier_coefs.getNumStrips() != 0) IO::writeVector<iomode, IO::pad_line>(fourier_coefs.getStrip(0), fourier_coefs.getTotalEntries(), os);
     }
 
     IO::writeFlag<iomode, IO::pad_line>(!updated_tensors.empty(), os);
@@ -113,6 +113,69 @@ template void GridFourier::write<mode_binary>(std::ostream &) const;
 template void GridFourier::read<mode_ascii>(std::istream &);
 template void GridFourier::read<mode_binary>(std::istream &);
 
+void GridFourier::writeSections(IO::SectionWriter &sections) const{
+    std::ostream &os = sections.addSection("grid");
+    IO::writeNumbers<mode_binary, IO::pad_none>(os, num_dimensions, num_outputs);
+
+    tensors.write<mode_binary>(os);
+    active_tensors.write<mode_binary>(os);
+    if (!active_w.empty())
+        IO::writeVector<mode_binary, IO::pad_none>(active_w, os);
+    IO::writeVector<mode_binary, IO::pad_none>(max_levels, os);
+
+    IO::writeFlag<mode_binary, IO::pad_none>(!updated_tensors.empty(), os);
+    if (!updated_tensors.empty()){
+        updated_tensors.write<mode_binary>(os);
+        updated_active_tensors.write<mode_binary>(os);
+        IO::writeVector<mode_binary, IO::pad_none>(updated_active_w, os);
+    }
+
+    if (!points.empty()) points.write<mode_binary>(sections.addSection("points"));
+    if (!needed.empty()) needed.write<mode_binary>(sections.addSection("needed"));
+    if (num_outputs > 0){
+        values.writeSection(sections.addSection("values"));
+        if (fourier_coefs.getNumStrips() != 0) IO::writeVector<mode_binary, IO::pad_none>(fourier_coefs.getStrip(0), fourier_coefs.getTotalEntries(), sections.addSection("surplus"));
+    }
+}
+void GridFourier::readSections(IO::SectionReader &sections){
+    reset();
+    std::istream &is = sections.getSection("grid");
+    num_dimensions = IO::readNumber<mode_binary, int>(is);
+    num_outputs = IO::readNumber<mode_binary, int>(is);
+
+    tensors.read<mode_binary>(is);
+    active_tensors.read<mode_binary>(is);
+    active_w.resize((size_t) active_tensors.getNumIndexes());
+    IO::readVector<mode_binary>(is, active_w);
+    max_levels.resize((size_t) num_dimensions);
+    IO::readVector<mode_binary>(is, max_levels);
+
+    int oned_max_level;
+    if (IO::readFlag<mode_binary>(is)){
+        updated_tensors.read<mode_binary>(is);
+        oned_max_level = updated_tensors.getMaxIndex();
+
+        updated_active_tensors.read<mode_binary>(is);
+
+        updated_active_w.resize((size_t) updated_active_tensors.getNumIndexes());
+        IO::readVector<mode_binary>(is, updated_active_w);
+    }else{
+        oned_max_level = *std::max_element(max_levels.begin(), max_levels.end());
+    }
+
+    if (sections.hasSection("points")) points.read(sections, "points");
+    if (sections.hasSection("needed")) needed.read(sections, "needed");
+    if (num_outputs > 0){
+        values.read(sections, "values");
+        if (sections.hasSection("surplus"))
+            fourier_coefs = IO::readData2D<double>(sections, "surplus", num_outputs, 2 * points.getNumIndexes());
+    }
+
+    wrapper.load(oned_max_level, rule_fourier, 0.0, 0.0);
+
+    max_power = MultiIndexManipulations::getMaxIndexes(((points.empty()) ? needed : points));
+}
+
 void GridFourier::reset(){
     clearAccelerationData();
     wrapper = OneDimensionalWrapper();
@@ -266,15 +329,15 @@ void GridFourier::loadNeededPoints(const double *vals){
     max_power = MultiIndexManipulations::getMaxIndexes(points);
 }
 
-void GridFourier::mapIndexesToNodes(const std::vector<int> &indexes, double *x) const{
-    std::transform(indexes.begin(), indexes.end(), x, [&](int i)->double{ return wrapper.getNode(i); });
+void GridFourier::mapIndexesToNodes(const int indexes[], size_t num_entries, double *x) const{
+    std::transform(indexes, indexes + num_entries, x, [&](int i)->double{ return wrapper.getNode(i); });
 }
 
 void GridFourier::getLoadedPoints(double *x) const{
-    mapIndexesToNodes(points.getVector(), x);
+    mapIndexesToNodes(points.getIndex(0), Utils::size_mult(points.getNumIndexes(), num_dimensions), x);
 }
 void GridFourier::getNeededPoints(double *x) const{
-    mapIndexesToNodes(needed.getVector(), x);
+    mapIndexesToNodes(needed.getIndex(0), Utils::size_mult(needed.getNumIndexes(), num_dimensions), x);
 }
 void GridFourier::getPoints(double *x) const{
     if (points.empty()){ getNeededPoints(x); }else{ getLoadedPoints(x); };
@@ -493,11 +556,17 @@ void GridFourier::getQuadratureWeights(double weights[]) const{
 }
 
 void GridFourier::evaluate(const double x[], double y[]) const{
+    auto workspace = workspaces.acquire(); // the grid keeps the workspaces, avoids allocations in tight loops
+    evaluate(x, y, *workspace);
+}
+void GridFourier::evaluate(const double x[], double y[], EvaluateWorkspace &workspace) const{
     int num_points = points.getNumIndexes();
     std::fill_n(y, num_outputs, 0.0);
-    std::vector<double> wreal(num_points);
-    std::vector<double> wimag(num_points);
-    computeBasis<double, false>(points, x, wreal.data(), wimag.data());
+    std::vector<double> &wreal = workspace.wreal;
+    std::vector<double> &wimag = workspace.wimag;
+    wreal.resize(num_points);
+    wimag.resize(num_points);
+    computeBasis<double, false>(points, x, wreal.data(), wimag.data(), workspace.cache);
     for(int i=0; i<num_points; i++){
         const double *fcreal = fourier_coefs.getStrip(i);
         const double *fcimag = fourier_coefs.getStrip(i + num_points);
@@ -509,9 +578,60 @@ void GridFourier::evaluate(const double x[], double y[]) const{
 void GridFourier::evaluateBatch(const double x[], int num_x, double y[]) const{
     Utils::Wrapper2D<double const> xwrap(num_dimensions, x);
     Utils::Wrapper2D<double> ywrap(num_outputs, y);
-    #pragma omp parallel for
-    for(int i=0; i<num_x; i++)
-        evaluate(xwrap.getStrip(i), ywrap.getStrip(i));
+    #pragma omp parallel
+    {
+        EvaluateWorkspace workspace;
+        #pragma omp for
+        for(int i=0; i<num_x; i++)
+            evaluate(xwrap.getStrip(i), ywrap.getStrip(i), workspace);
+    }
+}
+void GridFourier::evaluateBatch(const double x[], int num_x, float y[]) const{
+    Utils::Wrapper2D<double const> xwrap(num_dimensions, x);
+    Utils::Wrapper2D<float> ywrap(num_outputs, y);
+    int num_points = points.getNumIndexes();
+    Utils::Wrapper2D<float const> cwrap(num_outputs, getFloatCoefficients(fourier_coefs.getStrip(0), fourier_coefs.getTotalEntries()));
+    #pragma omp parallel
+    {
+        std::vector<double> wreal(num_points), wimag(num_points);
+        std::vector<std::vector<std::complex<double>>> cache;
+        #pragma omp for
+        for(int i=0; i<num_x; i++){
+            computeBasis<double, false>(points, xwrap.getStrip(i), wreal.data(), wimag.data(), cache);
+            float *this_y = ywrap.getStrip(i);
+            std::fill_n(this_y, num_outputs, 0.0f);
+            for(int j=0; j<num_points; j++){
+                const float *fcreal = cwrap.getStrip(j);
+                const float *fcimag = cwrap.getStrip(j + num_points);
+                float wr = (float) wreal[j];
+                float wi = (float) wimag[j];
+                for(int k=0; k<num_outputs; k++) this_y[k] += wr * fcreal[k] - wi * fcimag[k];
+            }
+        }
+    }
+}
+void GridFourier::evaluateBatchOutputs(const double x[], int num_x, const int outputs[], int num_selected, double y[]) const{
+    Utils::Wrapper2D<double const> xwrap(num_dimensions, x);
+    Utils::Wrapper2D<double> ywrap(num_selected, y);
+    int num_points = points.getNumIndexes();
+    #pragma omp parallel
+    {
+        std::vector<double> wreal(num_points), wimag(num_points);
+        std::vector<std::vector<std::complex<double>>> cache;
+        #pragma omp for
+        for(int i=0; i<num_x; i++){
+            computeBasis<double, false>(points, xwrap.getStrip(i), wreal.data(), wimag.data(), cache);
+            double *this_y = ywrap.getStrip(i);
+            std::fill_n(this_y, num_selected, 0.0);
+            for(int j=0; j<num_points; j++){
+                const double *fcreal = fourier_coefs.getStrip(j);
+                const double *fcimag = fourier_coefs.getStrip(j + num_points);
+                double wr = wreal[j];
+                double wi = wimag[j];
+                for(int k=0; k<num_selected; k++) this_y[k] += wr * fcreal[outputs[k]] - wi * fcimag[outputs[k]];
+            }
+        }
+    }
 }
 
 #ifdef Tasmanian_ENABLE_BLAS
@@ -524,11 +644,23 @@ void GridFourier::evaluateBlas(const double x[], int num_x, double y[]) const{
     }else{ // work-around small OpenMP penalty
         wreal.resize(num_points, 1);
         wimag.resize(num_points, 1);
-        computeBasis<double, false>(points, x, wreal.getStrip(0), wimag.getStrip(0));
+        std::vector<std::vector<std::complex<double>>> cache;
+        computeBasis<double, false>(points, x, wreal.getStrip(0), wimag.getStrip(0), cache);
     }
     TasBLAS::denseMultiply(num_outputs, num_x, num_points, 1.0, fourier_coefs.getStrip(0), wreal.getStrip(0), 0.0, y);
     TasBLAS::denseMultiply(num_outputs, num_x, num_points, -1.0, fourier_coefs.getStrip(num_points), wimag.getStrip(0), 1.0, y);
 }
+void GridFourier::evaluateBlas(const double x[], int num_x, float y[]) const{
+    int num_points = points.getNumIndexes();
+    Data2D<double> wreal;
+    Data2D<double> wimag;
+    evaluateHierarchicalFunctionsInternal(x, num_x, wreal, wimag);
+    std::vector<float> freal(wreal.getVector().begin(), wreal.getVector().end());
+    std::vector<float> fimag(wimag.getVector().begin(), wimag.getVector().end());
+    const float *fcoefs = getFloatCoefficients(fourier_coefs.getStrip(0), fourier_coefs.getTotalEntries());
+    TasBLAS::denseMultiply(num_outputs, num_x, num_points, 1.0f, fcoefs, freal.data(), 0.0f, y);
+    TasBLAS::denseMultiply(num_outputs, num_x, num_points, -1.0f, &(fcoefs[Utils::size_mult(num_outputs, num_points)]), fimag.data(), 1.0f, y);
+}
 #endif
 
 #ifdef Tasmanian_ENABLE_CUDA
@@ -571,8 +703,7 @@ void GridFourier::integrate(double q[], double *conformal_correction) const{
         std::copy(fourier_coefs.getStrip(0), fourier_coefs.getStrip(0) + num_outputs, q);
     }else{
         // Do the expensive computation if we have a conformal map
-        std::vector<double> w(getNumPoints());
-        getQuadratureWeights(w.data());
+        std::vector<double> w = getCachedQuadratureWeights();
         for(int i=0; i<points.getNumIndexes(); i++){
             w[i] *= conformal_correction[i];
             const double *v = values.getValues(i);
@@ -588,9 +719,13 @@ void GridFourier::evaluateHierarchicalFunctions(const double x[], int num_x, dou
     int num_points = getNumPoints();
     Utils::Wrapper2D<double const> xwrap(num_dimensions, x);
     Utils::Wrapper2D<double> ywrap(2*num_points, y);
-    #pragma omp parallel for
-    for(int i=0; i<num_x; i++){
-        computeBasis<double, true>(((points.empty()) ? needed : points), xwrap.getStrip(i), ywrap.getStrip(i), 0);
+    #pragma omp parallel
+    {
+        std::vector<std::vector<std::complex<double>>> cache;
+        #pragma omp for
+        for(int i=0; i<num_x; i++){
+            computeBasis<double, true>(((points.empty()) ? needed : points), xwrap.getStrip(i), ywrap.getStrip(i), 0, cache);
+        }
     }
 }
 void GridFourier::evaluateHierarchicalFunctionsInternal(const double x[], int num_x, Data2D<double> &wreal, Data2D<double> &wimag) const{
@@ -600,9 +735,13 @@ void GridFourier::evaluateHierarchicalFunctionsInternal(const double x[], int nu
     Utils::Wrapper2D<double const> xwrap(num_dimensions, x);
     wreal.resize(num_points, num_x);
     wimag.resize(num_points, num_x);
-    #pragma omp parallel for
-    for(int i=0; i<num_x; i++){
-        computeBasis<double, false>(((points.empty()) ? needed : points), xwrap.getStrip(i), wreal.getStrip(i), wimag.getStrip(i));
+    #pragma omp parallel
+    {
+        std::vector<std::vector<std::complex<double>>> cache;
+        #pragma omp for
+        for(int i=0; i<num_x; i++){
+            computeBasis<double, false>(((points.empty()) ? needed : points), xwrap.getStrip(i), wreal.getStrip(i), wimag.getStrip(i), cache);
+        }
     }
 }
 
@@ -857,7 +996,7 @@ std::vector<double> GridFourier::getCandidateConstructionPoints(std::function<do
     std::vector<int> node_indexes;
     dynamic_values->getNodesIndexes(node_indexes);
     std::vector<double> x(node_indexes.size());
-    mapIndexesToNodes(node_indexes, x.data());
+    mapIndexesToNodes(node_indexes.data(), node_indexes.size(), x.data());
     return x;
 }
 std::vector<int> GridFourier::getMultiIndex(const double x[]){
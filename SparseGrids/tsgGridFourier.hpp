@@ -48,6 +48,8 @@ public:
 
     template<bool iomode> void write(std::ostream &os) const;
     template<bool iomode> void read(std::istream &is);
+    void writeSections(IO::SectionWriter &sections) const; // binary container format, see TasmanianSparseGrid::writeBinary()
+    void readSections(IO::SectionReader &sections);
 
     void makeGrid(int cnum_dimensions, int cnum_outputs, int depth, TypeDepth type, const std::vector<int> &anisotropic_weights, const std::vector<int> &level_limits);
     void copyGrid(const GridFourier *fourier, int ibegin, int iend);
@@ -69,9 +71,12 @@ public:
 
     void evaluate(const double x[], double y[]) const;
     void evaluateBatch(const double x[], int num_x, double y[]) const;
+    void evaluateBatchOutputs(const double x[], int num_x, const int outputs[], int num_selected, double y[]) const; // computes only the selected outputs
+    void evaluateBatch(const double x[], int num_x, float y[]) const; // single precision
 
     #ifdef Tasmanian_ENABLE_BLAS
     void evaluateBlas(const double x[], int num_x, double y[]) const;
+    void evaluateBlas(const double x[], int num_x, float y[]) const;
     #endif
 
     #ifdef Tasmanian_ENABLE_CUDA
@@ -124,15 +129,15 @@ protected:
 
     std::vector<std::vector<int>> generateIndexingMap() const;
 
-    void mapIndexesToNodes(const std::vector<int> &indexes, double *x) const;
+    void mapIndexesToNodes(const int indexes[], size_t num_entries, double *x) const;
     void loadConstructedTensors();
     std::vector<int> getMultiIndex(const double x[]);
 
     template<typename T, bool interwoven>
-    void computeBasis(const MultiIndexSet &work, const T x[], T wreal[], T wimag[]) const{
+    void computeBasis(const MultiIndexSet &work, const T x[], T wreal[], T wimag[], std::vector<std::vector<std::complex<T>>> &cache) const{
         int num_points = work.getNumIndexes();
 
-        std::vector<std::vector<std::complex<T>>> cache(num_dimensions);
+        cache.resize(num_dimensions); // overwrites the cache, reuses the existing memory
         for(int j=0; j<num_dimensions; j++){
             cache[j].resize(max_power[j] +1);
             cache[j][0] = std::complex<T>(1.0, 0.0);
@@ -223,6 +228,14 @@ private:
 
     std::unique_ptr<DynamicConstructorDataGlobal> dynamic_values;
 
+    struct EvaluateWorkspace{ // reused by the single point evaluate()
+        std::vector<double> wreal, wimag;
+        std::vector<std::vector<std::complex<double>>> cache;
+    };
+    Utils::WorkspacePool<EvaluateWorkspace> workspaces;
+
+    void evaluate(const double x[], double y[], EvaluateWorkspace &workspace) const;
+
     #ifdef Tasmanian_ENABLE_CUDA
     mutable std::unique_ptr<CudaFourierData<double>> cuda_cache;
     #endif
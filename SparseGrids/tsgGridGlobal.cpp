@@ -36,6 +36,8 @@
 
 namespace TasGrid{
 
+constexpr int GridGlobal::batch_block_size;
+
 GridGlobal::GridGlobal() : alpha(0.0), beta(0.0){}
 GridGlobal::~GridGlobal(){}
 
@@ -113,6 +115,69 @@ template void GridGlobal::write<mode_binary>(std::ostream &) const;
 template void GridGlobal::read<mode_ascii>(std::istream &);
 template void GridGlobal::read<mode_binary>(std::istream &);
 
+void GridGlobal::writeSections(IO::SectionWriter &sections) const{
+    std::ostream &os = sections.addSection("grid");
+    IO::writeNumbers<mode_binary, IO::pad_none>(os, num_dimensions, num_outputs);
+    IO::writeNumbers<mode_binary, IO::pad_none>(os, alpha, beta);
+    IO::writeRule<mode_binary>(rule, os);
+    if (rule == rule_customtabulated)
+        custom.write<mode_binary>(os);
+
+    tensors.write<mode_binary>(os);
+    active_tensors.write<mode_binary>(os);
+    if (!active_w.empty())
+        IO::writeVector<mode_binary, IO::pad_none>(active_w, os);
+    IO::writeVector<mode_binary, IO::pad_none>(max_levels, os);
+
+    IO::writeFlag<mode_binary, IO::pad_none>(!updated_tensors.empty(), os);
+    if (!updated_tensors.empty()){
+        updated_tensors.write<mode_binary>(os);
+        updated_active_tensors.write<mode_binary>(os);
+        IO::writeVector<mode_binary, IO::pad_none>(updated_active_w, os);
+    }
+
+    if (!points.empty()) points.write<mode_binary>(sections.addSection("points"));
+    if (!needed.empty()) needed.write<mode_binary>(sections.addSection("needed"));
+    if (num_outputs > 0) values.writeSection(sections.addSection("values"));
+}
+void GridGlobal::readSections(IO::SectionReader &sections){
+    reset(true); // true deletes any custom rule
+    std::istream &is = sections.getSection("grid");
+    num_dimensions = IO::readNumber<mode_binary, int>(is);
+    num_outputs = IO::readNumber<mode_binary, int>(is);
+    alpha = IO::readNumber<mode_binary, double>(is);
+    beta = IO::readNumber<mode_binary, double>(is);
+    rule = IO::readRule<mode_binary>(is);
+    if (rule == rule_customtabulated) custom.read<mode_binary>(is);
+    tensors.read<mode_binary>(is);
+    active_tensors.read<mode_binary>(is);
+    active_w.resize((size_t) active_tensors.getNumIndexes());
+    IO::readVector<mode_binary>(is, active_w);
+    max_levels.resize((size_t) num_dimensions);
+    IO::readVector<mode_binary>(is, max_levels);
+
+    int oned_max_level;
+    if (IO::readFlag<mode_binary>(is)){
+        updated_tensors.read<mode_binary>(is);
+        oned_max_level = updated_tensors.getMaxIndex();
+
+        updated_active_tensors.read<mode_binary>(is);
+
+        updated_active_w.resize((size_t) updated_active_tensors.getNumIndexes());
+        IO::readVector<mode_binary>(is, updated_active_w);
+    }else{
+        oned_max_level = *std::max_element(max_levels.begin(), max_levels.end());
+    }
+
+    if (sections.hasSection("points")) points.read(sections, "points");
+    if (sections.hasSection("needed")) needed.read(sections, "needed");
+    if (num_outputs > 0) values.read(sections, "values");
+
+    wrapper.load(custom, oned_max_level, rule, alpha, beta);
+
+    recomputeTensorRefs((points.empty()) ? needed : points);
+}
+
 void GridGlobal::reset(bool includeCustom){
     clearAccelerationData();
     tensor_refs = std::vector<std::vector<int>>();
@@ -286,15 +351,15 @@ void GridGlobal::updateGrid(int depth, TypeDepth type, const std::vector<int> &a
     }
 }
 
-void GridGlobal::mapIndexesToNodes(const std::vector<int> &indexes, double *x) const{
-    std::transform(indexes.begin(), indexes.end(), x, [&](int i)->double{ return wrapper.getNode(i); });
+void GridGlobal::mapIndexesToNodes(const int indexes[], size_t num_entries, double *x) const{
+    std::transform(indexes, indexes + num_entries, x, [&](int i)->double{ return wrapper.getNode(i); });
 }
 
 void GridGlobal::getLoadedPoints(double *x) const{
-    mapIndexesToNodes(points.getVector(), x);
+    mapIndexesToNodes(points.getIndex(0), Utils::size_mult(points.getNumIndexes(), num_dimensions), x);
 }
 void GridGlobal::getNeededPoints(double *x) const{
-    mapIndexesToNodes(needed.getVector(), x);
+    mapIndexesToNodes(needed.getIndex(0), Utils::size_mult(needed.getNumIndexes(), num_dimensions), x);
 }
 void GridGlobal::getPoints(double *x) const{
     if (points.empty()){ getNeededPoints(x); }else{ getLoadedPoints(x); };
@@ -328,11 +393,18 @@ void GridGlobal::getQuadratureWeights(double weights[]) const{
 }
 
 void GridGlobal::getInterpolationWeights(const double x[], double weights[]) const{
+    auto workspace = workspaces.acquire();
+    getInterpolationWeights(x, weights, *workspace);
+}
+
+void GridGlobal::getInterpolationWeights(const double x[], double weights[], EvaluateWorkspace &workspace) const{
     std::fill_n(weights, (points.empty()) ? needed.getNumIndexes() : points.getNumIndexes(), 0.0);
 
-    CacheLagrange<double> lcache(num_dimensions, max_levels, wrapper, x);
+    CacheLagrange<double> &lcache = workspace.lcache; // the workspace is reused, no allocations after the first call
+    lcache.cacheValues(num_dimensions, max_levels, wrapper, x);
 
-    std::vector<int> num_oned_points(num_dimensions);
+    std::vector<int> &num_oned_points = workspace.num_oned_points;
+    num_oned_points.resize(num_dimensions);
     for(int n=0; n<active_tensors.getNumIndexes(); n++){
         const int* levels = active_tensors.getIndex(n);
         num_oned_points[0] = wrapper.getNumPoints(levels[0]);
@@ -354,6 +426,48 @@ void GridGlobal::getInterpolationWeights(const double x[], double weights[]) con
     }
 }
 
+void GridGlobal::getInterpolationWeightsBatch(const double x[], int num_x, double weights[]) const{
+    int num_points = (points.empty()) ? needed.getNumIndexes() : points.getNumIndexes();
+    std::fill_n(weights, Utils::size_mult(num_points, num_x), 0.0);
+
+    CacheLagrangeBatch<double> lcache(num_dimensions, max_levels, wrapper, num_x, x);
+
+    std::vector<int> num_oned_points(num_dimensions);
+    std::vector<int> p(num_dimensions); // multi-index of the current point within the tensor
+    Data2D<double> partial(num_x, num_dimensions); // partial.getStrip(j) holds the product of the Lagrange values over dimensions 0 ... j
+    for(int n=0; n<active_tensors.getNumIndexes(); n++){
+        const int* levels = active_tensors.getIndex(n);
+        int num_tensor_points = 1;
+        for(int j=0; j<num_dimensions; j++){
+            num_oned_points[j] = wrapper.getNumPoints(levels[j]);
+            num_tensor_points *= num_oned_points[j];
+        }
+        double tensor_weight = (double) active_w[n];
+        std::fill(p.begin(), p.end(), 0);
+        int changed = 0; // the first dimension with index that changed since the last point
+        for(int i=0; i<num_tensor_points; i++){
+            for(int j=changed; j<num_dimensions; j++){
+                const double *lagrange = lcache.getLagrange(j, levels[j], p[j]);
+                double *pj = partial.getStrip(j);
+                if (j == 0){
+                    std::copy_n(lagrange, num_x, pj);
+                }else{
+                    const double *pprev = partial.getStrip(j-1);
+                    for(int k=0; k<num_x; k++) pj[k] = pprev[k] * lagrange[k];
+                }
+            }
+            const double *tw = partial.getStrip(num_dimensions-1);
+            double *w = &(weights[Utils::size_mult(tensor_refs[n][i], num_x)]);
+            for(int k=0; k<num_x; k++) w[k] += tensor_weight * tw[k];
+
+            // advance the multi-index, the last dimension is the fastest (same as in tensor_refs)
+            changed = num_dimensions-1;
+            while((changed > 0) && (++p[changed] == num_oned_points[changed])) p[changed--] = 0;
+            if (changed == 0) p[0]++;
+        }
+    }
+}
+
 void GridGlobal::acceptUpdatedTensors(){
     if (points.empty()){
         points = std::move(needed);
@@ -527,7 +641,7 @@ std::vector<double> GridGlobal::getCandidateConstructionPoints(std::function<dou
     std::vector<int> node_indexes;
     dynamic_values->getNodesIndexes(node_indexes);
     std::vector<double> x(node_indexes.size());
-    mapIndexesToNodes(node_indexes, x.data());
+    mapIndexesToNodes(node_indexes.data(), node_indexes.size(), x.data());
     return x;
 }
 std::vector<int> GridGlobal::getMultiIndex(const double x[]){
@@ -596,8 +710,10 @@ const double* GridGlobal::getLoadedValues() const{
 }
 
 void GridGlobal::evaluate(const double x[], double y[]) const{
-    std::vector<double> w(points.getNumIndexes());
-    getInterpolationWeights(x, w.data());
+    auto workspace = workspaces.acquire(); // the grid keeps the workspaces, avoids allocations in tight loops
+    std::vector<double> &w = workspace->weights;
+    w.resize(points.getNumIndexes());
+    getInterpolationWeights(x, w.data(), *workspace);
     std::fill_n(y, num_outputs, 0.0);
     for(int i=0; i<points.getNumIndexes(); i++){
         const double *v = values.getValues(i);
@@ -606,11 +722,66 @@ void GridGlobal::evaluate(const double x[], double y[]) const{
     }
 }
 void GridGlobal::evaluateBatch(const double x[], int num_x, double y[]) const{
+    if (num_x == 1){
+        evaluate(x, y);
+        return;
+    }
+    evaluateBatchBlocks<double>(x, num_x, values.getValues(0), y);
+}
+void GridGlobal::evaluateBatch(const double x[], int num_x, float y[]) const{
+    evaluateBatchBlocks<float>(x, num_x, getFloatCoefficients(values.getValues(0), values.getTotalEntries()), y);
+}
+template<typename T> void GridGlobal::evaluateBatchBlocks(const double x[], int num_x, const T coefficients[], T y[]) const{
+    // the interpolation weights are always computed in double precision, only the accumulation uses type T
+    int num_points = points.getNumIndexes();
     Utils::Wrapper2D<const double> xwrap(num_dimensions, x);
-    Utils::Wrapper2D<double> ywrap(num_outputs, y);
+    Utils::Wrapper2D<const T> vwrap(num_outputs, coefficients);
+    Utils::Wrapper2D<T> ywrap(num_outputs, y);
+    int num_blocks = num_x / batch_block_size + ((num_x % batch_block_size == 0) ? 0 : 1);
     #pragma omp parallel for
-    for(int i=0; i<num_x; i++)
-        evaluate(xwrap.getStrip(i), ywrap.getStrip(i));
+    for(int b=0; b<num_blocks; b++){
+        int block_start = b * batch_block_size;
+        int block_size = std::min(batch_block_size, num_x - block_start);
+        Data2D<double> weights(block_size, num_points);
+        getInterpolationWeightsBatch(xwrap.getStrip(block_start), block_size, weights.getStrip(0));
+        T *yblock = ywrap.getStrip(block_start);
+        std::fill_n(yblock, Utils::size_mult(block_size, num_outputs), static_cast<T>(0.0));
+        for(int i=0; i<num_points; i++){
+            const T *v = vwrap.getStrip(i);
+            const double *w = weights.getStrip(i);
+            for(int j=0; j<block_size; j++){
+                T *this_y = &(yblock[Utils::size_mult(j, num_outputs)]);
+                T wj = static_cast<T>(w[j]);
+                for(int k=0; k<num_outputs; k++) this_y[k] += wj * v[k];
+            }
+        }
+    }
+}
+void GridGlobal::evaluateBatchOutputs(const double x[], int num_x, const int outputs[], int num_selected, double y[]) const{
+    int num_points = points.getNumIndexes();
+    Utils::Wrapper2D<const double> xwrap(num_dimensions, x);
+    Utils::Wrapper2D<double> ywrap(num_selected, y);
+    int num_blocks = num_x / batch_block_size + ((num_x % batch_block_size == 0) ? 0 : 1);
+    #pragma omp parallel for
+    for(int b=0; b<num_blocks; b++){
+        int block_start = b * batch_block_size;
+        int block_size = std::min(batch_block_size, num_x - block_start);
+        Data2D<double> weights(block_size, num_points);
+        getInterpolationWeightsBatch(xwrap.getStrip(block_start), block_size, weights.getStrip(0));
+        double *yblock = ywrap.getStrip(block_start);
+        std::fill_n(yblock, Utils::size_mult(block_size, num_selected), 0.0);
+        std::vector<double> v(num_selected); // the selected values of the current point
+        for(int i=0; i<num_points; i++){
+            const double *vals = values.getValues(i);
+            for(int k=0; k<num_selected; k++) v[k] = vals[outputs[k]];
+            const double *w = weights.getStrip(i);
+            for(int j=0; j<block_size; j++){
+                double *this_y = &(yblock[Utils::size_mult(j, num_selected)]);
+                double wj = w[j];
+                for(int k=0; k<num_selected; k++) this_y[k] += wj * v[k];
+            }
+        }
+    }
 }
 
 #ifdef Tasmanian_ENABLE_BLAS
@@ -625,6 +796,14 @@ void GridGlobal::evaluateBlas(const double x[], int num_x, double y[]) const{
 
     TasBLAS::denseMultiply(num_outputs, num_x, num_points, 1.0, values.getValues(0), weights.getStrip(0), 0.0, y);
 }
+void GridGlobal::evaluateBlas(const double x[], int num_x, float y[]) const{
+    int num_points = points.getNumIndexes();
+    Data2D<double> weights(num_points, num_x);
+    evaluateHierarchicalFunctions(x, num_x, weights.getStrip(0));
+    std::vector<float> fweights(weights.getVector().begin(), weights.getVector().end());
+
+    TasBLAS::denseMultiply(num_outputs, num_x, num_points, 1.0f, getFloatCoefficients(values.getValues(0), values.getTotalEntries()), fweights.data(), 0.0f, y);
+}
 #endif // Tasmanian_ENABLE_BLAS
 
 #ifdef Tasmanian_ENABLE_CUDA
@@ -664,7 +843,7 @@ void GridGlobal::evaluateHierarchicalFunctionsGPU(const double gpu_x[], int cpu_
 }
 void GridGlobal::loadCudaValues() const{
     if (!cuda_cache) cuda_cache = std::unique_ptr<CudaGlobalData<double>>(new CudaGlobalData<double>);
-    if (cuda_cache->values.empty()) cuda_cache->values.load(values.getVector());
+    if (cuda_cache->values.empty()) cuda_cache->values.load(values.getTotalEntries(), values.getValues(0));
 }
 void GridGlobal::clearCudaValues() const{ if (cuda_cache) cuda_cache->values.clear(); }
 void GridGlobal::loadCudaNodes() const{
@@ -740,8 +919,7 @@ void GridGlobal::clearCudaNodes() const{
 #endif // Tasmanian_ENABLE_CUDA
 
 void GridGlobal::integrate(double q[], double *conformal_correction) const{
-    std::vector<double> w(getNumPoints());
-    getQuadratureWeights(w.data());
+    std::vector<double> w = getCachedQuadratureWeights();
     if (conformal_correction != 0) for(int i=0; i<points.getNumIndexes(); i++) w[i] *= conformal_correction[i];
     std::fill(q, q+num_outputs, 0.0);
     #pragma omp parallel for schedule(static)
@@ -757,9 +935,18 @@ void GridGlobal::evaluateHierarchicalFunctions(const double x[], int num_x, doub
     int num_points = (points.empty()) ? needed.getNumIndexes() : points.getNumIndexes();
     Utils::Wrapper2D<const double> xwrap(num_dimensions, x);
     Utils::Wrapper2D<double> ywrap(num_points, y);
+    int num_blocks = num_x / batch_block_size + ((num_x % batch_block_size == 0) ? 0 : 1);
     #pragma omp parallel for
-    for(int i=0; i<num_x; i++)
-        getInterpolationWeights(xwrap.getStrip(i), ywrap.getStrip(i));
+    for(int b=0; b<num_blocks; b++){
+        int block_start = b * batch_block_size;
+        int block_size = std::min(batch_block_size, num_x - block_start);
+        Data2D<double> weights(block_size, num_points);
+        getInterpolationWeightsBatch(xwrap.getStrip(block_start), block_size, weights.getStrip(0));
+        for(int i=0; i<num_points; i++){
+            const double *w = weights.getStrip(i);
+            for(int j=0; j<block_size; j++) ywrap.getStrip(block_start + j)[i] = w[j];
+        }
+    }
 }
 
 std::vector<double> GridGlobal::computeSurpluses(int output, bool normalize) const{
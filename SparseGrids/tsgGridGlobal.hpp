@@ -49,6 +49,8 @@ public:
 
     template<bool iomode> void write(std::ostream &os) const;
     template<bool iomode> void read(std::istream &is);
+    void writeSections(IO::SectionWriter &sections) const; // binary container format, see TasmanianSparseGrid::writeBinary()
+    void readSections(IO::SectionReader &sections);
 
     void makeGrid(int cnum_dimensions, int cnum_outputs, int depth, TypeDepth type, TypeOneDRule crule, const std::vector<int> &anisotropic_weights, double calpha, double cbeta, const char* custom_filename, const std::vector<int> &level_limits);
     void copyGrid(const GridGlobal *global, int ibegin, int iend);
@@ -77,9 +79,12 @@ public:
     void integrate(double q[], double *conformal_correction) const;
 
     void evaluateBatch(const double x[], int num_x, double y[]) const;
+    void evaluateBatchOutputs(const double x[], int num_x, const int outputs[], int num_selected, double y[]) const; // computes only the selected outputs
+    void evaluateBatch(const double x[], int num_x, float y[]) const; // single precision
 
     #ifdef Tasmanian_ENABLE_BLAS
     void evaluateBlas(const double x[], int num_x, double y[]) const;
+    void evaluateBlas(const double x[], int num_x, float y[]) const;
     #endif
 
     #ifdef Tasmanian_ENABLE_CUDA
@@ -116,6 +121,8 @@ public:
     std::vector<int> getPolynomialSpace(bool interpolation) const;
 
 protected:
+    template<typename T> void evaluateBatchBlocks(const double x[], int num_x, const T coefficients[], T y[]) const; // evaluateBatch() in double or float
+
     void reset(bool includeCustom);
 
     std::vector<double> computeSurpluses(int output, bool normalize) const; // only for sequence rules, select the output to compute the surpluses
@@ -131,7 +138,10 @@ protected:
     void acceptUpdatedTensors();
     MultiIndexSet getPolynomialSpaceSet(bool interpolation) const;
 
-    void mapIndexesToNodes(const std::vector<int> &indexes, double *x) const;
+    // weights for a block of points, organized in strips of size num_x for each grid point (transpose of evaluateHierarchicalFunctions())
+    void getInterpolationWeightsBatch(const double x[], int num_x, double weights[]) const;
+
+    void mapIndexesToNodes(const int indexes[], size_t num_entries, double *x) const;
     void loadConstructedTensors();
     std::vector<int> getMultiIndex(const double x[]);
 
@@ -142,6 +152,8 @@ protected:
     void clearCudaNodes() const;
     #endif
 
+    static constexpr int batch_block_size = 64; // number of points processed together by evaluateBatch() and evaluateHierarchicalFunctions()
+
 private:
     TypeOneDRule rule;
     double alpha, beta;
@@ -164,6 +176,15 @@ private:
 
     std::unique_ptr<DynamicConstructorDataGlobal> dynamic_values;
 
+    struct EvaluateWorkspace{ // reused by the single point evaluate() and getInterpolationWeights()
+        CacheLagrange<double> lcache;
+        std::vector<int> num_oned_points;
+        std::vector<double> weights;
+    };
+    Utils::WorkspacePool<EvaluateWorkspace> workspaces;
+
+    void getInterpolationWeights(const double x[], double weights[], EvaluateWorkspace &workspace) const;
+
     #ifdef Tasmanian_ENABLE_CUDA
     mutable std::unique_ptr<CudaGlobalData<double>> cuda_cache;
     #endif
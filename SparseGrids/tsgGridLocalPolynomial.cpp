@@ -51,18 +51,26 @@ void GridLocalPolynomial::reset(bool clear_rule){
     surpluses.clear();
 }
 template<class T> std::unique_ptr<T> make_unique_ptr(){ return std::unique_ptr<T>(new T()); } // in C++14 this is called std::make_unique()
+template<TypeOneDRule effrule, bool isZeroOrder>
+void GridLocalPolynomial::setRuleMethods(){
+    rule = make_unique_ptr<templRuleLocalPolynomial<effrule, isZeroOrder>>();
+    walk_tree_methods[0] = &GridLocalPolynomial::walkTreeRule<0, effrule, isZeroOrder>;
+    walk_tree_methods[1] = &GridLocalPolynomial::walkTreeRule<1, effrule, isZeroOrder>;
+    walk_tree_methods[2] = &GridLocalPolynomial::walkTreeRule<2, effrule, isZeroOrder>;
+    hierarchical_functions_method = &GridLocalPolynomial::evaluateHierarchicalFunctionsRule<effrule, isZeroOrder>;
+    sparse_block_form_method = &GridLocalPolynomial::buildSparseMatrixBlockFormRule<effrule, isZeroOrder>;
+}
 void GridLocalPolynomial::makeRule(TypeOneDRule crule){
-    if (crule == rule_localp){
-        rule = make_unique_ptr<templRuleLocalPolynomial<rule_localp, false>>();
+    if (order == 0){
+        setRuleMethods<rule_localp, true>();
+    }else if (crule == rule_localp){
+        setRuleMethods<rule_localp, false>();
     }else if (crule == rule_semilocalp){
-        rule = make_unique_ptr<templRuleLocalPolynomial<rule_semilocalp, false>>();
+        setRuleMethods<rule_semilocalp, false>();
     }else if (crule == rule_localp0){
-        rule = make_unique_ptr<templRuleLocalPolynomial<rule_localp0, false>>();
+        setRuleMethods<rule_localp0, false>();
     }else if (crule == rule_localpb){
-        rule = make_unique_ptr<templRuleLocalPolynomial<rule_localpb, false>>();
-    }
-    if (order == 0){
-        rule = make_unique_ptr<templRuleLocalPolynomial<rule_localp, true>>();
+        setRuleMethods<rule_localpb, false>();
     }
     rule->setMaxOrder(order);
 }
@@ -75,17 +83,17 @@ template<bool iomode> void GridLocalPolynomial::write(std::ostream &os) const{
     if (!points.empty()) points.write<iomode>(os);
     if (iomode == mode_ascii){ // backwards compatible: surpluses and needed, or needed and surpluses
         IO::writeFlag<iomode, IO::pad_auto>((surpluses.getNumStrips() != 0), os);
-        if (surpluses.getNumStrips() != 0) IO::writeVector<iomode, IO::pad_line>(surpluses.getVector(), os);
+        if (surpluses.getNumStrips() != 0) IO::writeVector<iomode, IO::pad_line>(surpluses.getStrip(0), surpluses.getTotalEntries(), os);
         IO::writeFlag<iomode, IO::pad_auto>(!needed.empty(), os);
         if (!needed.empty()) needed.write<iomode>(os);
     }else{
         IO::writeFlag<iomode, IO::pad_auto>(!needed.empty(), os);
         if (!needed.empty()) needed.write<iomode>(os);
         IO::writeFlag<iomode, IO::pad_auto>((surpluses.getNumStrips() != 0), os);
-        if (surpluses.getNumStrips() != 0) IO::writeVector<iomode, IO::pad_line>(surpluses.getVector(), os);
+        if (surpluses.getNumStrips() != 0) IO::writeVector<iomode, IO::pad_line>(surpluses.getStrip(0), surpluses.getTotalEntries(), os);
     }
     IO::writeFlag<iomode, IO::pad_auto>((parents.getNumStrips() != 0), os);
-    if (parents.getNumStrips() != 0) IO::writeVector<iomode, IO::pad_line>(parents.getVector(), os);
+    if (parents.getNumStrips() != 0) IO::writeVector<iomode, IO::pad_line>(parents.getStrip(0), parents.getTotalEntries(), os);
 
     IO::writeNumbers<iomode, IO::pad_rspace>(os, (int) roots.size());
     if (roots.size() > 0){ // the tree is empty, can happend when using dynamic construction
@@ -133,6 +141,7 @@ template<bool iomode> void GridLocalPolynomial::read(std::istream &is){
             indx[0] = IO::readNumber<iomode, int>(is); // there is a special case when the grid has only one point without any children
         }
     }
+    flattenTree();
 
     if (num_outputs > 0) values.read<iomode>(is);
 }
@@ -142,6 +151,60 @@ template void GridLocalPolynomial::write<mode_binary>(std::ostream &) const;
 template void GridLocalPolynomial::read<mode_ascii>(std::istream &);
 template void GridLocalPolynomial::read<mode_binary>(std::istream &);
 
+void GridLocalPolynomial::writeSections(IO::SectionWriter &sections) const{
+    std::ostream &os = sections.addSection("grid");
+    IO::writeNumbers<mode_binary, IO::pad_none>(os, num_dimensions, num_outputs, order, top_level);
+    IO::writeRule<mode_binary>(rule->getType(), os);
+
+    if (!points.empty()) points.write<mode_binary>(sections.addSection("points"));
+    if (!needed.empty()) needed.write<mode_binary>(sections.addSection("needed"));
+    if (surpluses.getNumStrips() != 0) IO::writeVector<mode_binary, IO::pad_none>(surpluses.getStrip(0), surpluses.getTotalEntries(), sections.addSection("surplus"));
+
+    std::ostream &tree = sections.addSection("tree");
+    IO::writeFlag<mode_binary, IO::pad_none>((parents.getNumStrips() != 0), tree);
+    if (parents.getNumStrips() != 0) IO::writeVector<mode_binary, IO::pad_none>(parents.getStrip(0), parents.getTotalEntries(), tree);
+    IO::writeNumbers<mode_binary, IO::pad_none>(tree, (int) roots.size());
+    if (roots.size() > 0){
+        IO::writeVector<mode_binary, IO::pad_none>(roots, tree);
+        IO::writeVector<mode_binary, IO::pad_none>(pntr, tree);
+        IO::writeVector<mode_binary, IO::pad_none>(indx, tree);
+    }
+
+    if (num_outputs > 0) values.writeSection(sections.addSection("values"));
+}
+void GridLocalPolynomial::readSections(IO::SectionReader &sections){
+    reset();
+    std::istream &is = sections.getSection("grid");
+    num_dimensions = IO::readNumber<mode_binary, int>(is);
+    num_outputs = IO::readNumber<mode_binary, int>(is);
+    order = IO::readNumber<mode_binary, int>(is);
+    top_level = IO::readNumber<mode_binary, int>(is);
+    TypeOneDRule crule = IO::readRule<mode_binary>(is);
+    makeRule(crule);
+
+    if (sections.hasSection("points")) points.read(sections, "points");
+    if (sections.hasSection("needed")) needed.read(sections, "needed");
+    if (sections.hasSection("surplus"))
+        surpluses = IO::readData2D<double>(sections, "surplus", num_outputs, points.getNumIndexes());
+
+    std::istream &tree = sections.getSection("tree");
+    if (IO::readFlag<mode_binary>(tree))
+        parents = IO::readData2D<mode_binary, int>(tree, rule->getMaxNumParents() * num_dimensions, points.getNumIndexes());
+
+    size_t num_points = (size_t) ((points.empty()) ? needed.getNumIndexes() : points.getNumIndexes());
+    roots.resize((size_t) IO::readNumber<mode_binary, int>(tree));
+    if (roots.size() > 0){
+        IO::readVector<mode_binary>(tree, roots);
+        pntr.resize(num_points + 1);
+        IO::readVector<mode_binary>(tree, pntr);
+        indx.resize((pntr[num_points] > 0) ? (size_t) pntr[num_points] : 1); // a grid with one point and no children stores a single entry
+        IO::readVector<mode_binary>(tree, indx);
+    }
+    flattenTree();
+
+    if (num_outputs > 0) values.read(sections, "values");
+}
+
 void GridLocalPolynomial::makeGrid(int cnum_dimensions, int cnum_outputs, int depth, int corder, TypeOneDRule crule, const std::vector<int> &level_limits){
     reset();
     num_dimensions = cnum_dimensions;
@@ -186,6 +249,10 @@ void GridLocalPolynomial::copyGrid(const GridLocalPolynomial *pwpoly, int ibegin
     pntr  = pwpoly->pntr;
     indx  = pwpoly->indx;
 
+    tree_nodes   = pwpoly->tree_nodes;
+    tree_skip    = pwpoly->tree_skip;
+    tree_indexes = pwpoly->tree_indexes;
+
     makeRule(pwpoly->rule->getType());
 
     sparse_affinity = pwpoly->sparse_affinity;
@@ -245,7 +312,7 @@ void GridLocalPolynomial::evaluate(const double x[], double y[]) const{
     std::fill_n(y, num_outputs, 0.0);
     std::vector<int> sindx; // dummy variables, never references in mode 0 below
     std::vector<double> svals;
-    walkTree<0>(points, x, sindx, svals, y);
+    walkTree<0>(x, sindx, svals, y);
 }
 void GridLocalPolynomial::evaluateBatch(const double x[], int num_x, double y[]) const{
     if (num_x == 1){ evaluate(x, y); return; }
@@ -255,6 +322,51 @@ void GridLocalPolynomial::evaluateBatch(const double x[], int num_x, double y[])
     for(int i=0; i<num_x; i++)
         evaluate(xwrap.getStrip(i), ywrap.getStrip(i));
 }
+void GridLocalPolynomial::evaluateBatch(const double x[], int num_x, float y[]) const{
+    Utils::Wrapper2D<double const> xwrap(num_dimensions, x);
+    Utils::Wrapper2D<float> ywrap(num_outputs, y);
+    Utils::Wrapper2D<float const> swrap(num_outputs, getFloatCoefficients(surpluses.getStrip(0), surpluses.getTotalEntries()));
+    #pragma omp parallel
+    {
+        std::vector<int> sindx; // the sparse basis is reused across the points handled by this thread
+        std::vector<double> svals;
+        #pragma omp for
+        for(int i=0; i<num_x; i++){
+            sindx.clear();
+            svals.clear();
+            walkTree<1>(xwrap.getStrip(i), sindx, svals, nullptr);
+            float *this_y = ywrap.getStrip(i);
+            std::fill_n(this_y, num_outputs, 0.0f);
+            for(size_t j=0; j<sindx.size(); j++){
+                const float *s = swrap.getStrip(sindx[j]);
+                float basis_value = (float) svals[j];
+                for(int k=0; k<num_outputs; k++) this_y[k] += basis_value * s[k];
+            }
+        }
+    }
+}
+void GridLocalPolynomial::evaluateBatchOutputs(const double x[], int num_x, const int outputs[], int num_selected, double y[]) const{
+    Utils::Wrapper2D<double const> xwrap(num_dimensions, x);
+    Utils::Wrapper2D<double> ywrap(num_selected, y);
+    #pragma omp parallel
+    {
+        std::vector<int> sindx; // the sparse basis is reused across the points handled by this thread
+        std::vector<double> svals;
+        #pragma omp for
+        for(int i=0; i<num_x; i++){
+            sindx.clear();
+            svals.clear();
+            walkTree<1>(xwrap.getStrip(i), sindx, svals, nullptr);
+            double *this_y = ywrap.getStrip(i);
+            std::fill_n(this_y, num_selected, 0.0);
+            for(size_t j=0; j<sindx.size(); j++){
+                const double *s = surpluses.getStrip(sindx[j]);
+                double basis_value = svals[j];
+                for(int k=0; k<num_selected; k++) this_y[k] += basis_value * s[outputs[k]];
+            }
+        }
+    }
+}
 
 #ifdef Tasmanian_ENABLE_BLAS
 void GridLocalPolynomial::evaluateBlas(const double x[], int num_x, double y[]) const{
@@ -293,6 +405,31 @@ void GridLocalPolynomial::evaluateBlas(const double x[], int num_x, double y[])
         }
     }
 }
+void GridLocalPolynomial::evaluateBlas(const double x[], int num_x, float y[]) const{
+    if ((sparse_affinity == 1) || ((sparse_affinity == 0) && (num_outputs <= 1024))){
+        evaluateBatch(x, num_x, y);
+        return;
+    }
+
+    std::vector<int> sindx, spntr;
+    std::vector<double> svals;
+    buildSpareBasisMatrix(x, num_x, 32, spntr, sindx, svals);
+
+    int num_points = points.getNumIndexes();
+    double nnz = (double) spntr[num_x];
+    double total_size = ((double) num_x) * ((double) num_points);
+
+    if ((sparse_affinity == -1) || ((sparse_affinity == 0) && (nnz / total_size > 0.1))){
+        Data2D<float> A(num_points, num_x, 0.0f);
+        for(int i=0; i<num_x; i++){
+            float *row = A.getStrip(i);
+            for(int j=spntr[i]; j<spntr[i+1]; j++) row[sindx[j]] = (float) svals[j];
+        }
+        TasBLAS::denseMultiply(num_outputs, num_x, num_points, 1.0f, getFloatCoefficients(surpluses.getStrip(0), surpluses.getTotalEntries()), A.getStrip(0), 0.0f, y);
+    }else{
+        evaluateBatch(x, num_x, y);
+    }
+}
 #endif
 
 #ifdef Tasmanian_ENABLE_CUDA
@@ -354,7 +491,7 @@ void GridLocalPolynomial::evaluateCudaMixed(CudaEngine *engine, const double x[]
     if (num_x > 1){
         buildSpareBasisMatrix(x, num_x, 32, spntr, sindx, svals);
     }else{
-        walkTree<2>(points, x, sindx, svals, nullptr);
+        walkTree<2>(x, sindx, svals, nullptr);
     }
     engine->sparseMultiply(num_outputs, num_x, points.getNumIndexes(), 1.0, cuda_cache->surpluses, spntr, sindx, svals, y);
 }
@@ -412,8 +549,15 @@ void GridLocalPolynomial::updateValues(double const *vals){
     }
 }
 void GridLocalPolynomial::loadNeededPoints(const double *vals){
-    updateValues(vals);
-    recomputeSurpluses();
+    if (points.empty() || needed.empty() || (surpluses.getNumStrips() != points.getNumIndexes())){
+        updateValues(vals);
+        recomputeSurpluses();
+    }else{ // refinement, the surpluses of the existing points are already computed
+        MultiIndexSet new_points = needed;
+        Data2D<double> old_surpluses = std::move(surpluses);
+        updateValues(vals);
+        updateSurplusesIncremental(new_points, old_surpluses);
+    }
 }
 void GridLocalPolynomial::mergeRefinement(){
     if (needed.empty()) return; // nothing to do
@@ -443,6 +587,7 @@ void GridLocalPolynomial::beginConstruction(){
         roots.clear();
         pntr.clear();
         indx.clear();
+        flattenTree();
     }
 }
 void GridLocalPolynomial::writeConstructionData(std::ostream &os, bool iomode) const{
@@ -707,7 +852,7 @@ void GridLocalPolynomial::getInterpolationWeights(const double x[], double *weig
     std::fill_n(weights, work.getNumIndexes(), 0.0);
 
     // construct a sparse vector and apply transpose surplus transformation
-    walkTree<1>(work, x, active_points, hbasis_values, nullptr);
+    walkTree<1>(x, active_points, hbasis_values, nullptr);
     auto ibasis = hbasis_values.begin();
     for(auto i : active_points) weights[i] = *ibasis++;
 
@@ -773,6 +918,10 @@ void GridLocalPolynomial::getInterpolationWeights(const double x[], double *weig
 }
 
 void GridLocalPolynomial::evaluateHierarchicalFunctions(const double x[], int num_x, double y[]) const{
+    (this->*hierarchical_functions_method)(x, num_x, y);
+}
+template<TypeOneDRule effrule, bool isZeroOrder>
+void GridLocalPolynomial::evaluateHierarchicalFunctionsRule(const double x[], int num_x, double y[]) const{
     const MultiIndexSet &work = (points.empty()) ? needed : points;
     int num_points = work.getNumIndexes();
     Utils::Wrapper2D<double const> xwrap(num_dimensions, x);
@@ -783,7 +932,7 @@ void GridLocalPolynomial::evaluateHierarchicalFunctions(const double x[], int nu
         double *this_y = ywrap.getStrip(i);
         bool dummy;
         for(int j=0; j<num_points; j++)
-            this_y[j] = evalBasisSupported(work.getIndex(j), this_x, dummy);
+            this_y[j] = evalBasisSupported<effrule, isZeroOrder>(work.getIndex(j), this_x, dummy);
     }
 }
 
@@ -800,6 +949,40 @@ void GridLocalPolynomial::recomputeSurpluses(){
     updateSurpluses(points, top_level, level, dagUp);
 }
 
+void GridLocalPolynomial::updateSurplusesIncremental(MultiIndexSet const &new_points, Data2D<double> const &old_surpluses){
+    int num_points = points.getNumIndexes();
+    std::vector<bool> is_new((size_t) num_points);
+    for(int i=0; i<num_points; i++) is_new[i] = (new_points.getSlot(points.getIndex(i)) != -1);
+
+    Data2D<int> dagUp = HierarchyManipulations::computeDAGup(points, rule.get());
+
+    int max_parents = num_dimensions * rule->getMaxNumParents();
+    for(int i=0; i<num_points; i++){
+        if (!is_new[i]){
+            int const *point_parents = dagUp.getStrip(i);
+            if (std::any_of(point_parents, point_parents + max_parents, [&](int p)->bool{ return ((p != -1) && is_new[p]); })){
+                recomputeSurpluses(); // an existing point gained a new ancestor, e.g., parents-first refinement
+                return;
+            }
+        }
+    }
+
+    std::vector<int> level = HierarchyManipulations::computeLevels(points, rule.get());
+
+    surpluses.resize(num_outputs, num_points);
+    int iold = 0;
+    for(int i=0; i<num_points; i++){
+        if (is_new[i]){
+            std::copy_n(values.getValues(i), num_outputs, surpluses.getStrip(i));
+        }else{
+            std::copy_n(old_surpluses.getStrip(iold++), num_outputs, surpluses.getStrip(i));
+            level[i] = 0; // the surpluses of the existing points are final
+        }
+    }
+
+    updateSurpluses(points, top_level, level, dagUp);
+}
+
 void GridLocalPolynomial::updateSurpluses(MultiIndexSet const &work, int max_level, std::vector<int> const &level, Data2D<int> const &dagUp){
     int num_points = work.getNumIndexes();
     int max_parents = num_dimensions * rule->getMaxNumParents();
@@ -808,46 +991,78 @@ void GridLocalPolynomial::updateSurpluses(MultiIndexSet const &work, int max_lev
     for(int i=0; i<num_points; i++)
         if (level[i] > 0) indexses_for_levels[level[i]].push_back(i);
 
-    for(int l=1; l<=max_level; l++){
-        int level_size = (int) indexses_for_levels[l].size();
-        #pragma omp parallel for schedule(dynamic)
-        for(int s=0; s<level_size; s++){
-            int i = indexses_for_levels[l][s];
-
-            int const *p = work.getIndex(i);
-            std::vector<double> x(num_dimensions);
-            std::transform(p, p + num_dimensions, x.begin(), [&](int k)->double{ return rule->getNode(k); });
-            double *surpi = surpluses.getStrip(i);
+    // subtracts the contribution of all ancestors of point i using the workspace of the calling thread
+    auto update_point = [&](int i, Utils::VisitedSet &used, std::vector<int> &monkey_count, std::vector<int> &monkey_tail, std::vector<double> &x)->void{
+        int const *p = work.getIndex(i);
+        std::transform(p, p + num_dimensions, x.begin(), [&](int k)->double{ return rule->getNode(k); });
+        double *surpi = surpluses.getStrip(i);
 
-            std::vector<int> monkey_count(max_level + 1);
-            std::vector<int> monkey_tail(max_level + 1);
-            std::vector<bool> used(num_points, false);
+        used.clear();
+        int current = 0;
 
-            int current = 0;
-
-            monkey_count[0] = 0;
-            monkey_tail[0] = i;
+        monkey_count[0] = 0;
+        monkey_tail[0] = i;
 
-            while(monkey_count[0] < max_parents){
-                if (monkey_count[current] < max_parents){
-                    int branch = dagUp.getStrip(monkey_tail[current])[monkey_count[current]];
-                    if ((branch == -1) || (used[branch])){
-                        monkey_count[current]++;
-                    }else{
-                        const double *branch_surp = surpluses.getStrip(branch);
-                        double basis_value = evalBasisRaw(work.getIndex(branch), x.data());
-                        for(int k=0; k<num_outputs; k++)
-                            surpi[k] -= basis_value * branch_surp[k];
-                        used[branch] = true;
-
-                        monkey_count[++current] = 0;
-                        monkey_tail[current] = branch;
-                    }
+        while(monkey_count[0] < max_parents){
+            if (monkey_count[current] < max_parents){
+                int branch = dagUp.getStrip(monkey_tail[current])[monkey_count[current]];
+                if ((branch == -1) || !used.insert(branch)){
+                    monkey_count[current]++;
                 }else{
-                    monkey_count[--current]++;
+                    const double *branch_surp = surpluses.getStrip(branch);
+                    double basis_value = evalBasisRaw(work.getIndex(branch), x.data());
+                    for(int k=0; k<num_outputs; k++)
+                        surpi[k] -= basis_value * branch_surp[k];
+
+                    monkey_count[++current] = 0;
+                    monkey_tail[current] = branch;
                 }
+            }else{
+                monkey_count[--current]++;
             }
         }
+    };
+
+    if (executor){
+        struct SurplusWorkspace{
+            SurplusWorkspace() : used(0){}
+            Utils::VisitedSet used;
+            std::vector<int> monkey_count, monkey_tail;
+            std::vector<double> x;
+        };
+        Utils::WorkspacePool<SurplusWorkspace> task_workspaces; // one workspace per concurrent task, reused by the following tasks
+        for(int l=1; l<=max_level; l++){
+            int level_size = (int) indexses_for_levels[l].size();
+            Utils::runExecutorTasks(executor, (level_size + 31) / 32, [&](int task)->void{
+                auto workspace = task_workspaces.acquire();
+                if (workspace->used.getSize() != num_points){ // new workspace
+                    workspace->used = Utils::VisitedSet(num_points);
+                    workspace->monkey_count.resize((size_t) max_level + 1);
+                    workspace->monkey_tail.resize((size_t) max_level + 1);
+                    workspace->x.resize((size_t) num_dimensions);
+                }
+                for(int s = 32 * task; s < std::min(32 * (task + 1), level_size); s++)
+                    update_point(indexses_for_levels[l][s], workspace->used, workspace->monkey_count, workspace->monkey_tail, workspace->x);
+            });
+        }
+        return;
+    }
+
+    #pragma omp parallel
+    {
+        // per-thread workspace, reused for all points; the ancestors are marked in an epoch-stamped set
+        // so that each point costs only as much as the size of its ancestry and not the size of the grid
+        Utils::VisitedSet used(num_points);
+        std::vector<int> monkey_count(max_level + 1);
+        std::vector<int> monkey_tail(max_level + 1);
+        std::vector<double> x(num_dimensions);
+
+        for(int l=1; l<=max_level; l++){
+            int level_size = (int) indexses_for_levels[l].size();
+            #pragma omp for schedule(dynamic, 32)
+            for(int s=0; s<level_size; s++)
+                update_point(indexses_for_levels[l][s], used, monkey_count, monkey_tail, x);
+        }
     }
 }
 
@@ -910,8 +1125,6 @@ void GridLocalPolynomial::buildSpareBasisMatrixStatic(const double x[], int num_
     }
 }
 int GridLocalPolynomial::getSpareBasisMatrixNZ(const double x[], int num_x) const{
-    const MultiIndexSet &work = (points.empty()) ? needed : points;
-
     Utils::Wrapper2D<double const> xwrap(num_dimensions, x);
     std::vector<int> num_nz(num_x);
 
@@ -919,7 +1132,7 @@ int GridLocalPolynomial::getSpareBasisMatrixNZ(const double x[], int num_x) cons
     for(int i=0; i<num_x; i++){
         std::vector<int> sindx;
         std::vector<double> svals;
-        walkTree<1>(work, xwrap.getStrip(i), sindx, svals, nullptr);
+        walkTree<1>(xwrap.getStrip(i), sindx, svals, nullptr);
         num_nz[i] = (int) sindx.size();
     }
 
@@ -927,6 +1140,10 @@ int GridLocalPolynomial::getSpareBasisMatrixNZ(const double x[], int num_x) cons
 }
 
 void GridLocalPolynomial::buildSparseMatrixBlockForm(const double x[], int num_x, int num_chunk, std::vector<int> &numnz, std::vector<std::vector<int>> &tindx, std::vector<std::vector<double>> &tvals) const{
+    (this->*sparse_block_form_method)(x, num_x, num_chunk, numnz, tindx, tvals);
+}
+template<TypeOneDRule effrule, bool isZeroOrder>
+void GridLocalPolynomial::buildSparseMatrixBlockFormRule(const double x[], int num_x, int num_chunk, std::vector<int> &numnz, std::vector<std::vector<int>> &tindx, std::vector<std::vector<double>> &tvals) const{
     // numnz will be resized to (num_x + 1) with the last entry set to a dummy zero
     numnz.resize((size_t) num_x);
     int num_blocks = num_x / num_chunk + ((num_x % num_chunk != 0) ? 1 : 0);
@@ -934,7 +1151,6 @@ void GridLocalPolynomial::buildSparseMatrixBlockForm(const double x[], int num_x
     tindx.resize(num_blocks);
     tvals.resize(num_blocks);
 
-    const MultiIndexSet &work = (points.empty()) ? needed : points;
     Utils::Wrapper2D<double const> xwrap(num_dimensions, x);
 
     #pragma omp parallel for
@@ -944,7 +1160,7 @@ void GridLocalPolynomial::buildSparseMatrixBlockForm(const double x[], int num_x
         int chunk_size = (b < num_blocks - 1) ? num_chunk : (num_x - (num_blocks - 1) * num_chunk);
         for(int i = b * num_chunk; i < b * num_chunk + chunk_size; i++){
             numnz[i] = (int) tindx[b].size();
-            walkTree<1>(work, xwrap.getStrip(i), tindx[b], tvals[b], nullptr);
+            walkTreeRule<1, effrule, isZeroOrder>(xwrap.getStrip(i), tindx[b], tvals[b], nullptr);
             numnz[i] = (int) tindx[b].size() - numnz[i];
         }
     }
@@ -1024,6 +1240,50 @@ void GridLocalPolynomial::buildTree(){
 
     indx = std::vector<int>((size_t) ((pntr[num_points] > 0) ? pntr[num_points] : 1));
     std::copy_if(tree.getVector().begin(), tree.getVector().end(), indx.begin(), [](int t)->bool{ return (t > -1); });
+
+    flattenTree();
+}
+
+void GridLocalPolynomial::flattenTree(){
+    tree_nodes = std::vector<int>();
+    tree_skip = std::vector<int>();
+    tree_indexes = Data2D<int>();
+    if (roots.empty()) return;
+
+    const MultiIndexSet &work = (points.empty()) ? needed : points;
+    int num_points = work.getNumIndexes();
+    tree_nodes.reserve((size_t) num_points);
+    tree_skip.reserve((size_t) num_points);
+
+    std::vector<int> monkey_count((size_t) (top_level + 1)); // counts the branches of the current node
+    std::vector<int> monkey_tail(monkey_count.size()); // keeps track of the previous node (history)
+    std::vector<int> monkey_position(monkey_count.size()); // the position of the nodes in the history within tree_nodes
+
+    for(auto r : roots){
+        int current = 0;
+        monkey_tail[0] = r;
+        monkey_count[0] = pntr[r];
+        monkey_position[0] = (int) tree_nodes.size();
+        tree_nodes.push_back(r);
+        tree_skip.push_back(0);
+
+        while(current >= 0){
+            if (monkey_count[current] < pntr[monkey_tail[current]+1]){
+                int p = indx[monkey_count[current]++];
+                monkey_tail[++current] = p;
+                monkey_count[current] = pntr[p];
+                monkey_position[current] = (int) tree_nodes.size();
+                tree_nodes.push_back(p);
+                tree_skip.push_back(0);
+            }else{
+                tree_skip[monkey_position[current--]] = (int) tree_nodes.size(); // the sub-tree is complete
+            }
+        }
+    }
+
+    tree_indexes = Data2D<int>(num_dimensions, (int) tree_nodes.size());
+    for(size_t i=0; i<tree_nodes.size(); i++)
+        std::copy_n(work.getIndex(tree_nodes[i]), num_dimensions, tree_indexes.getStrip((int) i));
 }
 
 void GridLocalPolynomial::integrateHierarchicalFunctions(double integrals[]) const{
@@ -1065,6 +1325,7 @@ void GridLocalPolynomial::getQuadratureWeights(double *weights) const{
 
     std::vector<double> node(num_dimensions);
     int max_parents = rule->getMaxNumParents() * num_dimensions;
+    Utils::VisitedSet used(num_points);
 
     for(int l=top_level; l>0; l--){
         for(int i=0; i<num_points; i++){
@@ -1072,7 +1333,7 @@ void GridLocalPolynomial::getQuadratureWeights(double *weights) const{
                 const int* p = work.getIndex(i);
                 for(int j=0; j<num_dimensions; j++) node[j] = rule->getNode(p[j]);
 
-                std::vector<bool> used(work.getNumIndexes(), false);
+                used.clear();
 
                 monkey_count[0] = 0;
                 monkey_tail[0] = i;
@@ -1081,14 +1342,13 @@ void GridLocalPolynomial::getQuadratureWeights(double *weights) const{
                 while(monkey_count[0] < max_parents){
                     if (monkey_count[current] < max_parents){
                         int branch = dagUp.getStrip(monkey_tail[current])[monkey_count[current]];
-                        if ((branch == -1) || used[branch]){
+                        if ((branch == -1) || !used.insert(branch)){
                             monkey_count[current]++;
                         }else{
                             const int *func = work.getIndex(branch);
                             basis_value = rule->evalRaw(func[0], node[0]);
                             for(int j=1; j<num_dimensions; j++) basis_value *= rule->evalRaw(func[j], node[j]);
                             weights[branch] -= weights[i] * basis_value;
-                            used[branch] = true;
 
                             monkey_count[++current] = 0;
                             monkey_tail[current] = branch;
@@ -1107,16 +1367,14 @@ void GridLocalPolynomial::integrate(double q[], double *conformal_correction) co
     std::fill(q, q + num_outputs, 0.0);
 
     if (conformal_correction == 0){
-        std::vector<double> integrals(num_points);
-        integrateHierarchicalFunctions(integrals.data());
+        std::vector<double> const &integrals = getCachedHierarchicalIntegrals();
         for(int i=0; i<num_points; i++){
             const double *s = surpluses.getStrip(i);
             double wi = integrals[i];
             for(int k=0; k<num_outputs; k++) q[k] += wi * s[k];
         }
     }else{
-        std::vector<double> w(num_points);
-        getQuadratureWeights(w.data());
+        std::vector<double> const &w = getCachedQuadratureWeights();
         for(int i=0; i<num_points; i++){
             double wi = w[i] * conformal_correction[i];
             const double *vals = values.getValues(i);
@@ -1210,6 +1468,7 @@ Data2D<int> GridLocalPolynomial::buildUpdateMap(double tolerance, TypeRefinement
 
             std::vector<int> monkey_count(max_level + 1);
             std::vector<int> monkey_tail(max_level + 1);
+            Utils::VisitedSet used(nump);
 
             for(int l=1; l<=max_level; l++){
                 for(int i=0; i<nump; i++){
@@ -1221,12 +1480,12 @@ Data2D<int> GridLocalPolynomial::buildUpdateMap(double tolerance, TypeRefinement
                         int current = 0;
                         monkey_count[0] = d * max_1D_parents;
                         monkey_tail[0] = pnts[i]; // uses the global indexes
-                        std::vector<bool> used(nump, false);
+                        used.clear();
 
                         while(monkey_count[0] < (d+1) * max_1D_parents){
                             if (monkey_count[current] < (d+1) * max_1D_parents){
                                 int branch = dagUp.getStrip(monkey_tail[current])[monkey_count[current]];
-                                if ((branch == -1) || (used[global_to_pnts[branch]])){
+                                if ((branch == -1) || !used.insert(global_to_pnts[branch])){
                                     monkey_count[current]++;
                                 }else{
                                     const int *branch_point = points.getIndex(branch);
@@ -1234,7 +1493,6 @@ Data2D<int> GridLocalPolynomial::buildUpdateMap(double tolerance, TypeRefinement
                                     const double *branch_vals = vals.getStrip(global_to_pnts[branch]);
                                     for(int k=0; k<active_outputs; k++) valsi[k] -= basis_value * branch_vals[k];
 
-                                    used[global_to_pnts[branch]] = true;
                                     monkey_count[++current] = d * max_1D_parents;
                                     monkey_tail[current] = branch;
                                 }
@@ -1347,7 +1605,7 @@ void GridLocalPolynomial::addChildLimited(const int point[], int direction, cons
 
 void GridLocalPolynomial::clearRefinement(){ needed = MultiIndexSet(); }
 const double* GridLocalPolynomial::getSurpluses() const{
-    return surpluses.getVector().data();
+    return surpluses.getStrip(0);
 }
 const int* GridLocalPolynomial::getNeededIndexes() const{
     return (needed.empty()) ? 0 : needed.getIndex(0);
@@ -63,6 +63,8 @@ public:
 
     template<bool iomode> void write(std::ostream &os) const;
     template<bool iomode> void read(std::istream &is);
+    void writeSections(IO::SectionWriter &sections) const; // binary container format, see TasmanianSparseGrid::writeBinary()
+    void readSections(IO::SectionReader &sections);
 
     void makeGrid(int cnum_dimensions, int cnum_outputs, int depth, int corder, TypeOneDRule crule, const std::vector<int> &level_limits);
     void copyGrid(const GridLocalPolynomial *pwpoly, int ibegin, int iend);
@@ -83,9 +85,12 @@ public:
     void integrate(double q[], double *conformal_correction) const;
 
     void evaluateBatch(const double x[], int num_x, double y[]) const;
+    void evaluateBatchOutputs(const double x[], int num_x, const int outputs[], int num_selected, double y[]) const; // computes only the selected outputs
+    void evaluateBatch(const double x[], int num_x, float y[]) const; // single precision
 
     #ifdef Tasmanian_ENABLE_BLAS
     void evaluateBlas(const double x[], int num_x, double y[]) const;
+    void evaluateBlas(const double x[], int num_x, float y[]) const;
     #endif
 
     #ifdef Tasmanian_ENABLE_CUDA
@@ -146,6 +151,15 @@ protected:
 
     void buildTree();
 
+    /*!
+     * \brief Creates the flattened version of the tree defined by \b roots, \b pntr and \b indx.
+     *
+     * The nodes are listed in the order of a depth-first walk, together with the multi-indexes stored inline
+     * and a skip pointer to the first node after the sub-tree, see walkTree().
+     * Must be called every time the tree is modified.
+     */
+    void flattenTree();
+
     //! \brief Returns a list of indexes of the nodes in \b points that are descendants of the \b point.
     std::vector<int> getSubGraph(std::vector<int> const &point) const;
 
@@ -160,6 +174,16 @@ protected:
 
     void recomputeSurpluses();
 
+    /*!
+     * \brief Computes the surpluses only for the \b new_points, the rest of the surpluses are copied from \b old_surpluses.
+     *
+     * Called after \b new_points have been merged into \b points, the strips of \b old_surpluses follow the order of the points
+     * before the merge. The new points cannot change the surpluses of their ancestors, hence only the new surpluses are computed;
+     * if any of the new points is an ancestor of an existing point (e.g., following parents-first refinement),
+     * the method falls back to recomputeSurpluses().
+     */
+    void updateSurplusesIncremental(MultiIndexSet const &new_points, Data2D<double> const &old_surpluses);
+
     /*!
      * \brief Update the surpluses for a portion of the graph.
      *
@@ -185,52 +209,40 @@ protected:
      * - \b mode \b 1, ignore \b y, form a sparse vector by std::vector::push_back() to the \b sindx and \b svals
      * - \b mode \b 2, same as \b mode \b 1 but it also sorts the entries within the vector (requirement of Nvidia cusparseDgemvi)
      *
-     * In all cases, \b work is the \b points or \b needed set that has been used to construct the tree.
+     * The walk uses the flattened tree, see flattenTree(), the nodes are visited with a linear scan
+     * and the sub-tree of each node without support at \b x is skipped in a single step.
      */
     template<int mode>
-    void walkTree(const MultiIndexSet &work, const double x[], std::vector<int> &sindx, std::vector<double> &svals, double *y) const{
-        std::vector<int> monkey_count(top_level+1); // traverse the tree, counts the branches of the current node
-        std::vector<int> monkey_tail(top_level+1); // traverse the tree, keeps track of the previous node (history)
+    void walkTree(const double x[], std::vector<int> &sindx, std::vector<double> &svals, double *y) const{
+        (this->*walk_tree_methods[mode])(x, sindx, svals, y);
+    }
 
-        for(const auto &r : roots){
+    /*!
+     * \brief Implementation of walkTree() for the rule with type templRuleLocalPolynomial<\b effrule, \b isZeroOrder>.
+     *
+     * The rule type is known at compile time, hence the calls to the basis functions can be inlined;
+     * the instantiation that matches the current rule is selected by makeRule(), see setRuleMethods().
+     */
+    template<int mode, TypeOneDRule effrule, bool isZeroOrder>
+    void walkTreeRule(const double x[], std::vector<int> &sindx, std::vector<double> &svals, double *y) const{
+        int num_nodes = (int) tree_nodes.size();
+        int inode = 0;
+        while(inode < num_nodes){
             bool isSupported;
-            double basis_value = evalBasisSupported(work.getIndex(r), x, isSupported);
+            double basis_value = evalBasisSupported<effrule, isZeroOrder>(tree_indexes.getStrip(inode), x, isSupported);
 
             if (isSupported){
+                int p = tree_nodes[inode];
                 if (mode == 0){
-                    double const *s = surpluses.getStrip(r);
+                    double const *s = surpluses.getStrip(p);
                     for(int k=0; k<num_outputs; k++) y[k] += basis_value * s[k];
                 }else{
-                    sindx.push_back(r);
+                    sindx.push_back(p);
                     svals.push_back(basis_value);
                 }
-
-                int current = 0;
-                monkey_tail[0] = r;
-                monkey_count[0] = pntr[r];
-
-                while(monkey_count[0] < pntr[monkey_tail[0]+1]){
-                    if (monkey_count[current] < pntr[monkey_tail[current]+1]){
-                        int p = indx[monkey_count[current]];
-                        basis_value = evalBasisSupported(work.getIndex(p), x, isSupported);
-                        if (isSupported){
-                            if (mode == 0){
-                                double const *s = surpluses.getStrip(p);
-                                for(int k=0; k<num_outputs; k++) y[k] += basis_value * s[k];
-                            }else{
-                                sindx.push_back(p);
-                                svals.push_back(basis_value);
-                            }
-
-                            monkey_tail[++current] = p;
-                            monkey_count[current] = pntr[p];
-                        }else{
-                            monkey_count[current]++;
-                        }
-                    }else{
-                        monkey_count[--current]++;
-                    }
-                }
+                inode++; // move to the first kid
+            }else{
+                inode = tree_skip[inode]; // skip all descendants
             }
         }
 
@@ -253,6 +265,32 @@ protected:
     double evalBasisRaw(const int point[], const double x[]) const;
     double evalBasisSupported(const int point[], const double x[], bool &isSupported) const;
 
+    //! \brief Same as evalBasisSupported() but the type of the rule is fixed at compile time.
+    template<TypeOneDRule effrule, bool isZeroOrder>
+    double evalBasisSupported(const int point[], const double x[], bool &isSupported) const{
+        const templRuleLocalPolynomial<effrule, isZeroOrder> *trule = static_cast<const templRuleLocalPolynomial<effrule, isZeroOrder>*>(rule.get());
+        double f = trule->evalSupport(point[0], x[0], isSupported);
+        if (!isSupported) return 0.0;
+        for(int j=1; j<num_dimensions; j++){
+            f *= trule->evalSupport(point[j], x[j], isSupported);
+            if (!isSupported) return 0.0;
+        }
+        return f;
+    }
+
+    //! \brief Implementation of evaluateHierarchicalFunctions() for a fixed rule type, see walkTreeRule().
+    template<TypeOneDRule effrule, bool isZeroOrder>
+    void evaluateHierarchicalFunctionsRule(const double x[], int num_x, double y[]) const;
+
+    //! \brief Implementation of buildSparseMatrixBlockForm() for a fixed rule type, see walkTreeRule().
+    template<TypeOneDRule effrule, bool isZeroOrder>
+    void buildSparseMatrixBlockFormRule(const double x[], int num_x, int num_chunk, std::vector<int> &numnz,
+                                        std::vector<std::vector<int>> &tindx, std::vector<std::vector<double>> &tvals) const;
+
+    //! \brief Set the pointers to the methods instantiated for templRuleLocalPolynomial<\b effrule, \b isZeroOrder>, called from makeRule().
+    template<TypeOneDRule effrule, bool isZeroOrder>
+    void setRuleMethods();
+
     std::vector<double> getNormalization() const;
 
     Data2D<int> buildUpdateMap(double tolerance, TypeRefinement criteria, int output, const double *scale_correction) const;
@@ -344,7 +382,7 @@ protected:
     void loadCudaSurpluses() const{
         if (!cuda_cache) cuda_cache = std::unique_ptr<CudaLocalPolynomialData<double>>(new CudaLocalPolynomialData<double>);
         if (cuda_cache->surpluses.size() != 0) return;
-        cuda_cache->surpluses.load(surpluses.getVector());
+        cuda_cache->surpluses.load(surpluses.getTotalEntries(), surpluses.getStrip(0));
     }
     void clearCudaSurpluses(){ if (cuda_cache) cuda_cache->surpluses.clear(); }
     #endif
@@ -361,8 +399,21 @@ private:
     std::vector<int> pntr;
     std::vector<int> indx;
 
+    // flattened tree for evaluation, see flattenTree()
+    std::vector<int> tree_nodes; // index of the node in the points (or needed) set, listed in depth-first order
+    std::vector<int> tree_skip; // position in tree_nodes of the first node after the sub-tree of the current node
+    Data2D<int> tree_indexes; // the multi-indexes of the nodes in the order of tree_nodes
+
     std::unique_ptr<BaseRuleLocalPolynomial> rule;
 
+    // methods instantiated for the type of the rule, set by makeRule()
+    using WalkTreeMethod = void (GridLocalPolynomial::*)(const double[], std::vector<int>&, std::vector<double>&, double*) const;
+    using HierarchicalFunctionsMethod = void (GridLocalPolynomial::*)(const double[], int, double[]) const;
+    using SparseBlockFormMethod = void (GridLocalPolynomial::*)(const double[], int, int, std::vector<int>&, std::vector<std::vector<int>>&, std::vector<std::vector<double>>&) const;
+    WalkTreeMethod walk_tree_methods[3];
+    HierarchicalFunctionsMethod hierarchical_functions_method;
+    SparseBlockFormMethod sparse_block_form_method;
+
     int sparse_affinity;
 
     std::unique_ptr<SimpleConstructData> dynamic_values;
@@ -36,6 +36,8 @@
 
 namespace TasGrid{
 
+constexpr int GridSequence::batch_block_size;
+
 GridSequence::GridSequence(){}
 GridSequence::~GridSequence(){}
 
@@ -50,7 +52,7 @@ template<bool iomode> void GridSequence::write(std::ostream &os) const{
     if (!needed.empty()) needed.write<iomode>(os);
 
     IO::writeFlag<iomode, IO::pad_auto>(!surpluses.empty(), os);
-    if (!surpluses.empty()) IO::writeVector<iomode, IO::pad_line>(surpluses.getVector(), os);
+    if (!surpluses.empty()) IO::writeVector<iomode, IO::pad_line>(surpluses.getStrip(0), surpluses.getTotalEntries(), os);
 
     if (num_outputs > 0) values.write<iomode>(os);
 }
@@ -77,6 +79,32 @@ template void GridSequence::write<mode_binary>(std::ostream &) const;
 template void GridSequence::read<mode_ascii>(std::istream &);
 template void GridSequence::read<mode_binary>(std::istream &);
 
+void GridSequence::writeSections(IO::SectionWriter &sections) const{
+    std::ostream &os = sections.addSection("grid");
+    IO::writeNumbers<mode_binary, IO::pad_none>(os, num_dimensions, num_outputs);
+    IO::writeRule<mode_binary>(rule, os);
+
+    if (!points.empty()) points.write<mode_binary>(sections.addSection("points"));
+    if (!needed.empty()) needed.write<mode_binary>(sections.addSection("needed"));
+    if (!surpluses.empty()) IO::writeVector<mode_binary, IO::pad_none>(surpluses.getStrip(0), surpluses.getTotalEntries(), sections.addSection("surplus"));
+    if (num_outputs > 0) values.writeSection(sections.addSection("values"));
+}
+void GridSequence::readSections(IO::SectionReader &sections){
+    reset();
+    std::istream &is = sections.getSection("grid");
+    num_dimensions = IO::readNumber<mode_binary, int>(is);
+    num_outputs = IO::readNumber<mode_binary, int>(is);
+    rule = IO::readRule<mode_binary>(is);
+
+    if (sections.hasSection("points")) points.read(sections, "points");
+    if (sections.hasSection("needed")) needed.read(sections, "needed");
+    if (sections.hasSection("surplus"))
+        surpluses = IO::readData2D<double>(sections, "surplus", num_outputs, points.getNumIndexes());
+    if (num_outputs > 0) values.read(sections, "values");
+
+    prepareSequence(0);
+}
+
 void GridSequence::reset(){
     clearAccelerationData();
     points = MultiIndexSet();
@@ -161,10 +189,10 @@ void GridSequence::updateGrid(MultiIndexSet &update){
 }
 
 void GridSequence::getLoadedPoints(double *x) const{
-    std::transform(points.getVector().begin(), points.getVector().end(), x, [&](int i)->double{ return nodes[i]; });
+    std::transform(points.getIndex(0), points.getIndex(points.getNumIndexes()), x, [&](int i)->double{ return nodes[i]; });
 }
 void GridSequence::getNeededPoints(double *x) const{
-    std::transform(needed.getVector().begin(), needed.getVector().end(), x, [&](int i)->double{ return nodes[i]; });
+    std::transform(needed.getIndex(0), needed.getIndex(needed.getNumIndexes()), x, [&](int i)->double{ return nodes[i]; });
 }
 void GridSequence::getPoints(double *x) const{
     if (points.empty()){ getNeededPoints(x); }else{ getLoadedPoints(x); }
@@ -214,6 +242,15 @@ void GridSequence::loadNeededPoints(const double *vals){
             values.setValues(vals);
             points = std::move(needed);
             needed = MultiIndexSet();
+        }else if (surpluses.getNumStrips() == points.getNumIndexes()){ // refinement, only the new surpluses have to be computed
+            MultiIndexSet new_points = std::move(needed);
+            needed = MultiIndexSet();
+            Data2D<double> old_surpluses = std::move(surpluses);
+            values.addValues(points, new_points, vals);
+            points.addSortedIndexes(new_points.getVector());
+            prepareSequence(0);
+            updateSurplusesIncremental(new_points, old_surpluses);
+            return;
         }else{ // merge needed and points
             values.addValues(points, needed, vals);
             points.addSortedIndexes(needed.getVector());
@@ -448,31 +485,135 @@ void GridSequence::finishConstruction(){
 }
 
 void GridSequence::evaluate(const double x[], double y[]) const{
-    std::vector<std::vector<double>> cache = cacheBasisValues<double>(x);
+    auto workspace = workspaces.acquire(); // the grid keeps the workspaces, no allocations after the first call
+    std::vector<std::vector<double>> &cache = *workspace;
+    cacheBasisValues<double>(x, cache);
 
     std::fill(y, y + num_outputs, 0.0);
 
     int num_points = points.getNumIndexes();
 
-    for(int i=0; i<num_points; i++){
-        const int* p = points.getIndex(i);
-        const double *s = surpluses.getStrip(i);
-        double basis_value = cache[0][p[0]];
+    // process the nodes in blocks, the products are taken dimension-by-dimension over the block
+    // and the surpluses are accumulated with a small dense matrix-vector product
+    double basis_values[batch_block_size];
+    for(int ibegin=0; ibegin<num_points; ibegin += batch_block_size){
+        int block_size = std::min(batch_block_size, num_points - ibegin);
+        const int *p = points.getIndex(ibegin);
+
+        const double *c = cache[0].data();
+        for(int i=0; i<block_size; i++) basis_values[i] = c[p[i * num_dimensions]];
         for(int j=1; j<num_dimensions; j++){
-            basis_value *= cache[j][p[j]];
+            c = cache[j].data();
+            for(int i=0; i<block_size; i++) basis_values[i] *= c[p[i * num_dimensions + j]];
         }
 
-        for(int k=0; k<num_outputs; k++){
-            y[k] += basis_value * s[k];
+        for(int i=0; i<block_size; i++){
+            const double *s = surpluses.getStrip(ibegin + i);
+            double basis_value = basis_values[i];
+            for(int k=0; k<num_outputs; k++) y[k] += basis_value * s[k];
         }
     }
 }
 void GridSequence::evaluateBatch(const double x[], int num_x, double y[]) const{
+    if (num_x == 1){
+        evaluate(x, y);
+        return;
+    }
+    evaluateBatchBlocks<double>(x, num_x, surpluses.getStrip(0), y);
+}
+void GridSequence::evaluateBatch(const double x[], int num_x, float y[]) const{
+    evaluateBatchBlocks<float>(x, num_x, getFloatCoefficients(surpluses.getStrip(0), surpluses.getTotalEntries()), y);
+}
+template<typename T> void GridSequence::evaluateBatchBlocks(const double x[], int num_x, const T coefficients[], T y[]) const{
+    // the basis functions are always computed in double precision, only the accumulation uses type T
+    int num_points = points.getNumIndexes();
     Utils::Wrapper2D<double const> xwrap(num_dimensions, x);
-    Utils::Wrapper2D<double> ywrap(num_outputs, y);
+    Utils::Wrapper2D<T const> swrap(num_outputs, coefficients);
+    Utils::Wrapper2D<T> ywrap(num_outputs, y);
+    int num_blocks = num_x / batch_block_size + ((num_x % batch_block_size == 0) ? 0 : 1);
     #pragma omp parallel for
-    for(int i=0; i<num_x; i++)
-        evaluate(xwrap.getStrip(i), ywrap.getStrip(i));
+    for(int b=0; b<num_blocks; b++){
+        int block_start = b * batch_block_size;
+        int block_size = std::min(batch_block_size, num_x - block_start);
+
+        std::vector<std::vector<double>> cache;
+        cacheBasisValuesBatch<double>(block_size, xwrap.getStrip(block_start), cache);
+
+        T *yblock = ywrap.getStrip(block_start);
+        std::fill_n(yblock, Utils::size_mult(block_size, num_outputs), static_cast<T>(0.0));
+
+        // basis.getStrip(i) holds the values of the i-th basis function (in the current group of nodes) for all points in the block
+        Data2D<double> basis(block_size, batch_block_size);
+        for(int ibegin=0; ibegin<num_points; ibegin += batch_block_size){
+            int group_size = std::min(batch_block_size, num_points - ibegin);
+            for(int i=0; i<group_size; i++){
+                const int *p = points.getIndex(ibegin + i);
+                double *bv = basis.getStrip(i);
+                const double *c = &(cache[0][Utils::size_mult(p[0], block_size)]);
+                std::copy_n(c, block_size, bv);
+                for(int j=1; j<num_dimensions; j++){
+                    c = &(cache[j][Utils::size_mult(p[j], block_size)]);
+                    for(int t=0; t<block_size; t++) bv[t] *= c[t];
+                }
+            }
+
+            // small matrix-matrix product, y_block += basis^T * surpluses
+            for(int t=0; t<block_size; t++){
+                T *this_y = &(yblock[Utils::size_mult(t, num_outputs)]);
+                for(int i=0; i<group_size; i++){
+                    const T *s = swrap.getStrip(ibegin + i);
+                    T basis_value = static_cast<T>(basis.getStrip(i)[t]);
+                    for(int k=0; k<num_outputs; k++) this_y[k] += basis_value * s[k];
+                }
+            }
+        }
+    }
+}
+void GridSequence::evaluateBatchOutputs(const double x[], int num_x, const int outputs[], int num_selected, double y[]) const{
+    int num_points = points.getNumIndexes();
+    Utils::Wrapper2D<double const> xwrap(num_dimensions, x);
+    Utils::Wrapper2D<double> ywrap(num_selected, y);
+    int num_blocks = num_x / batch_block_size + ((num_x % batch_block_size == 0) ? 0 : 1);
+    #pragma omp parallel for
+    for(int b=0; b<num_blocks; b++){
+        int block_start = b * batch_block_size;
+        int block_size = std::min(batch_block_size, num_x - block_start);
+
+        std::vector<std::vector<double>> cache;
+        cacheBasisValuesBatch<double>(block_size, xwrap.getStrip(block_start), cache);
+
+        double *yblock = ywrap.getStrip(block_start);
+        std::fill_n(yblock, Utils::size_mult(block_size, num_selected), 0.0);
+
+        // same as evaluateBatch(), but the selected surpluses of the group are gathered into a contiguous block first
+        Data2D<double> basis(block_size, batch_block_size);
+        Data2D<double> selected(num_selected, batch_block_size);
+        for(int ibegin=0; ibegin<num_points; ibegin += batch_block_size){
+            int group_size = std::min(batch_block_size, num_points - ibegin);
+            for(int i=0; i<group_size; i++){
+                const int *p = points.getIndex(ibegin + i);
+                double *bv = basis.getStrip(i);
+                const double *c = &(cache[0][Utils::size_mult(p[0], block_size)]);
+                std::copy_n(c, block_size, bv);
+                for(int j=1; j<num_dimensions; j++){
+                    c = &(cache[j][Utils::size_mult(p[j], block_size)]);
+                    for(int t=0; t<block_size; t++) bv[t] *= c[t];
+                }
+                const double *s = surpluses.getStrip(ibegin + i);
+                double *sel = selected.getStrip(i);
+                for(int k=0; k<num_selected; k++) sel[k] = s[outputs[k]];
+            }
+
+            for(int t=0; t<block_size; t++){
+                double *this_y = &(yblock[Utils::size_mult(t, num_selected)]);
+                for(int i=0; i<group_size; i++){
+                    const double *s = selected.getStrip(i);
+                    double basis_value = basis.getStrip(i)[t];
+                    for(int k=0; k<num_selected; k++) this_y[k] += basis_value * s[k];
+                }
+            }
+        }
+    }
 }
 
 #ifdef Tasmanian_ENABLE_BLAS
@@ -486,6 +627,13 @@ void GridSequence::evaluateBlas(const double x[], int num_x, double y[]) const{
     }
     TasBLAS::denseMultiply(num_outputs, num_x, num_points, 1.0, surpluses.getStrip(0), weights.getStrip(0), 0.0, y);
 }
+void GridSequence::evaluateBlas(const double x[], int num_x, float y[]) const{
+    int num_points = points.getNumIndexes();
+    Data2D<double> weights; weights.resize(num_points, num_x);
+    evaluateHierarchicalFunctions(x, num_x, weights.getStrip(0));
+    std::vector<float> fweights(weights.getVector().begin(), weights.getVector().end());
+    TasBLAS::denseMultiply(num_outputs, num_x, num_points, 1.0f, getFloatCoefficients(surpluses.getStrip(0), surpluses.getTotalEntries()), fweights.data(), 0.0f, y);
+}
 #endif // Tasmanian_ENABLE_BLAS
 
 #ifdef Tasmanian_ENABLE_CUDA
@@ -535,8 +683,7 @@ void GridSequence::integrate(double q[], double *conformal_correction) const{
             }
         }
     }else{
-        std::vector<double> w(num_points);
-        getQuadratureWeights(w.data());
+        std::vector<double> w = getCachedQuadratureWeights();
         for(int i=0; i<num_points; i++){
             w[i] *= conformal_correction[i];
             const double *vals = values.getValues(i);
@@ -775,7 +922,8 @@ void GridSequence::setSurplusRefinement(double tolerance, int output, const std:
 
 std::vector<int> GridSequence::getPolynomialSpace(bool interpolation) const{
     if (interpolation){
-        return (points.empty()) ? needed.getVector() : points.getVector(); // copy
+        MultiIndexSet const &set = (points.empty()) ? needed : points;
+        return std::vector<int>(set.getIndex(0), set.getIndex(set.getNumIndexes())); // copy
     }else{
         MultiIndexSet polynomial_set = MultiIndexManipulations::createPolynomialSpace(
             (points.empty()) ? needed : points,
@@ -784,7 +932,7 @@ std::vector<int> GridSequence::getPolynomialSpace(bool interpolation) const{
     }
 }
 const double* GridSequence::getSurpluses() const{
-    return surpluses.getVector().data();
+    return surpluses.getStrip(0);
 }
 
 void GridSequence::prepareSequence(int num_external){
@@ -876,49 +1024,117 @@ void GridSequence::recomputeSurpluses(){
 
     Data2D<int> parents = MultiIndexManipulations::computeDAGup(points);
 
-    std::vector<std::vector<int>> indexses_for_levels((size_t) top_level+1);
-    for(int i=0; i<num_points; i++)
-        if (level[i] > 0) indexses_for_levels[level[i]].push_back(i);
+    updateSurpluses(top_level, level, parents);
+}
 
-    for(int l=1; l<=top_level; l++){
-        int level_size = (int) indexses_for_levels[l].size();
-        #pragma omp parallel for schedule(dynamic)
-        for(int s=0; s<level_size; s++){
-            int i = indexses_for_levels[l][s];
+void GridSequence::updateSurplusesIncremental(MultiIndexSet const &new_points, Data2D<double> const &old_surpluses){
+    int num_points = points.getNumIndexes();
+    std::vector<bool> is_new((size_t) num_points);
+    for(int i=0; i<num_points; i++) is_new[i] = (new_points.getSlot(points.getIndex(i)) != -1);
 
-            const int* p = points.getIndex(i);
-            double *surpi = surpluses.getStrip(i);
+    Data2D<int> parents = MultiIndexManipulations::computeDAGup(points);
+
+    for(int i=0; i<num_points; i++){
+        if (!is_new[i]){
+            int const *p = parents.getStrip(i);
+            if (std::any_of(p, p + num_dimensions, [&](int k)->bool{ return ((k != -1) && is_new[k]); })){
+                recomputeSurpluses(); // the old points do not form a lower set, the new points change the old surpluses
+                return;
+            }
+        }
+    }
+
+    std::vector<int> level = MultiIndexManipulations::computeLevels(points);
+    int top_level = *std::max_element(level.begin(), level.end());
+
+    surpluses.resize(num_outputs, num_points);
+    int iold = 0;
+    for(int i=0; i<num_points; i++){
+        if (is_new[i]){
+            std::copy_n(values.getValues(i), num_outputs, surpluses.getStrip(i));
+        }else{
+            std::copy_n(old_surpluses.getStrip(iold++), num_outputs, surpluses.getStrip(i));
+            level[i] = 0; // the surpluses of the existing points are final
+        }
+    }
 
-            std::vector<int> monkey_count(top_level + 1);
-            std::vector<int> monkey_tail(top_level + 1);
-            std::vector<bool> used(num_points, false);
+    updateSurpluses(top_level, level, parents);
+}
 
-            int current = 0;
+void GridSequence::updateSurpluses(int top_level, std::vector<int> const &level, Data2D<int> const &parents){
+    int num_points = points.getNumIndexes();
 
-            monkey_count[0] = 0;
-            monkey_tail[0] = i;
+    std::vector<std::vector<int>> indexses_for_levels((size_t) top_level+1);
+    for(int i=0; i<num_points; i++)
+        if (level[i] > 0) indexses_for_levels[level[i]].push_back(i);
 
-            while(monkey_count[0] < num_dimensions){
-                if (monkey_count[current] < num_dimensions){
-                    int branch = parents.getStrip(monkey_tail[current])[monkey_count[current]];
-                    if ((branch == -1) || (used[branch])){
-                        monkey_count[current]++;
-                    }else{
-                        const double *branch_surp = surpluses.getStrip(branch);;
-                        double basis_value = evalBasis(points.getIndex(branch), p);
-                        for(int k=0; k<num_outputs; k++){
-                                surpi[k] -= basis_value * branch_surp[k];
-                        }
-                        used[branch] = true;
+    // subtracts the contribution of all ancestors of point i using the workspace of the calling thread
+    auto update_point = [&](int i, Utils::VisitedSet &used, std::vector<int> &monkey_count, std::vector<int> &monkey_tail)->void{
+        const int* p = points.getIndex(i);
+        double *surpi = surpluses.getStrip(i);
 
-                        monkey_count[++current] = 0;
-                        monkey_tail[current] = branch;
-                    }
+        used.clear();
+        int current = 0;
+
+        monkey_count[0] = 0;
+        monkey_tail[0] = i;
+
+        while(monkey_count[0] < num_dimensions){
+            if (monkey_count[current] < num_dimensions){
+                int branch = parents.getStrip(monkey_tail[current])[monkey_count[current]];
+                if ((branch == -1) || !used.insert(branch)){
+                    monkey_count[current]++;
                 }else{
-                    monkey_count[--current]++;
+                    const double *branch_surp = surpluses.getStrip(branch);
+                    double basis_value = evalBasis(points.getIndex(branch), p);
+                    for(int k=0; k<num_outputs; k++)
+                        surpi[k] -= basis_value * branch_surp[k];
+
+                    monkey_count[++current] = 0;
+                    monkey_tail[current] = branch;
                 }
+            }else{
+                monkey_count[--current]++;
             }
         }
+    };
+
+    if (executor){
+        struct SurplusWorkspace{
+            SurplusWorkspace() : used(0){}
+            Utils::VisitedSet used;
+            std::vector<int> monkey_count, monkey_tail;
+        };
+        Utils::WorkspacePool<SurplusWorkspace> task_workspaces; // one workspace per concurrent task, reused by the following tasks
+        for(int l=1; l<=top_level; l++){
+            int level_size = (int) indexses_for_levels[l].size();
+            Utils::runExecutorTasks(executor, (level_size + 31) / 32, [&](int task)->void{
+                auto workspace = task_workspaces.acquire();
+                if (workspace->used.getSize() != num_points){ // new workspace
+                    workspace->used = Utils::VisitedSet(num_points);
+                    workspace->monkey_count.resize((size_t) top_level + 1);
+                    workspace->monkey_tail.resize((size_t) top_level + 1);
+                }
+                for(int s = 32 * task; s < std::min(32 * (task + 1), level_size); s++)
+                    update_point(indexses_for_levels[l][s], workspace->used, workspace->monkey_count, workspace->monkey_tail);
+            });
+        }
+        return;
+    }
+
+    #pragma omp parallel
+    {
+        // see GridLocalPolynomial::updateSurpluses(), the workspace is allocated once per thread
+        Utils::VisitedSet used(num_points);
+        std::vector<int> monkey_count(top_level + 1);
+        std::vector<int> monkey_tail(top_level + 1);
+
+        for(int l=1; l<=top_level; l++){
+            int level_size = (int) indexses_for_levels[l].size();
+            #pragma omp for schedule(dynamic, 32)
+            for(int s=0; s<level_size; s++)
+                update_point(indexses_for_levels[l][s], used, monkey_count, monkey_tail);
+        }
     }
 }
 
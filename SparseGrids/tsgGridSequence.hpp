@@ -48,6 +48,8 @@ public:
 
     template<bool iomode> void write(std::ostream &os) const;
     template<bool iomode> void read(std::istream &is);
+    void writeSections(IO::SectionWriter &sections) const; // binary container format, see TasmanianSparseGrid::writeBinary()
+    void readSections(IO::SectionReader &sections);
 
     void makeGrid(int cnum_dimensions, int cnum_outputs, int depth, TypeDepth type, TypeOneDRule crule, const std::vector<int> &anisotropic_weights, const std::vector<int> &level_limits);
     void copyGrid(const GridSequence *seq, int ibegin, int iend);
@@ -71,9 +73,12 @@ public:
     void integrate(double q[], double *conformal_correction) const;
 
     void evaluateBatch(const double x[], int num_x, double y[]) const;
+    void evaluateBatchOutputs(const double x[], int num_x, const int outputs[], int num_selected, double y[]) const; // computes only the selected outputs
+    void evaluateBatch(const double x[], int num_x, float y[]) const; // single precision
 
     #ifdef Tasmanian_ENABLE_BLAS
     void evaluateBlas(const double x[], int num_x, double y[]) const;
+    void evaluateBlas(const double x[], int num_x, float y[]) const;
     #endif
 
     #ifdef Tasmanian_ENABLE_CUDA
@@ -114,17 +119,27 @@ public:
     void clearAccelerationData();
 
 protected:
+    template<typename T> void evaluateBatchBlocks(const double x[], int num_x, const T coefficients[], T y[]) const; // evaluateBatch() in double or float
+
     void reset();
 
     void evalHierarchicalFunctions(const double x[], double fvalues[]) const;
 
+    static constexpr int batch_block_size = 64; // number of points processed together by the evaluate kernels
+
     //! \brief Cache the nodes and polynomial coefficients, cache is determined by the largest index in \b points and \b needed, or \b num_external (pass zero if not using dy-construction).
     void prepareSequence(int num_external);
     std::vector<double> cacheBasisIntegrals() const;
 
     template<typename T>
     std::vector<std::vector<T>> cacheBasisValues(const T x[]) const{
-        std::vector<std::vector<T>> cache(num_dimensions);
+        std::vector<std::vector<T>> cache;
+        cacheBasisValues(x, cache);
+        return cache;
+    }
+    template<typename T>
+    void cacheBasisValues(const T x[], std::vector<std::vector<T>> &cache) const{ // overwrites the cache, reuses the existing memory
+        cache.resize(num_dimensions);
         for(int j=0; j<num_dimensions; j++){
             cache[j].resize(max_levels[j] + 1);
             T b = 1.0;
@@ -138,13 +153,39 @@ protected:
                 cache[j][i] /= coeff[i];
             }
         }
-        return cache;
+    }
+
+    // same as cacheBasisValues() but for a block of points, cache[j] holds max_levels[j]+1 strips with size num_x (dimension-major)
+    template<typename T>
+    void cacheBasisValuesBatch(int num_x, const T x[], std::vector<std::vector<T>> &cache) const{
+        cache.resize(num_dimensions);
+        for(int j=0; j<num_dimensions; j++){
+            cache[j].resize(Utils::size_mult(max_levels[j] + 1, num_x));
+            Utils::Wrapper2D<T> cwrap(num_x, cache[j].data());
+            T *c = cwrap.getStrip(0);
+            for(int b=0; b<num_x; b++) c[b] = 1.0;
+            for(int i=0; i<max_levels[j]; i++){
+                const T *prev = cwrap.getStrip(i);
+                T *next = cwrap.getStrip(i+1);
+                T node = nodes[i];
+                for(int b=0; b<num_x; b++) next[b] = prev[b] * (x[Utils::size_mult(b, num_dimensions) + j] - node);
+            }
+            for(int i=1; i<=max_levels[j]; i++){
+                T *strip = cwrap.getStrip(i);
+                T scale = coeff[i];
+                for(int b=0; b<num_x; b++) strip[b] /= scale;
+            }
+        }
     }
 
     std::vector<int> getMultiIndex(const double x[]);
     void expandGrid(const std::vector<int> &point, const std::vector<double> &values, const std::vector<double> &surplus);
     void loadConstructedPoints();
     void recomputeSurpluses();
+    //! \brief Computes only the surpluses of the \b new_points that have been merged into \b points, see GridLocalPolynomial::updateSurplusesIncremental().
+    void updateSurplusesIncremental(MultiIndexSet const &new_points, Data2D<double> const &old_surpluses);
+    //! \brief Computes the surpluses of the points with non-zero \b level, assumes the surpluses of the ancestors are final.
+    void updateSurpluses(int top_level, std::vector<int> const &level, Data2D<int> const &parents);
     void applyTransformationTransposed(double weights[]) const;
 
     double evalBasis(const int f[], const int p[]) const; // evaluate function corresponding to f at p
@@ -180,7 +221,7 @@ protected:
     }
     void loadCudaSurpluses() const{
         if (!cuda_cache) cuda_cache = std::unique_ptr<CudaSequenceData<double>>(new CudaSequenceData<double>);
-        if (cuda_cache->surpluses.empty()) cuda_cache->surpluses.load(surpluses.getVector());
+        if (cuda_cache->surpluses.empty()) cuda_cache->surpluses.load(surpluses.getTotalEntries(), surpluses.getStrip(0));
     }
     void clearCudaSurpluses(){ if (cuda_cache) cuda_cache->surpluses.clear(); }
     #endif
@@ -196,6 +237,8 @@ private:
 
     std::unique_ptr<SimpleConstructData> dynamic_values;
 
+    Utils::WorkspacePool<std::vector<std::vector<double>>> workspaces; // basis cache reused by the single point evaluate()
+
     #ifdef Tasmanian_ENABLE_CUDA
     mutable std::unique_ptr<CudaSequenceData<double>> cuda_cache;
     #endif
@@ -56,14 +56,14 @@ template<bool iomode> void GridWavelet::write(std::ostream &os) const{
     if (!points.empty()) points.write<iomode>(os);
     if (iomode == mode_ascii){ // backwards compatible: surpluses and needed, or needed and surpluses
         IO::writeFlag<iomode, IO::pad_auto>((coefficients.getNumStrips() != 0), os);
-        if (coefficients.getNumStrips() != 0) IO::writeVector<iomode, IO::pad_line>(coefficients.getVector(), os);
+        if (coefficients.getNumStrips() != 0) IO::writeVector<iomode, IO::pad_line>(coefficients.getStrip(0), coefficients.getTotalEntries(), os);
         IO::writeFlag<iomode, IO::pad_auto>(!needed.empty(), os);
         if (!needed.empty()) needed.write<iomode>(os);
     }else{
         IO::writeFlag<iomode, IO::pad_auto>(!needed.empty(), os);
         if (!needed.empty()) needed.write<iomode>(os);
         IO::writeFlag<iomode, IO::pad_auto>((coefficients.getNumStrips() != 0), os);
-        if (coefficients.getNumStrips() != 0) IO::writeVector<iomode, IO::pad_line>(coefficients.getVector(), os);
+        if (coefficients.getNumStrips() != 0) IO::writeVector<iomode, IO::pad_line>(coefficients.getStrip(0), coefficients.getTotalEntries(), os);
     }
 
     if (num_outputs > 0) values.write<iomode>(os);
@@ -95,6 +95,31 @@ template void GridWavelet::write<mode_binary>(std::ostream &) const;
 template void GridWavelet::read<mode_ascii>(std::istream &);
 template void GridWavelet::read<mode_binary>(std::istream &);
 
+void GridWavelet::writeSections(IO::SectionWriter &sections) const{
+    IO::writeNumbers<mode_binary, IO::pad_none>(sections.addSection("grid"), num_dimensions, num_outputs, order);
+
+    if (!points.empty()) points.write<mode_binary>(sections.addSection("points"));
+    if (!needed.empty()) needed.write<mode_binary>(sections.addSection("needed"));
+    if (coefficients.getNumStrips() != 0) IO::writeVector<mode_binary, IO::pad_none>(coefficients.getStrip(0), coefficients.getTotalEntries(), sections.addSection("surplus"));
+    if (num_outputs > 0) values.writeSection(sections.addSection("values"));
+}
+void GridWavelet::readSections(IO::SectionReader &sections){
+    reset();
+    std::istream &is = sections.getSection("grid");
+    num_dimensions = IO::readNumber<mode_binary, int>(is);
+    num_outputs = IO::readNumber<mode_binary, int>(is);
+    order = IO::readNumber<mode_binary, int>(is);
+    rule1D.updateOrder(order);
+
+    if (sections.hasSection("points")) points.read(sections, "points");
+    if (sections.hasSection("needed")) needed.read(sections, "needed");
+    if (sections.hasSection("surplus"))
+        coefficients = IO::readData2D<double>(sections, "surplus", num_outputs, points.getNumIndexes());
+    if (num_outputs > 0) values.read(sections, "values");
+
+    buildInterpolationMatrix();
+}
+
 void GridWavelet::makeGrid(int cnum_dimensions, int cnum_outputs, int depth, int corder, const std::vector<int> &level_limits){
     reset();
     num_dimensions = cnum_dimensions;
@@ -257,6 +282,44 @@ void GridWavelet::evaluateBatch(const double x[], int num_x, double y[]) const{
     for(int i=0; i<num_x; i++)
         evaluate(xwrap.getStrip(i), ywrap.getStrip(i));
 }
+void GridWavelet::evaluateBatch(const double x[], int num_x, float y[]) const{
+    Utils::Wrapper2D<double const> xwrap(num_dimensions, x);
+    Utils::Wrapper2D<float> ywrap(num_outputs, y);
+    Utils::Wrapper2D<float const> cwrap(num_outputs, getFloatCoefficients(coefficients.getStrip(0), coefficients.getTotalEntries()));
+    int num_points = points.getNumIndexes();
+    #pragma omp parallel for
+    for(int i=0; i<num_x; i++){
+        const double *this_x = xwrap.getStrip(i);
+        float *this_y = ywrap.getStrip(i);
+        std::fill_n(this_y, num_outputs, 0.0f);
+        for(int j=0; j<num_points; j++){
+            double basis_value = evalBasis(points.getIndex(j), this_x);
+            if (basis_value != 0.0){
+                const float *c = cwrap.getStrip(j);
+                float fbasis = (float) basis_value;
+                for(int k=0; k<num_outputs; k++) this_y[k] += fbasis * c[k];
+            }
+        }
+    }
+}
+void GridWavelet::evaluateBatchOutputs(const double x[], int num_x, const int outputs[], int num_selected, double y[]) const{
+    Utils::Wrapper2D<double const> xwrap(num_dimensions, x);
+    Utils::Wrapper2D<double> ywrap(num_selected, y);
+    int num_points = points.getNumIndexes();
+    #pragma omp parallel for
+    for(int i=0; i<num_x; i++){
+        const double *this_x = xwrap.getStrip(i);
+        double *this_y = ywrap.getStrip(i);
+        std::fill_n(this_y, num_selected, 0.0);
+        for(int j=0; j<num_points; j++){
+            double basis_value = evalBasis(points.getIndex(j), this_x);
+            if (basis_value != 0.0){ // wavelets have local support, most basis functions are zero
+                const double *s = coefficients.getStrip(j);
+                for(int k=0; k<num_selected; k++) this_y[k] += basis_value * s[outputs[k]];
+            }
+        }
+    }
+}
 
 #ifdef Tasmanian_ENABLE_BLAS
 void GridWavelet::evaluateBlas(const double x[], int num_x, double y[]) const{
@@ -265,6 +328,13 @@ void GridWavelet::evaluateBlas(const double x[], int num_x, double y[]) const{
     evaluateHierarchicalFunctions(x, num_x, weights.getStrip(0));
     TasBLAS::denseMultiply(num_outputs, num_x, num_points, 1.0, coefficients.getStrip(0), weights.getStrip(0), 0.0, y);
 }
+void GridWavelet::evaluateBlas(const double x[], int num_x, float y[]) const{
+    int num_points = points.getNumIndexes();
+    Data2D<double> weights(num_points, num_x);
+    evaluateHierarchicalFunctions(x, num_x, weights.getStrip(0));
+    std::vector<float> fweights(weights.getVector().begin(), weights.getVector().end());
+    TasBLAS::denseMultiply(num_outputs, num_x, num_points, 1.0f, getFloatCoefficients(coefficients.getStrip(0), coefficients.getTotalEntries()), fweights.data(), 0.0f, y);
+}
 #endif
 
 #ifdef Tasmanian_ENABLE_CUDA
@@ -332,8 +402,9 @@ void GridWavelet::integrate(double q[], double *conformal_correction) const{
 
     if (conformal_correction == 0){
         std::fill_n(q, num_outputs, 0.0);
+        std::vector<double> const &integrals = getCachedHierarchicalIntegrals();
         for(int i=0; i<num_points; i++){
-            double basis_integrals = evalIntegral(points.getIndex(i));
+            double basis_integrals = integrals[i];
             const double *coeff = coefficients.getStrip(i);
             for(int j=0; j<num_outputs; j++)
                 q[j] += basis_integrals * coeff[j];
@@ -341,8 +412,7 @@ void GridWavelet::integrate(double q[], double *conformal_correction) const{
 
     }else{
         std::fill(q, q + num_outputs, 0.0);
-        std::vector<double> w(num_points);
-        getQuadratureWeights(w.data());
+        std::vector<double> w = getCachedQuadratureWeights();
         for(int i=0; i<num_points; i++){
             w[i] *= conformal_correction[i];
             const double *vals = values.getValues(i);
@@ -373,12 +443,53 @@ double GridWavelet::evalIntegral(const int p[]) const{
 }
 
 void GridWavelet::buildInterpolationMatrix(){
-    // updated code, using better parallelism
-    // Wavelets don't have a nice rule of support to use monkeys and graphs (or I cannot find the support rule)
+    // the wavelets have compact support, for each 1D node find the 1D wavelets that are non-zero at the node
+    // then the non-zeros in each row are the multi-indexes formed by the 1D lists that are present in the grid
     MultiIndexSet &work = (points.empty()) ? needed : points;
     inter_matrix = TasSparse::SparseMatrix();
 
     int num_points = work.getNumIndexes();
+    if (num_points == 0) return;
+
+    int max_index = *std::max_element(work.getVector().begin(), work.getVector().end());
+    int max_level = rule1D.getLevel(max_index);
+
+    std::vector<double> support_lower((size_t) max_index + 1), support_upper((size_t) max_index + 1);
+    std::vector<std::vector<int>> level_wavelets((size_t) max_level + 1);
+    std::vector<double> level_width((size_t) max_level + 1, 0.0);
+    for(int w=0; w<=max_index; w++){
+        rule1D.getSupport(w, support_lower[w], support_upper[w]);
+        int l = rule1D.getLevel(w);
+        level_wavelets[l].push_back(w);
+        level_width[l] = std::max(level_width[l], support_upper[w] - support_lower[w]);
+    }
+    for(auto &wavelets : level_wavelets)
+        std::sort(wavelets.begin(), wavelets.end(), [&](int a, int b)->bool{ return (support_lower[a] < support_lower[b]); });
+
+    std::vector<std::vector<int>> indx1d((size_t) max_index + 1);
+    std::vector<std::vector<double>> vals1d((size_t) max_index + 1);
+    #pragma omp parallel for
+    for(int i=0; i<=max_index; i++){
+        double x = rule1D.getNode(i);
+        std::vector<int> candidates;
+        for(int l=0; l<=max_level; l++){ // on each level, only the wavelets with left end of the support in [x - width, x] can be non-zero
+            auto const &wavelets = level_wavelets[l];
+            auto iw = std::lower_bound(wavelets.begin(), wavelets.end(), x - level_width[l],
+                                       [&](int w, double v)->bool{ return (support_lower[w] < v); });
+            while((iw != wavelets.end()) && (support_lower[*iw] <= x)){
+                if (support_upper[*iw] >= x) candidates.push_back(*iw);
+                iw++;
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        for(auto w : candidates){
+            double v = rule1D.eval(w, x);
+            if (v != 0.0){
+                indx1d[i].push_back(w);
+                vals1d[i].push_back(v);
+            }
+        }
+    }
 
     int num_chunk = 32;
     int num_blocks = num_points / num_chunk + ((num_points % num_chunk == 0) ? 0 : 1);
@@ -387,33 +498,71 @@ void GridWavelet::buildInterpolationMatrix(){
     std::vector<std::vector<double>> vals(num_blocks);
     std::vector<int> pntr(num_points);
 
+    // in lexicographical order, the multi-indexes sharing the first j entries form a contiguous range
+    // and within the range the (j+1)-st entries are sorted, the search walks the ranges dimension by dimension
+    // (the sets used in the direction selective refinement are not sorted, hence the explicit order)
+    std::vector<int> lex_order((size_t) num_points);
+    std::iota(lex_order.begin(), lex_order.end(), 0);
+    std::sort(lex_order.begin(), lex_order.end(), [&](int a, int b)->bool{
+        return std::lexicographical_compare(work.getIndex(a), work.getIndex(a) + num_dimensions, work.getIndex(b), work.getIndex(b) + num_dimensions);
+    });
+    auto range_begin = [&](int ibegin, int iend, int j, int w)->int{
+        while(ibegin < iend){
+            int m = (ibegin + iend) / 2;
+            if (work.getIndex(lex_order[m])[j] < w) ibegin = m + 1; else iend = m;
+        }
+        return ibegin;
+    };
+    auto range_end = [&](int ibegin, int iend, int j, int w)->int{
+        while(ibegin < iend){
+            int m = (ibegin + iend) / 2;
+            if (work.getIndex(lex_order[m])[j] <= w) ibegin = m + 1; else iend = m;
+        }
+        return ibegin;
+    };
+
     #pragma omp parallel for
     for(int b=0; b<num_blocks; b++){
+        std::vector<int> rbegin(num_dimensions + 1), rend(num_dimensions + 1), candidate(num_dimensions);
+        std::vector<double> partial(num_dimensions + 1);
+        std::vector<std::pair<int, double>> row;
         int block_end = (b < num_blocks - 1) ? (b+1) * num_chunk : num_points;
         for(int i=b * num_chunk; i < block_end; i++){
             const int *p = work.getIndex(i);
-            std::vector<double> xi(num_dimensions);
-            for(int j = 0; j<num_dimensions; j++) // get the node
-                xi[j] = rule1D.getNode(p[j]);
-
-            // loop over the basis functions to see if supported
-            int numpntr = 0;
-            for(int wi=0; wi<num_points; wi++){
-                const int *w = work.getIndex(wi);
-
-                double v = 1.0;
-                for(int j=0; j<num_dimensions; j++){
-                    v *= rule1D.eval(w[j], xi[j]);
-                    if (v == 0.0) break; // evaluating the wavelets is expensive, stop if any one of them is zero
-                }
 
-                if(v != 0.0){ // testing != is safe since it can only happen in multiplication by 0.0
-                    indx[b].push_back(wi);
-                    vals[b].push_back(v);
-                    numpntr++;
+            row.clear();
+            int j = 0;
+            rbegin[0] = 0;
+            rend[0] = num_points;
+            partial[0] = 1.0;
+            candidate[0] = 0;
+            while(j >= 0){
+                if (candidate[j] >= (int) indx1d[p[j]].size()){ // exhausted the wavelets in direction j
+                    if (--j >= 0) candidate[j]++;
+                    continue;
                 }
+                int w = indx1d[p[j]][candidate[j]];
+                int first = range_begin(rbegin[j], rend[j], j, w);
+                int last  = range_end(first, rend[j], j, w);
+                if (first == last){
+                    candidate[j]++;
+                }else if (j == num_dimensions - 1){
+                    row.emplace_back(lex_order[first], partial[j] * vals1d[p[j]][candidate[j]]);
+                    candidate[j]++;
+                }else{
+                    partial[j+1] = partial[j] * vals1d[p[j]][candidate[j]];
+                    rbegin[j+1] = first;
+                    rend[j+1] = last;
+                    candidate[++j] = 0;
+                }
+            }
+
+            std::sort(row.begin(), row.end(), [](std::pair<int, double> const &x, std::pair<int, double> const &y)->bool{ return (x.first < y.first); });
+            for(auto const &r : row){
+                indx[b].push_back(r.first);
+                vals[b].push_back(r.second);
             }
-            pntr[i] = numpntr;
+            pntr[i] = (int) row.size();
         }
     }
 
@@ -429,26 +578,7 @@ void GridWavelet::recomputeCoefficients(){
 
     if (inter_matrix.getNumRows() != num_points) buildInterpolationMatrix();
 
-    std::vector<double> b(num_points), x(num_points);
-
-    for(int output = 0; output < num_outputs; output++){
-        // Copy relevant portion
-        std::fill(x.begin(), x.end(), 0.0);
-        std::fill(b.begin(), b.end(), 0.0);
-
-        // Populate RHS
-        for(int i = 0; i < num_points; i++){
-            b[i] = values.getValues(i)[output];
-        }
-
-        // Solve system
-        inter_matrix.solve(b.data(), x.data());
-
-        // Populate surplus
-        for(int i = 0; i < num_points; i++){
-            coefficients.getStrip(i)[output] = x[i];
-        }
-    }
+    inter_matrix.solve(num_outputs, values.getVector().data(), coefficients.getVector().data()); // all outputs at once
 }
 
 void GridWavelet::solveTransposed(double w[]) const{
@@ -48,6 +48,8 @@ public:
 
     template<bool iomode> void write(std::ostream &os) const;
     template<bool iomode> void read(std::istream &is);
+    void writeSections(IO::SectionWriter &sections) const; // binary container format, see TasmanianSparseGrid::writeBinary()
+    void readSections(IO::SectionReader &sections);
 
     void makeGrid(int cnum_dimensions, int cnum_outputs, int depth, int corder, const std::vector<int> &level_limits);
     void copyGrid(const GridWavelet *wav, int ibegin, int iend);
@@ -69,9 +71,12 @@ public:
     void integrate(double q[], double *conformal_correction) const;
 
     void evaluateBatch(const double x[], int num_x, double y[]) const;
+    void evaluateBatchOutputs(const double x[], int num_x, const int outputs[], int num_selected, double y[]) const; // computes only the selected outputs
+    void evaluateBatch(const double x[], int num_x, float y[]) const; // single precision
 
     #ifdef Tasmanian_ENABLE_BLAS
     void evaluateBlas(const double x[], int num_x, double y[]) const;
+    void evaluateBlas(const double x[], int num_x, float y[]) const;
     #endif
 
     #ifdef Tasmanian_ENABLE_CUDA
@@ -125,7 +130,7 @@ protected:
     #ifdef Tasmanian_ENABLE_CUDA
     void loadCudaCoefficients() const{
         if (!cuda_cache) cuda_cache = std::unique_ptr<CudaWaveletData<double>>(new CudaWaveletData<double>);
-        if (cuda_cache->coefficients.empty()) cuda_cache->coefficients.load(coefficients.getVector());
+        if (cuda_cache->coefficients.empty()) cuda_cache->coefficients.load(coefficients.getTotalEntries(), coefficients.getStrip(0));
     }
     void clearCudaCoefficients(){ if (cuda_cache) cuda_cache->coefficients.clear(); }
     void loadCudaBasis() const;
@@ -50,6 +50,8 @@ namespace TasGrid{
 // Skip the definitions from Doxygen, this serves as a mock-up header for the BLAS API.
 extern "C" void dgemv_(const char *transa, const int *M, const int *N, const double *alpha, const double *A, const int *lda, const double *x, const int *incx, const double *beta, const double *y, const int *incy);
 extern "C" void dgemm_(const char* transa, const char* transb, const int *m, const int *n, const int *k, const double *alpha, const double *A, const int *lda, const double *B, const int *ldb, const double *beta, const double *C, const int *ldc);
+extern "C" void sgemv_(const char *transa, const int *M, const int *N, const float *alpha, const float *A, const int *lda, const float *x, const int *incx, const float *beta, const float *y, const int *incy);
+extern "C" void sgemm_(const char* transa, const char* transb, const int *m, const int *n, const int *k, const float *alpha, const float *A, const int *lda, const float *B, const int *ldb, const float *beta, const float *C, const int *ldc);
 #endif
 
 //! \internal
@@ -76,6 +78,22 @@ namespace TasBLAS{
             dgemv_(&charT, &K, &N, &alpha, B, &K, A, &blas_one, &beta, C, &blas_one);
         }
     }
+    //! \internal
+    //! \brief Single precision overload, switches between \b sgemm_ and \b sgemv_.
+    inline void denseMultiply(int M, int N, int K, float alpha, const float A[], const float B[], float beta, float C[]){
+        if (M > 1){
+            if (N > 1){ // matrix mode
+                char charN = 'N';
+                sgemm_(&charN, &charN, &M, &N, &K, &alpha, A, &M, B, &K, &beta, C, &M);
+            }else{ // matrix vector, A * v = C
+                char charN = 'N'; int blas_one = 1;
+                sgemv_(&charN, &M, &K, &alpha, A, &M, B, &blas_one, &beta, C, &blas_one);
+            }
+        }else{ // matrix vector B^T * v = C
+            char charT = 'T'; int blas_one = 1;
+            sgemv_(&charT, &K, &N, &alpha, B, &K, A, &blas_one, &beta, C, &blas_one);
+        }
+    }
 }
 #endif
 }
@@ -31,6 +31,12 @@
 #ifndef __TASMANIAN_IOHELPERS_HPP
 #define __TASMANIAN_IOHELPERS_HPP
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <sstream>
+
 #include "tsgEnumerates.hpp"
 
 /*!
@@ -319,25 +325,34 @@ bool readFlag(std::istream &os){
 
 /*!
  * \ingroup TasmanianIO
- * \brief Write the vector to the stream, the vector cannot be empty.
+ * \brief Write the array with \b num_entries to the stream, the array cannot be empty.
  */
 template<bool iomode, IOPad pad, typename VecType>
-void writeVector(const std::vector<VecType> &x, std::ostream &os){
+void writeVector(const VecType x[], size_t num_entries, std::ostream &os){
     if (iomode == mode_ascii){
         if (pad == pad_lspace)
-            for(auto i : x) os << " " << i;
+            for(size_t i = 0; i < num_entries; i++) os << " " << x[i];
         if (pad == pad_rspace)
-            for(auto i : x) os << i << " ";
+            for(size_t i = 0; i < num_entries; i++) os << x[i] << " ";
         if ((pad == pad_none) || (pad == pad_line)){
             os << x[0];
-            for(size_t i = 1; i < x.size(); i++) os << " " << x[i];
+            for(size_t i = 1; i < num_entries; i++) os << " " << x[i];
             if (pad == pad_line) os << std::endl;
         }
     }else{
-        os.write((char*) x.data(), x.size() * sizeof(VecType));
+        os.write((char*) x, num_entries * sizeof(VecType));
     }
 }
 
+/*!
+ * \ingroup TasmanianIO
+ * \brief Write the vector to the stream, the vector cannot be empty.
+ */
+template<bool iomode, IOPad pad, typename VecType>
+void writeVector(const std::vector<VecType> &x, std::ostream &os){
+    writeVector<iomode, pad>(x.data(), x.size(), os);
+}
+
 /*!
  * \ingroup TasmanianIO
  * \brief Read the vector from the stream.
@@ -405,6 +420,427 @@ TypeOneDRule readRule(std::istream &is){
     }
 }
 
+/*!
+ * \internal
+ * \ingroup TasmanianIO
+ * \brief Stream buffer that reads directly from existing memory, e.g., a memory mapped file.
+ *
+ * The std::istream::read() calls become a single std::memcpy from the memory,
+ * the data is never copied into an intermediate buffer.
+ * \endinternal
+ */
+class MemoryBuffer : public std::streambuf{
+public:
+    //! \brief Create an empty buffer, use reset() to assign the memory.
+    MemoryBuffer(){}
+    //! \brief Create a buffer spanning \b num_bytes starting at \b data.
+    MemoryBuffer(const char *data, size_t num_bytes){ reset(data, num_bytes); }
+    //! \brief Point the buffer to a new range of memory, the memory is only read.
+    void reset(const char *data, size_t num_bytes){
+        char *begin = const_cast<char*>(data);
+        setg(begin, begin, begin + num_bytes);
+    }
+    //! \brief Return the current read position.
+    const char* position() const{ return gptr(); }
+    //! \brief Return the number of bytes left to read.
+    size_t remaining() const{ return (size_t) (egptr() - gptr()); }
+    //! \brief Advance the read position by \b num_bytes, must not exceed remaining().
+    void skip(size_t num_bytes){ setg(eback(), gptr() + num_bytes, egptr()); }
+};
+
+/*!
+ * \internal
+ * \ingroup TasmanianIO
+ * \brief Alignment (in bytes) of the sections of the binary container format.
+ * \endinternal
+ */
+constexpr size_t container_alignment = 64;
+
+/*!
+ * \internal
+ * \ingroup TasmanianIO
+ * \brief Header of the binary container format, the first 64 bytes of the file.
+ *
+ * The header is followed by the directory, i.e., \b num_sections entries of type ContainerSection,
+ * and then by the payloads of the sections, each starting at an offset that is a multiple of
+ * container_alignment. The offsets are counted from the beginning of the header, thus
+ * the payloads of a memory mapped file are aligned in memory.
+ * \endinternal
+ */
+struct ContainerHeader{
+    //! \brief Marks Tasmanian binary files, the last character is the version of the format.
+    char magic[4];
+    //! \brief Type of the grid, uses the same characters as the stream format.
+    char grid_type;
+    //! \brief Reserved for future use, set to zero.
+    char reserved[3];
+    //! \brief Holds container_endian in the byte order of the machine that wrote the file.
+    uint32_t endian;
+    //! \brief Number of sections listed in the directory.
+    uint32_t num_sections;
+    //! \brief Total size of the container in bytes, including header, directory and padding.
+    uint64_t total_bytes;
+    //! \brief Checksum of the directory entries.
+    uint64_t directory_checksum;
+    //! \brief Pads the header to the alignment of the sections.
+    char padding[32];
+};
+static_assert(sizeof(ContainerHeader) == container_alignment, "The container header must have the size of the alignment");
+
+/*!
+ * \internal
+ * \ingroup TasmanianIO
+ * \brief Entry in the directory of the binary container format.
+ * \endinternal
+ */
+struct ContainerSection{
+    //! \brief Name of the section, null-padded up to 8 characters.
+    char tag[8];
+    //! \brief Offset of the payload from the beginning of the header.
+    uint64_t offset;
+    //! \brief Size of the payload in bytes.
+    uint64_t num_bytes;
+    //! \brief Checksum of the payload.
+    uint64_t checksum;
+};
+static_assert(sizeof(ContainerSection) == 32, "The container directory entries must not have padding");
+
+/*!
+ * \internal
+ * \ingroup TasmanianIO
+ * \brief Marker used to detect files written on a machine with different endians.
+ * \endinternal
+ */
+constexpr uint32_t container_endian = 0x01020304;
+
+/*!
+ * \internal
+ * \ingroup TasmanianIO
+ * \brief Incremental 64-bit checksum of a sequence of bytes, processes the data in 8-byte words.
+ *
+ * Each word is combined with the FNV-1a multiplier followed by an xor-shift, i.e., every step is a bijection
+ * and a single corrupt word always changes the result. The data can be given in chunks of any size,
+ * the result does not depend on the way the bytes are split between the calls to update().
+ * \endinternal
+ */
+class Checksum{
+public:
+    //! \brief Start an empty checksum.
+    Checksum() : hash(14695981039346656037ULL), num_bytes(0), num_tail(0){}
+
+    //! \brief Add \b count bytes to the checksum.
+    void update(const char *data, size_t count){
+        num_bytes += count;
+        if (num_tail > 0){ // complete the partial word from the previous call
+            size_t take = std::min(count, sizeof(uint64_t) - num_tail);
+            std::copy_n(data, take, tail + num_tail);
+            num_tail += take;
+            data += take;
+            count -= take;
+            if (num_tail < sizeof(uint64_t)) return; // all bytes went in the partial word
+            mix(hash, loadWord(tail, sizeof(uint64_t)));
+            num_tail = 0;
+        }
+        for(; count >= sizeof(uint64_t); count -= sizeof(uint64_t), data += sizeof(uint64_t))
+            mix(hash, loadWord(data, sizeof(uint64_t)));
+        std::copy_n(data, count, tail); // the partial word is empty at this point
+        num_tail = count;
+    }
+
+    //! \brief Returns the checksum of all bytes added so far.
+    uint64_t get() const{
+        uint64_t result = hash;
+        if (num_tail > 0) mix(result, loadWord(tail, num_tail));
+        mix(result, num_bytes);
+        return result;
+    }
+
+private:
+    //! \brief Combine the word with the hash.
+    static void mix(uint64_t &h, uint64_t word){
+        h = (h ^ word) * 1099511628211ULL;
+        h ^= (h >> 32);
+    }
+    //! \brief Load up to 8 bytes in a word, the missing bytes are zero.
+    static uint64_t loadWord(const char *data, size_t count){
+        uint64_t word = 0;
+        std::memcpy(&word, data, count);
+        return word;
+    }
+
+    uint64_t hash, num_bytes;
+    char tail[sizeof(uint64_t)];
+    size_t num_tail;
+};
+
+/*!
+ * \internal
+ * \ingroup TasmanianIO
+ * \brief Computes the checksum of \b num_bytes of \b data, see Checksum.
+ * \endinternal
+ */
+inline uint64_t checksum(const char *data, size_t num_bytes){
+    Checksum sum;
+    sum.update(data, num_bytes);
+    return sum.get();
+}
+
+/*!
+ * \internal
+ * \ingroup TasmanianIO
+ * \brief Stream buffer that forwards the output to another buffer and computes the checksum of the bytes.
+ * \endinternal
+ */
+class ChecksumBuffer : public std::streambuf{
+public:
+    //! \brief Create a buffer that does not write anything, use reset() to assign the destination.
+    ChecksumBuffer() : destination(nullptr), num_bytes(0){}
+    //! \brief Forward the output to \b buffer and restart the checksum and the byte count.
+    void reset(std::streambuf *buffer){
+        destination = buffer;
+        sum = Checksum();
+        num_bytes = 0;
+    }
+    //! \brief Returns the checksum of the bytes written since the last reset().
+    uint64_t getChecksum() const{ return sum.get(); }
+    //! \brief Returns the number of bytes written since the last reset().
+    uint64_t getNumBytes() const{ return num_bytes; }
+
+protected:
+    //! \brief Write a single character.
+    int_type overflow(int_type c) override{
+        if (traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+        char byte = traits_type::to_char_type(c);
+        return (xsputn(&byte, 1) == 1) ? c : traits_type::eof();
+    }
+    //! \brief Write a sequence of characters.
+    std::streamsize xsputn(const char *data, std::streamsize count) override{
+        std::streamsize written = destination->sputn(data, count);
+        sum.update(data, (size_t) written);
+        num_bytes += (uint64_t) written;
+        return written;
+    }
+
+private:
+    std::streambuf *destination;
+    Checksum sum;
+    uint64_t num_bytes;
+};
+
+/*!
+ * \internal
+ * \ingroup TasmanianIO
+ * \brief Writes named sections to a stream using the binary container format.
+ *
+ * The constructor reserves space for the header and the directory, the payload of each section
+ * is written directly to the destination through the stream returned by addSection()
+ * and finish() seeks back to fill the header and the directory.
+ * Thus, the sections are never buffered in memory. If the destination does not support seeking,
+ * e.g., a pipe, the container is assembled in memory and copied to the destination by finish().
+ * \endinternal
+ */
+class SectionWriter{
+public:
+    //! \brief Maximum number of sections in a container, determines the space reserved for the directory.
+    static constexpr size_t max_sections = 16;
+
+    //! \brief Start a container for a grid of the given type (see ContainerHeader::grid_type) that will be written to \b destination.
+    SectionWriter(std::ostream &destination, char type) : final_destination(destination), grid_type(type), section_open(false), section_stream(&section_buffer){
+        start = destination.tellp();
+        if (start == std::streampos(-1)){ // cannot seek, use a buffer
+            buffered = std::unique_ptr<std::stringstream>(new std::stringstream(std::ios::in | std::ios::out | std::ios::binary));
+            start = 0;
+        }
+        os = (buffered) ? buffered.get() : &destination;
+        position = alignOffset(sizeof(ContainerHeader) + max_sections * sizeof(ContainerSection));
+        pad(*os, position); // placeholder for the header and the directory
+    }
+
+    //! \brief Start a new section with the given \b tag (at most 8 characters), returns the stream that receives the payload.
+
+    //! The stream is valid until the next call to addSection() or finish().
+    std::ostream& addSection(const char *tag){
+        if (std::strlen(tag) > sizeof(ContainerSection::tag))
+            throw std::invalid_argument("ERROR: the tag of a container section must have at most 8 characters");
+        if (directory.size() == max_sections)
+            throw std::runtime_error("ERROR: too many sections in the binary container");
+        closeSection();
+        section_open = true;
+        directory.push_back(ContainerSection());
+        ContainerSection &section = directory.back();
+        std::memset(section.tag, 0, sizeof(section.tag));
+        std::memcpy(section.tag, tag, std::strlen(tag));
+        section.offset = position;
+        section_buffer.reset(os->rdbuf());
+        section_stream.clear();
+        return section_stream;
+    }
+
+    //! \brief Complete the container, writes the header and the directory.
+    void finish(){
+        closeSection();
+
+        ContainerHeader header;
+        std::memset(&header, 0, sizeof(ContainerHeader));
+        std::memcpy(header.magic, "TSG6", 4);
+        header.grid_type = grid_type;
+        header.endian = container_endian;
+        header.num_sections = (uint32_t) directory.size();
+        header.total_bytes = position;
+        header.directory_checksum = checksum(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(ContainerSection));
+
+        os->seekp(start);
+        os->write(reinterpret_cast<const char*>(&header), sizeof(ContainerHeader));
+        os->write(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(ContainerSection));
+        os->seekp(start + (std::streamoff) position);
+        if (buffered) final_destination << buffered->rdbuf();
+        if (!final_destination.good()) throw std::runtime_error("ERROR: failed to write the binary container");
+    }
+
+private:
+    //! \brief Complete the current section (if any) and pad the stream to the alignment of the next section.
+    void closeSection(){
+        if (!section_open) return;
+        section_open = false;
+        section_stream.flush();
+        directory.back().num_bytes = section_buffer.getNumBytes();
+        directory.back().checksum = section_buffer.getChecksum();
+        uint64_t next = alignOffset(position + directory.back().num_bytes);
+        pad(*os, next - position - directory.back().num_bytes);
+        position = next;
+    }
+    //! \brief Round the offset up to a multiple of container_alignment.
+    static uint64_t alignOffset(uint64_t offset){ return container_alignment * ((offset + container_alignment - 1) / container_alignment); }
+    //! \brief Write \b num_bytes zeros.
+    static void pad(std::ostream &stream, uint64_t num_bytes){
+        char zeros[container_alignment] = {0};
+        for(; num_bytes > container_alignment; num_bytes -= container_alignment)
+            stream.write(zeros, (std::streamsize) container_alignment);
+        stream.write(zeros, (std::streamsize) num_bytes);
+    }
+
+    std::ostream &final_destination;
+    std::unique_ptr<std::stringstream> buffered;
+    std::ostream *os;
+    std::streampos start;
+    uint64_t position; // offset of the next section, relative to start
+    char grid_type;
+    bool section_open;
+    std::vector<ContainerSection> directory;
+    ChecksumBuffer section_buffer;
+    std::ostream section_stream;
+};
+
+/*!
+ * \internal
+ * \ingroup TasmanianIO
+ * \brief Reads the binary container format from memory, e.g., from a memory mapped file.
+ *
+ * The constructor validates the header and the directory, the checksums of the payloads
+ * are verified only by verify(), hence reading a memory mapped file touches only
+ * the pages that are actually used.
+ * \endinternal
+ */
+class SectionReader{
+public:
+    /*!
+     * \brief Read the container stored in the first \b num_bytes of \b data, throws std::runtime_error if the data is corrupt.
+     *
+     * If \b data_owner is provided, it must keep \b data alive and unchanged, e.g., hold a read-only memory mapping;
+     * then getView() returns pointers into \b data that remain valid as long as a copy of getOwner() exists.
+     * Otherwise, the payloads have to be copied out of the container.
+     */
+    SectionReader(const char *data, size_t num_bytes, std::shared_ptr<const void> data_owner = std::shared_ptr<const void>()) :
+        container(data), owner(std::move(data_owner)), stream(&buffer){
+        if (num_bytes < sizeof(ContainerHeader))
+            throw std::runtime_error("ERROR: wrong binary file format, the file is too small to hold the header");
+        std::memcpy(&header, data, sizeof(ContainerHeader));
+        if (std::memcmp(header.magic, "TSG6", 4) != 0)
+            throw std::runtime_error("ERROR: wrong binary file format, the container header is not 'TSG6'");
+        if (header.endian != container_endian)
+            throw std::runtime_error("ERROR: wrong binary file format, the file was written on a machine with different endians");
+        if ((header.total_bytes > num_bytes) || (header.total_bytes < sizeof(ContainerHeader) + header.num_sections * sizeof(ContainerSection)))
+            throw std::runtime_error("ERROR: wrong binary file format, the file is truncated");
+        directory.resize(header.num_sections);
+        std::memcpy(directory.data(), data + sizeof(ContainerHeader), directory.size() * sizeof(ContainerSection));
+        if (checksum(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(ContainerSection)) != header.directory_checksum)
+            throw std::runtime_error("ERROR: wrong binary file format, the checksum of the section directory does not match");
+        for(auto const &s : directory)
+            if ((s.offset % container_alignment != 0) || (s.offset > header.total_bytes) || (s.num_bytes > header.total_bytes - s.offset))
+                throw std::runtime_error("ERROR: wrong binary file format, the section directory is corrupt");
+    }
+
+    //! \brief Verify the checksums of all sections, throws std::runtime_error if the data is corrupt.
+    void verify() const{
+        for(auto const &s : directory){
+            if (checksum(container + s.offset, (size_t) s.num_bytes) != s.checksum){
+                std::string tag(s.tag, std::find(s.tag, s.tag + sizeof(s.tag), '\0'));
+                throw std::runtime_error(std::string("ERROR: wrong binary file format, the checksum does not match for section: ") + tag);
+            }
+        }
+    }
+
+    //! \brief Return the type of the grid, see ContainerHeader::grid_type.
+    char getGridType() const{ return header.grid_type; }
+
+    //! \brief Return \b true if the container holds a section with the given \b tag.
+    bool hasSection(const char *tag) const{ return (findSection(tag) != nullptr); }
+
+    //! \brief Return a pointer to the payload of the section and write the size in \b num_bytes, see verify() for the checksum.
+    const char* getSectionData(const char *tag, size_t &num_bytes) const{
+        const ContainerSection *s = findSection(tag);
+        if (s == nullptr)
+            throw std::runtime_error(std::string("ERROR: wrong binary file format, missing section: ") + tag);
+        num_bytes = (size_t) s->num_bytes;
+        return container + s->offset;
+    }
+
+    //! \brief Return a stream that reads the payload of the section, the stream is invalidated by the next call.
+    std::istream& getSection(const char *tag){
+        size_t num_bytes;
+        const char *payload = getSectionData(tag, num_bytes);
+        buffer.reset(payload, num_bytes);
+        stream.clear();
+        return stream;
+    }
+
+    //! \brief Return the object that keeps the container alive, nullptr if the payloads cannot be referenced after the read.
+    std::shared_ptr<const void> const& getOwner() const{ return owner; }
+
+    /*!
+     * \brief Return a read-only view of the next \b num_entries of the last section opened with getSection() and advance the stream past them.
+     *
+     * Returns nullptr and leaves the stream unchanged, if the reader does not have an owner of the data
+     * or if the entries are not aligned in memory, the entries have to be read from the stream in that case.
+     * Throws std::runtime_error if the section is too short to hold the entries.
+     */
+    template<typename T> const T* getView(size_t num_entries){
+        if (!owner || (reinterpret_cast<std::uintptr_t>(buffer.position()) % alignof(T) != 0)) return nullptr;
+        if (num_entries > buffer.remaining() / sizeof(T))
+            throw std::runtime_error("ERROR: wrong binary file format, the section is too short");
+        const T *view = reinterpret_cast<const T*>(buffer.position());
+        buffer.skip(num_entries * sizeof(T));
+        return view;
+    }
+
+private:
+    //! \brief Return the directory entry associated with the tag, or nullptr if missing.
+    const ContainerSection* findSection(const char *tag) const{
+        char key[sizeof(ContainerSection::tag)] = {0};
+        std::memcpy(key, tag, std::min(std::strlen(tag), sizeof(key)));
+        for(auto const &s : directory)
+            if (std::memcmp(s.tag, key, sizeof(key)) == 0) return &s;
+        return nullptr;
+    }
+
+    const char *container;
+    std::shared_ptr<const void> owner;
+    ContainerHeader header;
+    std::vector<ContainerSection> directory;
+    MemoryBuffer buffer;
+    std::istream stream;
+};
+
 }
 
 }
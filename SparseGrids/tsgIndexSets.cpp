@@ -31,15 +31,19 @@
 #ifndef __TASMANIAN_SPARSE_GRID_INDEX_SETS_CPP
 #define __TASMANIAN_SPARSE_GRID_INDEX_SETS_CPP
 
+#include <mutex>
+
 #include "tsgIndexSets.hpp"
 
 namespace TasGrid{
 
+constexpr int MultiIndexSet::hash_min_indexes;
+
 template<bool iomode>
 void MultiIndexSet::write(std::ostream &os) const{
     if (cache_num_indexes > 0){
         IO::writeNumbers<iomode, IO::pad_rspace>(os, (int) num_dimensions, cache_num_indexes);
-        IO::writeVector<iomode, IO::pad_line>(indexes, os);
+        IO::writeVector<iomode, IO::pad_line>(indexes.data(), indexes.size(), os);
     }else{
         IO::writeNumbers<iomode, IO::pad_line>(os, (int) num_dimensions, cache_num_indexes);
     }
@@ -47,10 +51,11 @@ void MultiIndexSet::write(std::ostream &os) const{
 
 template<bool iomode>
 void MultiIndexSet::read(std::istream &is){
+    clearHashIndex();
     num_dimensions = (size_t) IO::readNumber<iomode, int>(is);
     cache_num_indexes = IO::readNumber<iomode, int>(is);
-    indexes.resize(num_dimensions * ((size_t) cache_num_indexes));
-    IO::readVector<iomode>(is, indexes);
+    indexes = MappedVector<int>(std::vector<int>(num_dimensions * ((size_t) cache_num_indexes)));
+    IO::readVector<iomode>(is, indexes.vector());
 }
 
 template void MultiIndexSet::write<mode_ascii>(std::ostream &) const; // instantiate for faster build
@@ -58,18 +63,33 @@ template void MultiIndexSet::write<mode_binary>(std::ostream &) const;
 template void MultiIndexSet::read<mode_ascii>(std::istream &);
 template void MultiIndexSet::read<mode_binary>(std::istream &);
 
-void MultiIndexSet::addSortedIndexes(const std::vector<int> &addition){
+void MultiIndexSet::read(IO::SectionReader &sections, const char *tag){
+    std::istream &is = sections.getSection(tag);
+    clearHashIndex();
+    num_dimensions = (size_t) IO::readNumber<mode_binary, int>(is);
+    cache_num_indexes = IO::readNumber<mode_binary, int>(is);
+    size_t num_entries = num_dimensions * ((size_t) cache_num_indexes);
+    const int *view = (cache_num_indexes > 0) ? sections.getView<int>(num_entries) : nullptr;
+    if (view != nullptr){
+        indexes.setView(view, num_entries, sections.getOwner());
+    }else{
+        indexes = MappedVector<int>(std::vector<int>(num_entries));
+        IO::readVector<mode_binary>(is, indexes.vector());
+    }
+}
+
+void MultiIndexSet::addSortedIndexes(const int addition[], size_t num_entries){
+    clearHashIndex();
     if (indexes.empty()){
-        indexes = addition;
+        indexes = MappedVector<int>(std::vector<int>(addition, addition + num_entries));
     }else{
-        std::vector<int> old_indexes = std::move(indexes);
-        indexes = std::vector<int>(); // reset the indexes
+        MappedVector<int> old_indexes = std::move(indexes); // read-only indexes are not copied
 
-        std::vector<std::vector<int>::const_iterator> merge_map;
-        merge_map.reserve(addition.size() + old_indexes.size());
+        std::vector<const int*> merge_map;
+        merge_map.reserve(num_entries + old_indexes.size());
         auto next = std::back_inserter(merge_map);
 
-        auto compare = [&](std::vector<int>::const_iterator ia, std::vector<int>::const_iterator ib) ->
+        auto compare = [&](const int *ia, const int *ib) ->
                             TypeIndexRelation{
                                 for(size_t j=0; j<num_dimensions; j++){
                                     if (*ia   < *ib)   return type_abeforeb;
@@ -79,10 +99,10 @@ void MultiIndexSet::addSortedIndexes(const std::vector<int> &addition){
                             };
 
         // merge with three way compare
-        auto ia = old_indexes.begin();
-        auto ib = addition.begin();
-        auto aend = old_indexes.end();
-        auto bend = addition.end();
+        const int *ia = old_indexes.data();
+        const int *ib = addition;
+        const int *aend = ia + old_indexes.size();
+        const int *bend = ib + num_entries;
         while((ia != aend) || (ib != bend)){
             TypeIndexRelation relation;
             if (ib == bend){
@@ -103,12 +123,13 @@ void MultiIndexSet::addSortedIndexes(const std::vector<int> &addition){
             }
         }
 
-        indexes.resize(merge_map.size() * num_dimensions); // merge map will reference only indexes in both sets
-        auto iindexes = indexes.begin();
+        std::vector<int> merged(merge_map.size() * num_dimensions); // merge map will reference only indexes in both sets
+        auto iindexes = merged.begin();
         for(auto &i : merge_map){
             std::copy_n(i, num_dimensions, iindexes);
             std::advance(iindexes, num_dimensions);
         }
+        indexes = MappedVector<int>(std::move(merged));
     }
     cache_num_indexes = (int) (indexes.size() / num_dimensions);
 }
@@ -117,14 +138,14 @@ void MultiIndexSet::setData2D(Data2D<int> const &data){
     size_t num = (size_t) data.getNumStrips();
     if (num == 0) return; // nothing to do
 
-    std::vector<std::vector<int>::const_iterator> index_refs(num);
-    auto iadd = data.getVector().begin();
+    std::vector<int const*> index_refs(num);
+    int const *iadd = data.getStrip(0);
     for(auto &i : index_refs){
         i = iadd;
         std::advance(iadd, num_dimensions);
     }
     std::sort(index_refs.begin(), index_refs.end(),
-              [&](std::vector<int>::const_iterator ia, std::vector<int>::const_iterator ib) ->
+              [&](int const *ia, int const *ib) ->
               bool{
                     for(size_t j=0; j<num_dimensions; j++){
                         if (*ia   < *ib)   return true;
@@ -133,24 +154,56 @@ void MultiIndexSet::setData2D(Data2D<int> const &data){
                     return false;
             });
     auto unique_end = std::unique(index_refs.begin(), index_refs.end(),
-                                  [&](std::vector<int>::const_iterator ia, std::vector<int>::const_iterator ib) ->
+                                  [&](int const *ia, int const *ib) ->
                                   bool{
                                         for(size_t j=0; j<num_dimensions; j++) if (*ia++ != *ib++) return false;
                                         return true;
                                 });
     index_refs.resize(std::distance(index_refs.begin(), unique_end));
 
-    indexes.resize(index_refs.size() * num_dimensions);
-    auto iindexes = indexes.begin();
+    std::vector<int> sorted(index_refs.size() * num_dimensions);
+    auto iindexes = sorted.begin();
     for(auto &i : index_refs){
         std::copy_n(i, num_dimensions, iindexes);
         std::advance(iindexes, num_dimensions);
     }
+    indexes = MappedVector<int>(std::move(sorted));
 
     cache_num_indexes = (int) (indexes.size() / num_dimensions);
 }
 
 int MultiIndexSet::getSlot(const int *p) const{
+    if (cache_num_indexes < hash_min_indexes) return searchSlot(p);
+    if (!hash_ready.load(std::memory_order_acquire)) buildHashIndex();
+
+    size_t mask = hash_table.size() - 1;
+    size_t h = hashIndex(p) & mask;
+    while(hash_table[h] != -1){
+        if (std::equal(p, p + num_dimensions, getIndex(hash_table[h]))) return hash_table[h];
+        h = (h + 1) & mask;
+    }
+    return -1;
+}
+
+void MultiIndexSet::buildHashIndex() const{
+    static std::mutex hash_lock; // building the index is rare, a single lock for all sets is sufficient
+    std::lock_guard<std::mutex> lock(hash_lock);
+    if (hash_ready.load(std::memory_order_relaxed)) return; // another thread built the index
+
+    size_t table_size = 1;
+    while(table_size < 2 * ((size_t) cache_num_indexes)) table_size *= 2; // load factor at most 1/2
+    hash_table = std::vector<int>(table_size, -1);
+
+    size_t mask = table_size - 1;
+    for(int i=0; i<cache_num_indexes; i++){
+        size_t h = hashIndex(getIndex(i)) & mask;
+        while(hash_table[h] != -1) h = (h + 1) & mask;
+        hash_table[h] = i;
+    }
+    hash_ready.store(true, std::memory_order_release);
+}
+
+int MultiIndexSet::searchSlot(const int *p) const{
     int sstart = 0, send = cache_num_indexes - 1;
     int current = (sstart + send) / 2;
     while (sstart <= send){
@@ -175,19 +228,19 @@ int MultiIndexSet::getSlot(const int *p) const{
 }
 
 MultiIndexSet MultiIndexSet::diffSets(const MultiIndexSet &substract){
-    std::vector<std::vector<int>::iterator> kept_indexes;
+    std::vector<const int*> kept_indexes;
 
-    auto ithis = indexes.begin();
-    auto endthis = indexes.end();
-    auto iother = substract.getVector().begin();
-    auto endother = substract.getVector().end();
+    const int *ithis = indexes.data();
+    const int *endthis = ithis + indexes.size();
+    const int *iother = substract.indexes.data();
+    const int *endother = iother + substract.indexes.size();
 
     while(ithis != endthis){
         if (iother == endother){
             kept_indexes.push_back(ithis);
             std::advance(ithis, num_dimensions);
         }else{
-            TypeIndexRelation t = [&](std::vector<int>::iterator ia, std::vector<int>::const_iterator ib) ->
+            TypeIndexRelation t = [&](const int *ia, const int *ib) ->
                                         TypeIndexRelation{
                                             for(size_t j=0; j<num_dimensions; j++){
                                                 if (*ia   < *ib)   return type_abeforeb;
@@ -221,8 +274,10 @@ MultiIndexSet MultiIndexSet::diffSets(const MultiIndexSet &substract){
 void MultiIndexSet::removeIndex(const std::vector<int> &p){
     int slot = getSlot(p);
     if (slot > -1){
-        indexes.erase(indexes.begin() + ((size_t) slot) * num_dimensions, indexes.begin() + ((size_t) slot) * num_dimensions + num_dimensions);
+        std::vector<int> &vec = indexes.vector();
+        vec.erase(vec.begin() + ((size_t) slot) * num_dimensions, vec.begin() + ((size_t) slot) * num_dimensions + num_dimensions);
         cache_num_indexes--;
+        clearHashIndex();
     }
 }
 
@@ -234,15 +289,16 @@ void StorageSet::write(std::ostream &os) const{
     IO::writeNumbers<iomode, IO::pad_rspace>(os, (int) num_outputs, (int) num_values);
     IO::writeFlag<iomode, IO::pad_auto>((values.size() != 0), os);
     if (values.size() != 0)
-        IO::writeVector<iomode, IO::pad_line>(values, os);
+        IO::writeVector<iomode, IO::pad_line>(values.data(), values.size(), os);
 }
 template<bool iomode>
 void StorageSet::read(std::istream &is){
     num_outputs = (size_t) IO::readNumber<iomode, int>(is);
     num_values = (size_t) IO::readNumber<iomode, int>(is);
+    values = MappedVector<double>();
     if (IO::readFlag<iomode>(is)){
-        values.resize(num_outputs * num_values);
-        IO::readVector<iomode>(is, values);
+        values = MappedVector<double>(std::vector<double>(num_outputs * num_values));
+        IO::readVector<iomode>(is, values.vector());
     }
 }
 
@@ -251,22 +307,44 @@ template void StorageSet::write<mode_binary>(std::ostream &) const;
 template void StorageSet::read<mode_ascii>(std::istream &);
 template void StorageSet::read<mode_binary>(std::istream &);
 
+void StorageSet::writeSection(std::ostream &os) const{
+    IO::writeNumbers<mode_binary, IO::pad_none>(os, (int) num_outputs, (int) num_values);
+    if (values.size() != 0)
+        IO::writeVector<mode_binary, IO::pad_none>(values.data(), values.size(), os);
+}
+void StorageSet::read(IO::SectionReader &sections, const char *tag){
+    size_t num_bytes;
+    sections.getSectionData(tag, num_bytes);
+    std::istream &is = sections.getSection(tag);
+    num_outputs = (size_t) IO::readNumber<mode_binary, int>(is);
+    num_values = (size_t) IO::readNumber<mode_binary, int>(is);
+    values = MappedVector<double>();
+    if (num_bytes > 2 * sizeof(int)){ // the section holds values
+        const double *view = sections.getView<double>(num_outputs * num_values);
+        if (view != nullptr){
+            values.setView(view, num_outputs * num_values, sections.getOwner());
+        }else{
+            values = MappedVector<double>(std::vector<double>(num_outputs * num_values));
+            IO::readVector<mode_binary>(is, values.vector());
+        }
+    }
+}
+
 void StorageSet::resize(int cnum_outputs, int cnum_values){
-    values = std::vector<double>();
+    values = MappedVector<double>();
     num_outputs = cnum_outputs;
     num_values = cnum_values;
 }
 
-const double* StorageSet::getValues(int i) const{ return &(values[i*num_outputs]); }
-double* StorageSet::getValues(int i){ return &(values[i*num_outputs]); }
+const double* StorageSet::getValues(int i) const{ return values.data() + i*num_outputs; }
+double* StorageSet::getValues(int i){ return values.vector().data() + i*num_outputs; }
 
 void StorageSet::setValues(const double vals[]){
-    values.resize(num_outputs * num_values);
-    std::copy_n(vals, num_values * num_outputs, values.data());
+    values = MappedVector<double>(std::vector<double>(vals, vals + num_values * num_outputs));
 }
 void StorageSet::setValues(std::vector<double> &&vals){
     num_values = vals.size() / num_outputs;
-    values = std::vector<double>(vals); // move assignment
+    values = MappedVector<double>(std::move(vals));
 }
 
 void StorageSet::addValues(const MultiIndexSet &old_set, const MultiIndexSet &new_set, const double new_vals[]){
@@ -279,7 +357,7 @@ void StorageSet::addValues(const MultiIndexSet &old_set, const MultiIndexSet &ne
 
     int iold = 0, inew = 0;
     size_t off_vals = 0;
-    auto ivals = values.begin();
+    const double *ivals = values.data(); // read-only values are not copied
     auto icombined = combined_values.begin();
 
     auto compareIndexes = [&](int const a[], int const b[])->
@@ -311,7 +389,7 @@ void StorageSet::addValues(const MultiIndexSet &old_set, const MultiIndexSet &ne
         }
         std::advance(icombined, num_outputs);
     }
-    std::swap(values, combined_values);
+    values = MappedVector<double>(std::move(combined_values));
 }
 
 }
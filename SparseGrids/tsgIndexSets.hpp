@@ -31,6 +31,8 @@
 #ifndef __TASMANIAN_SPARSE_GRID_INDEX_SETS_HPP
 #define __TASMANIAN_SPARSE_GRID_INDEX_SETS_HPP
 
+#include <atomic>
+
 #include "tsgIOHelpers.hpp"
 
 /*!
@@ -74,21 +76,95 @@ namespace TasGrid{
  * \endinternal
  */
 template<typename T>
-std::vector<T> spltVector2D(std::vector<T> const &x, size_t stride, int ibegin, int iend){
+std::vector<T> spltVector2D(T const x[], size_t num_entries, size_t stride, int ibegin, int iend){
     size_t sbegin(ibegin), send(iend);
-    size_t num_strips = x.size() / stride;
+    size_t num_strips = num_entries / stride;
     size_t new_stride = send - sbegin;
     std::vector<T> result(num_strips * new_stride);
-    auto ix = x.begin();
     auto ir = result.begin();
     for(size_t i=0; i<num_strips; i++){
-        std::copy_n(ix + sbegin, new_stride, ir);
-        std::advance(ix, stride);
+        std::copy_n(x + sbegin, new_stride, ir);
+        x += stride;
         std::advance(ir, new_stride);
     }
     return result;
 }
 
+/*!
+ * \internal
+ * \ingroup TasmanianSets
+ * \brief Contiguous array that either owns its data in a std::vector or is a read-only view into memory owned by another object.
+ *
+ * The view is used to reference the data of a memory mapped file without a copy,
+ * the mapping is kept alive by a shared pointer to the owner.
+ * The class implements copy-on-write: the non-const vector() makes a private copy of a view,
+ * while data() and size() never copy. There is no const vector(), read-only algorithms use data().
+ * \endinternal
+ */
+template<typename T>
+class MappedVector{
+public:
+    //! \brief Make an empty vector.
+    MappedVector() : view(nullptr), view_size(0){}
+    //! \brief Move the data into the owned vector.
+    MappedVector(std::vector<T> &&data) : view(nullptr), view_size(0), vec(std::move(data)){}
+    //! \brief Copy constructor, a view is copied as a view and shares the owner.
+    MappedVector(MappedVector<T> const &other) = default;
+    //! \brief Move constructor, the \b other is left empty.
+    MappedVector(MappedVector<T> &&other) : view(other.view), view_size(other.view_size), owner(std::move(other.owner)), vec(std::move(other.vec)){
+        other.view = nullptr;
+        other.view_size = 0;
+    }
+    //! \brief Copy assignment, a view is copied as a view and shares the owner.
+    MappedVector<T>& operator =(MappedVector<T> const &other) = default;
+    //! \brief Move assignment, the \b other is left empty.
+    MappedVector<T>& operator =(MappedVector<T> &&other){
+        view = other.view;
+        view_size = other.view_size;
+        owner = std::move(other.owner);
+        vec = std::move(other.vec);
+        other.view = nullptr;
+        other.view_size = 0;
+        return *this;
+    }
+
+    //! \brief Discard the current data and reference the \b num_entries starting at \b data, \b data_owner must keep the \b data alive.
+    void setView(T const *data, size_t num_entries, std::shared_ptr<const void> const &data_owner){
+        view = data;
+        view_size = num_entries;
+        owner = data_owner;
+        vec = std::vector<T>();
+    }
+    //! \brief Returns \b true if the data is a view into memory owned by another object.
+    bool isView() const{ return (view != nullptr); }
+
+    //! \brief Returns the number of entries.
+    size_t size() const{ return (view != nullptr) ? view_size : vec.size(); }
+    //! \brief Returns \b true if there are no entries.
+    bool empty() const{ return (size() == 0); }
+    //! \brief Returns a pointer to the first entry, never copies the data.
+    T const* data() const{ return (view != nullptr) ? view : vec.data(); }
+    //! \brief Returns the \b i-th entry, never copies the data.
+    T const& operator[](size_t i) const{ return data()[i]; }
+
+    //! \brief Returns a reference to the owned vector, a view is first copied into the vector and released.
+    std::vector<T>& vector(){
+        if (view != nullptr){
+            if (vec.size() != view_size) vec.assign(view, view + view_size);
+            view = nullptr;
+            view_size = 0;
+            owner.reset();
+        }
+        return vec;
+    }
+
+private:
+    T const *view;
+    size_t view_size;
+    std::shared_ptr<const void> owner;
+    std::vector<T> vec;
+};
+
 /*!
  * \internal
  * \ingroup TasmanianSets
@@ -106,13 +182,13 @@ public:
     //! \brief Default constructor makes an empty data-structure.
     Data2D() : stride(0), num_strips(0){}
     //! \brief Create data-structure with given \b stride and number of \b strips.
-    Data2D(int new_stride, int new_num_strips) : stride((size_t) new_stride), num_strips((size_t) new_num_strips), vec(stride * num_strips){}
+    Data2D(int new_stride, int new_num_strips) : stride((size_t) new_stride), num_strips((size_t) new_num_strips), vec(std::vector<T>(stride * num_strips)){}
     //! \brief Create data-structure with given \b stride and number of \b strips.
-    Data2D(size_t new_stride, int new_num_strips) : stride(new_stride), num_strips((size_t) new_num_strips), vec(stride * num_strips){}
+    Data2D(size_t new_stride, int new_num_strips) : stride(new_stride), num_strips((size_t) new_num_strips), vec(std::vector<T>(stride * num_strips)){}
     //! \brief Create data-structure with given \b stride and number of \b strips and initializes with \b val.
-    Data2D(int new_stride, int new_num_strips, T val) : stride((size_t) new_stride), num_strips((size_t) new_num_strips), vec(stride * num_strips, val){}
+    Data2D(int new_stride, int new_num_strips, T val) : stride((size_t) new_stride), num_strips((size_t) new_num_strips), vec(std::vector<T>(stride * num_strips, val)){}
     //! \brief Create data-structure with given \b stride and number of \b strips and moves \b data into the internal vector.
-    Data2D(int new_stride, int new_num_strips, std::vector<T> &&data) : stride((size_t) new_stride), num_strips((size_t) new_num_strips), vec(data){}
+    Data2D(int new_stride, int new_num_strips, std::vector<T> &&data) : stride((size_t) new_stride), num_strips((size_t) new_num_strips), vec(std::move(data)){}
     //! \brief Default destructor.
     ~Data2D(){}
 
@@ -123,45 +199,57 @@ public:
     void resize(int new_stride, int new_num_strips){
         stride = (size_t) new_stride;
         num_strips = (size_t) new_num_strips;
-        vec.resize(stride * num_strips);
+        vec.vector().resize(stride * num_strips);
     }
 
     //! \brief Get the data between \b ibegin and \b iend of each strip.
     Data2D<T> splitData(int ibegin, int iend) const{
         Data2D<T> result(iend - ibegin, 0);
         result.num_strips = num_strips;
-        result.vec = spltVector2D(vec, stride, ibegin, iend);
+        result.vec = spltVector2D(vec.data(), vec.size(), stride, ibegin, iend);
         return result;
     }
 
     //! \brief Returns a reference to the \b i-th strip.
-    T* getStrip(int i){ return &(vec[i*stride]); }
-    //! \brief Returns a const reference to the \b i-th strip.
-    T const* getStrip(int i) const{ return &(vec[i*stride]); }
+    T* getStrip(int i){ return vec.vector().data() + Utils::size_mult(stride, i); }
+    //! \brief Returns a const reference to the \b i-th strip, does not copy read-only data (see isReadOnly()).
+    T const* getStrip(int i) const{ return vec.data() + Utils::size_mult(stride, i); }
     //! \brief Return iterator set at the \b i-th strip.
-    typename std::vector<T>::iterator getIStrip(int i){ return vec.begin() + Utils::size_mult(stride, i); }
-    //! \brief Return const_iterator set at the \b i-th strip.
-    typename std::vector<T>::const_iterator getIStrip(int i) const{ return vec.cbegin() + Utils::size_mult(stride, i); }
+    typename std::vector<T>::iterator getIStrip(int i){ return vec.vector().begin() + Utils::size_mult(stride, i); }
+    //! \brief Return a const pointer set at the \b i-th strip, does not copy read-only data.
+    T const* getIStrip(int i) const{ return getStrip(i); }
     //! \brief Returns the stride.
     size_t getStride() const{ return stride; }
     //! \brief Returns the number of strips.
     int getNumStrips() const{ return (int) num_strips; }
     //! \brief Returns the total number of entries, stride times number of trips.
     size_t getTotalEntries() const{ return vec.size(); }
-    //! \brief Returns a reference to the internal data.
-    std::vector<T>& getVector(){ return vec; }
-    //! \brief Returns a const reference to the internal data.
-    const std::vector<T>& getVector() const{ return vec; }
+    //! \brief Returns a reference to the internal data, read-only data is copied first.
+    std::vector<T>& getVector(){ return vec.vector(); }
     //! \brief Clear all used data.
     void clear(){
         stride = 0;
         num_strips = 0;
-        vec = std::vector<double>();
+        vec = MappedVector<T>();
+    }
+
+    //! \brief Returns \b true if the data is a read-only view into memory owned by another object, e.g., a memory mapped file.
+    bool isReadOnly() const{ return vec.isView(); }
+    /*!
+     * \brief Replace the data with a read-only view of \b data with the given \b stride and number of \b strips.
+     *
+     * The \b data_owner must keep the \b data alive, the non-const methods will make a private copy of the data.
+     */
+    void setReadOnly(size_t new_stride, int new_num_strips, T const *data, std::shared_ptr<const void> const &data_owner){
+        stride = new_stride;
+        num_strips = (size_t) new_num_strips;
+        vec.setView(data, stride * num_strips, data_owner);
     }
 
     //! \brief Uses std::vector::insert to append the data.
     void appendStrip(typename std::vector<T>::const_iterator const &x){
-        vec.insert(vec.end(), x, x + stride);
+        std::vector<T> &v = vec.vector();
+        v.insert(v.end(), x, x + stride);
         num_strips++;
     }
 
@@ -172,16 +260,20 @@ public:
 
     //! \brief Uses std::vector::insert to append a strip \b x to the existing data at position \b pos, assumes \b x.size() is one stride.
     void appendStrip(int pos, const std::vector<T> &x){
-        vec.insert(vec.begin() + (((size_t) pos) * stride), x.begin(), x.end());
+        std::vector<T> &v = vec.vector();
+        v.insert(v.begin() + (((size_t) pos) * stride), x.begin(), x.end());
         num_strips++;
     }
 
     //! \brief Fill the entire vector with the specified \b value.
-    void fill(T value){ std::fill(vec.begin(), vec.end(), value); }
+    void fill(T value){
+        std::vector<T> &v = vec.vector();
+        std::fill(v.begin(), v.end(), value);
+    }
 
 private:
     size_t stride, num_strips;
-    std::vector<T> vec;
+    MappedVector<T> vec;
 };
 
 namespace IO{
@@ -197,6 +289,24 @@ namespace IO{
         readVector<useAscii>(is, data.getVector());
         return data;
     }
+
+    /*!
+    * \internal
+    * \ingroup TasmanianIO
+    * \brief Read the Data2D structure from the section of the binary container with the given \b tag.
+    *
+    * If the container is memory mapped, the result is a read-only view into the mapping, otherwise the data is copied.
+    * \endinternal
+    */
+    template<typename DataType, typename IndexStride, typename IndexNumStrips>
+    Data2D<DataType> readData2D(SectionReader &sections, const char *tag, IndexStride stride, IndexNumStrips num_strips){
+        std::istream &is = sections.getSection(tag);
+        const DataType *view = sections.getView<DataType>(Utils::size_mult(stride, num_strips));
+        if (view == nullptr) return readData2D<mode_binary, DataType>(is, stride, num_strips);
+        Data2D<DataType> data;
+        data.setReadOnly((size_t) stride, (int) num_strips, view, sections.getOwner());
+        return data;
+    }
 }
 
 /*!
@@ -207,7 +317,8 @@ namespace IO{
  * At the core of each sparse grid, there are multiple multi-index sets.
  * The organization of the data is similar to the \b Data2D class, but at any time the indexes
  * are stored in a lexicographical order. The main functionality provided here is:
- * - fast O(log(n)) search utilizing the lexicographical order
+ * - fast O(log(n)) search utilizing the lexicographical order,
+ *   or O(1) search using a hash index that is built the first time a large set is searched
  * - synchronization between multi-indexes and values (i.e., model outputs)
  * - adding or removing indexes while preserving the order
  * - basic file I/O
@@ -216,12 +327,37 @@ namespace IO{
 class MultiIndexSet{
 public:
     //! \brief Default constructor, makes an empty set.
-    MultiIndexSet() : num_dimensions(0), cache_num_indexes(0){}
+    MultiIndexSet() : num_dimensions(0), cache_num_indexes(0), hash_ready(false){}
     //! \brief Constructor, makes a set by \b moving out of the vector, the vector must be already sorted.
     MultiIndexSet(size_t cnum_dimensions, std::vector<int> &&new_indexes) :
-        num_dimensions(cnum_dimensions), cache_num_indexes((int)(new_indexes.size() / cnum_dimensions)), indexes(new_indexes){}
+        num_dimensions(cnum_dimensions), cache_num_indexes((int)(new_indexes.size() / cnum_dimensions)), indexes(std::move(new_indexes)), hash_ready(false){}
     //! \brief Copy a collection of unsorted indexes into a sorted multi-index set, sorts during the copy.
-    MultiIndexSet(Data2D<int> &data) : num_dimensions((size_t) data.getStride()), cache_num_indexes(0){ setData2D(data); }
+    MultiIndexSet(Data2D<int> &data) : num_dimensions((size_t) data.getStride()), cache_num_indexes(0), hash_ready(false){ setData2D(data); }
+    //! \brief Copy constructor, the hash index is not copied and will be rebuilt on demand.
+    MultiIndexSet(MultiIndexSet const &other) :
+        num_dimensions(other.num_dimensions), cache_num_indexes(other.cache_num_indexes), indexes(other.indexes), hash_ready(false){}
+    //! \brief Move constructor, the hash index is moved together with the indexes.
+    MultiIndexSet(MultiIndexSet &&other) :
+        num_dimensions(other.num_dimensions), cache_num_indexes(other.cache_num_indexes), indexes(std::move(other.indexes)),
+        hash_table(std::move(other.hash_table)), hash_ready(other.hash_ready.load()){ other.clearHashIndex(); }
+    //! \brief Copy assignment, the hash index is not copied and will be rebuilt on demand.
+    MultiIndexSet& operator =(MultiIndexSet const &other){
+        num_dimensions = other.num_dimensions;
+        cache_num_indexes = other.cache_num_indexes;
+        indexes = other.indexes;
+        clearHashIndex();
+        return *this;
+    }
+    //! \brief Move assignment, the hash index is moved together with the indexes.
+    MultiIndexSet& operator =(MultiIndexSet &&other){
+        num_dimensions = other.num_dimensions;
+        cache_num_indexes = other.cache_num_indexes;
+        indexes = std::move(other.indexes);
+        hash_table = std::move(other.hash_table);
+        hash_ready = other.hash_ready.load();
+        other.clearHashIndex();
+        return *this;
+    }
     //! \brief Default destructor.
     ~MultiIndexSet(){}
 
@@ -236,6 +372,11 @@ public:
     //! Uses the same format as \b write<bool>
     template<bool useAscii> void read(std::istream &os);
 
+    //! \brief Read from the section of the binary container written with \b write<mode_binary>, a memory mapped container gives read-only indexes.
+    void read(IO::SectionReader &sections, const char *tag);
+    //! \brief Returns \b true if the indexes are a read-only view into memory owned by another object, e.g., a memory mapped file.
+    bool isReadOnly() const{ return indexes.isView(); }
+
     //! \brief Returns **true** if there are no multi-indexes in the set, **false** otherwise
     inline bool empty() const{ return indexes.empty(); }
 
@@ -245,19 +386,25 @@ public:
     inline int getNumIndexes() const{ return cache_num_indexes; }
 
     //! \brief Add more indexes to a non-empty set, \b addition must be sorted and the set must be initialized.
-    void addSortedIndexes(std::vector<int> const &addition);
+    void addSortedIndexes(std::vector<int> const &addition){ addSortedIndexes(addition.data(), addition.size()); }
+    //! \brief Add the \b num_entries starting at \b addition, the indexes must be sorted and the set must be initialized.
+    void addSortedIndexes(const int addition[], size_t num_entries);
     //! \brief If empty, copy \b addition, otherwise merge the indexes of \b addition into this set.
     inline void addMultiIndexSet(MultiIndexSet const  &addition){
         num_dimensions = addition.getNumDimensions();
-        addSortedIndexes(addition.getVector());
+        addSortedIndexes(addition.indexes.data(), addition.indexes.size());
     }
 
-    //! \brief Returns a const reference to the internal data
-    inline const std::vector<int>& getVector() const{ return indexes; }
     //! \brief Returns a reference to the internal data, must not modify the lexicographical order or the size of the vector
-    inline std::vector<int>& getVector(){ return indexes; } // used for remapping during tensor generic points
+    inline std::vector<int>& getVector(){ clearHashIndex(); return indexes.vector(); } // used for remapping during tensor generic points
 
-    //! \brief Returns the slot containing index **p**, returns `-1` if not found
+    /*!
+     * \brief Returns the slot containing index **p**, returns `-1` if not found
+     *
+     * Small sets use binary search, sets with at least \b hash_min_indexes indexes use a hash index
+     * which is built the first time the set is searched and is invalidated when the set is modified.
+     * The hash index is build under a lock, thus getSlot() can be called from multiple threads.
+     */
     int getSlot(const int *p) const;
     //! \brief Returns the slot containing index **p**, returns `-1` if not found
     inline int getSlot(const std::vector<int> &p) const{ return getSlot(p.data()); }
@@ -265,7 +412,7 @@ public:
     inline bool missing(const std::vector<int> &p) const{ return (getSlot(p.data()) == -1); }
 
     //! \brief Returns the **i**-th index of the set, useful to loop over all indexes or to cross reference with values
-    inline const int *getIndex(int i) const{ return &(indexes[((size_t) i) * num_dimensions]); }
+    inline const int *getIndex(int i) const{ return indexes.data() + ((size_t) i) * num_dimensions; }
 
     /*! \brief Return a new multi-index set that holds the indexed present in this set, but missing in \b substract.
      *
@@ -279,16 +426,42 @@ public:
     void removeIndex(const std::vector<int> &p);
 
     //! \brief Returns the maximum single index in the set.
-    int getMaxIndex() const{ return (empty()) ? 0 : *std::max_element(indexes.begin(), indexes.end()); }
+    int getMaxIndex() const{ return (empty()) ? 0 : *std::max_element(indexes.data(), indexes.data() + indexes.size()); }
 
 protected:
     //! \brief Copy and sort the indexes from the \b data, called only from the constructor.
     void setData2D(Data2D<int> const &data);
 
+    //! \brief Returns the slot of \b p using binary search (i.e., without the hash index).
+    int searchSlot(const int *p) const;
+    //! \brief Returns the hash associated with the multi-index \b p.
+    size_t hashIndex(const int *p) const{ // FNV-1a over the entries of the multi-index
+        unsigned long long h = 14695981039346656037ULL;
+        for(size_t j=0; j<num_dimensions; j++){
+            h ^= (unsigned long long) (unsigned int) p[j];
+            h *= 1099511628211ULL;
+        }
+        return (size_t) (h ^ (h >> 29));
+    }
+    //! \brief Builds the hash index, if not already built.
+    void buildHashIndex() const;
+    //! \brief Clears the hash index, must be called every time the indexes are modified.
+    void clearHashIndex(){
+        hash_table = std::vector<int>();
+        hash_ready = false;
+    }
+
+    //! \brief The hash index is used only for sets with at least this many multi-indexes.
+    static constexpr int hash_min_indexes = 64;
+
 private:
     size_t num_dimensions;
     int cache_num_indexes;
-    std::vector<int> indexes;
+    MappedVector<int> indexes;
+
+    // open addressing table with linear probing, holds the slots of the indexes, or -1 for empty entries
+    mutable std::vector<int> hash_table;
+    mutable std::atomic<bool> hash_ready;
 };
 
 /*!
@@ -322,6 +495,18 @@ public:
     //! \brief Read the from the stream, must know whether to use ASCII or binary format.
     template<bool useAscii> void read(std::istream &os);
 
+    /*!
+     * \brief Write the set to a section of the binary container.
+     *
+     * The format consists of two `int` values corresponding to the number of outputs and number of values,
+     * followed by the values (if any), thus the values are aligned with respect to the beginning of the section.
+     */
+    void writeSection(std::ostream &os) const;
+    //! \brief Read from a section of the binary container written with writeSection(), a memory mapped container gives read-only values.
+    void read(IO::SectionReader &sections, const char *tag);
+    //! \brief Returns \b true if the values are a read-only view into memory owned by another object, e.g., a memory mapped file.
+    bool isReadOnly() const{ return values.isView(); }
+
     //! \brief Clear the existing values and assigns new dimensions, does not allocate memory for the new values.
     void resize(int cnum_outputs, int cnum_values);
 
@@ -329,10 +514,10 @@ public:
     const double* getValues(int i) const;
     //! \brief Returns reference to the \b i-th value.
     double* getValues(int i);
-    //! \brief Returns reference to the internal data vector.
-    std::vector<double>& getVector(){ return values; }
-    //! \brief Returns const reference to the internal data vector.
-    const std::vector<double>& getVector() const{ return values; }
+    //! \brief Returns the total number of loaded entries, i.e., number of outputs times number of values or zero if the values are not loaded.
+    size_t getTotalEntries() const{ return values.size(); }
+    //! \brief Returns reference to the internal data vector, read-only values are copied first.
+    std::vector<double>& getVector(){ return values.vector(); }
 
     //! \brief Replace the existing values with a copy of **vals**, the size must be at least **num_outputs** times **num_values**
     void setValues(const double vals[]);
@@ -344,7 +529,7 @@ public:
         StorageSet result;
         result.num_values = num_values;
         result.num_outputs = (size_t) (iend - ibegin);
-        result.values = spltVector2D(values, num_outputs, ibegin, iend);
+        result.values = spltVector2D(values.data(), values.size(), num_outputs, ibegin, iend);
         return result;
     }
 
@@ -362,7 +547,7 @@ public:
 
 private:
     size_t num_outputs, num_values; // kept as size_t to avoid conversions in products, but each one is small individually
-    std::vector<double> values;
+    MappedVector<double> values;
 };
 
 }
@@ -328,44 +328,182 @@ void SparseMatrix::load(const std::vector<int> &lpntr, const std::vector<std::ve
 
 int SparseMatrix::getNumRows() const{ return num_rows; }
 
+void SparseMatrix::computeLevels(bool lower, std::vector<int> const &mpntr, std::vector<int> const &mindx, std::vector<int> const &mindxD,
+                                 std::vector<int> &levels_pntr, std::vector<int> &levels_rows) const{
+    // the level of a row is one more than the largest level of the rows it depends on,
+    // rows on the same level are independent and can be processed in parallel
+    std::vector<int> level((size_t) num_rows, 0);
+    int num_levels = 0;
+    for(int r=0; r<num_rows; r++){
+        int i = (lower) ? r : num_rows - 1 - r;
+        int jbegin = (lower) ? mpntr[i] : mindxD[i] + 1;
+        int jend   = (lower) ? mindxD[i] : mpntr[i+1];
+        int l = 0;
+        for(int j=jbegin; j<jend; j++) l = std::max(l, level[mindx[j]] + 1);
+        level[i] = l;
+        num_levels = std::max(num_levels, l + 1);
+    }
+
+    levels_pntr = std::vector<int>((size_t) num_levels + 1, 0);
+    for(auto l : level) levels_pntr[l + 1]++;
+    for(int l=0; l<num_levels; l++) levels_pntr[l + 1] += levels_pntr[l];
+
+    levels_rows.resize((size_t) num_rows);
+    std::vector<int> offset(levels_pntr.begin(), levels_pntr.end() - 1);
+    for(int r=0; r<num_rows; r++){
+        int i = (lower) ? r : num_rows - 1 - r;
+        levels_rows[offset[level[i]]++] = i;
+    }
+}
+
 void SparseMatrix::computeILU(){
     indxD.resize(num_rows);
-    ilu.resize(pntr[num_rows]);
     for(int i=0; i<num_rows; i++){
         int j = pntr[i];
         while(indx[j] < i){ j++; };
         indxD[i] = j;
     }
 
-    ilu = vals;
+    computeLevels(true,  pntr, indx, indxD, lower_pntr, lower_rows);
+    computeLevels(false, pntr, indx, indxD, upper_pntr, upper_rows);
 
-    for(int i=0; i<num_rows-1; i++){
-        double u = ilu[indxD[i]];
-        #pragma omp parallel for
-        for(int j=i+1; j<num_rows; j++){ // update the rest of the matrix, each row can be done in parallel
-            int jc = pntr[j];
-            while(indx[jc] < i){ jc++; }
-            if (indx[jc] == i){
-                ilu[jc] /= u;
-                double l = ilu[jc];
-                int ik = indxD[i]+1;
-                int jk = jc+1;
-                while((ik<pntr[i+1]) && (jk<pntr[j+1])){
-                    if (indx[ik] == indx[jk]){
-                        ilu[jk] -= l * ilu[ik];
-                        ik++; jk++;
-                    }else if (indx[ik] < indx[jk]){
+    // zero fill-in factorization, row i is updated by the (already factored) rows of the non-zeros left of the diagonal
+    ilu = vals;
+    int num_levels = (int) lower_pntr.size() - 1;
+    for(int l=0; l<num_levels; l++){
+        #pragma omp parallel for if (lower_pntr[l+1] - lower_pntr[l] > 32)
+        for(int r=lower_pntr[l]; r<lower_pntr[l+1]; r++){
+            int i = lower_rows[r];
+            for(int jk=pntr[i]; jk<indxD[i]; jk++){
+                int k = indx[jk];
+                ilu[jk] /= ilu[indxD[k]];
+                double f = ilu[jk];
+                int ik = indxD[k]+1;
+                int ij = jk+1;
+                while((ik<pntr[k+1]) && (ij<pntr[i+1])){
+                    if (indx[ik] == indx[ij]){
+                        ilu[ij] -= f * ilu[ik];
+                        ik++; ij++;
+                    }else if (indx[ik] < indx[ij]){
                         ik++;
                     }else{
-                        jk++;
+                        ij++;
                     }
                 }
             }
         }
     }
+
+    // transposed copy of the matrix and the factors, the transposed sweeps and products become row-wise gathers
+    tpntr = std::vector<int>((size_t) num_rows + 1, 0);
+    for(int j=0; j<pntr[num_rows]; j++) tpntr[indx[j] + 1]++;
+    for(int i=0; i<num_rows; i++) tpntr[i+1] += tpntr[i];
+    tindx.resize(indx.size());
+    tvals.resize(vals.size());
+    tilu.resize(ilu.size());
+    std::vector<int> offset(tpntr.begin(), tpntr.end() - 1);
+    for(int i=0; i<num_rows; i++){
+        for(int j=pntr[i]; j<pntr[i+1]; j++){
+            int t = offset[indx[j]]++;
+            tindx[t] = i;
+            tvals[t] = vals[j];
+            tilu[t] = ilu[j];
+        }
+    }
+    tindxD.resize(num_rows);
+    for(int i=0; i<num_rows; i++){
+        int j = tpntr[i];
+        while(tindx[j] < i){ j++; };
+        tindxD[i] = j;
+    }
+    computeLevels(true,  tpntr, tindx, tindxD, tlower_pntr, tlower_rows);
+    computeLevels(false, tpntr, tindx, tindxD, tupper_pntr, tupper_rows);
+}
+
+void SparseMatrix::sweep(bool lower, bool divide, std::vector<int> const &levels_pntr, std::vector<int> const &levels_rows,
+                         std::vector<int> const &mpntr, std::vector<int> const &mindx, std::vector<int> const &mindxD,
+                         std::vector<double> const &factor, int num_rhs, double panel[]) const{
+    Utils::Wrapper2D<double> pwrap(num_rhs, panel);
+    int num_levels = (int) levels_pntr.size() - 1;
+    for(int l=0; l<num_levels; l++){
+        #pragma omp parallel for if (levels_pntr[l+1] - levels_pntr[l] > 32)
+        for(int r=levels_pntr[l]; r<levels_pntr[l+1]; r++){
+            int i = levels_rows[r];
+            double *pi = pwrap.getStrip(i);
+            int jbegin = (lower) ? mpntr[i] : mindxD[i] + 1;
+            int jend   = (lower) ? mindxD[i] : mpntr[i+1];
+            for(int j=jbegin; j<jend; j++){
+                const double *pj = pwrap.getStrip(mindx[j]);
+                double f = factor[j];
+                for(int k=0; k<num_rhs; k++) pi[k] -= f * pj[k];
+            }
+            if (divide){
+                double d = factor[mindxD[i]];
+                for(int k=0; k<num_rhs; k++) pi[k] /= d;
+            }
+        }
+    }
+}
+
+void SparseMatrix::applyILU(int num_rhs, double panel[]) const{
+    // forward and backward substitution, each row of the panel holds the entries of all right-hand-sides
+    sweep(true,  false, lower_pntr, lower_rows, pntr, indx, indxD, ilu, num_rhs, panel);
+    sweep(false, true,  upper_pntr, upper_rows, pntr, indx, indxD, ilu, num_rhs, panel);
+}
+
+void SparseMatrix::applyILUTransposed(double x[]) const{
+    // the lower part of the transposed factors is U^T (with the diagonal), the upper part is L^T (unit diagonal)
+    sweep(true,  true,  tlower_pntr, tlower_rows, tpntr, tindx, tindxD, tilu, 1, x);
+    sweep(false, false, tupper_pntr, tupper_rows, tpntr, tindx, tindxD, tilu, 1, x);
+}
+
+void SparseMatrix::multiply(bool transposed, const double x[], double y[]) const{
+    std::vector<int> const &mpntr = (transposed) ? tpntr : pntr;
+    std::vector<int> const &mindx = (transposed) ? tindx : indx;
+    std::vector<double> const &mvals = (transposed) ? tvals : vals;
+    #pragma omp parallel for
+    for(int i=0; i<num_rows; i++){
+        double sum = 0.0;
+        for(int j=mpntr[i]; j<mpntr[i+1]; j++) sum += mvals[j] * x[mindx[j]];
+        y[i] = sum;
+    }
+}
+
+void SparseMatrix::solve(const double b[], double x[], bool transposed) const{
+    std::vector<double> pb(num_rows);
+    if (!transposed){
+        std::copy(b, b + num_rows, pb.data());
+        applyILU(1, pb.data()); // action of the preconditioner
+    }
+    solveGMRES(b, pb, x, transposed);
+}
+
+void SparseMatrix::solve(int num_rhs, const double b[], double x[]) const{
+    size_t num_entries = Utils::size_mult(num_rows, num_rhs);
+    if (num_rhs == 1){
+        solve(b, x);
+        return;
+    }
+
+    std::vector<double> pb(b, b + num_entries);
+    applyILU(num_rhs, pb.data()); // precondition all right-hand-sides in one sweep over the factors
+
+    #pragma omp parallel
+    {
+        std::vector<double> bk(num_rows), pbk(num_rows), xk(num_rows);
+        #pragma omp for schedule(dynamic)
+        for(int k=0; k<num_rhs; k++){
+            for(int i=0; i<num_rows; i++){
+                bk[i] = b[Utils::size_mult(i, num_rhs) + k];
+                pbk[i] = pb[Utils::size_mult(i, num_rhs) + k];
+            }
+            solveGMRES(bk.data(), pbk, xk.data(), false);
+            for(int i=0; i<num_rows; i++) x[Utils::size_mult(i, num_rhs) + k] = xk[i];
+        }
+    }
 }
 
-void SparseMatrix::solve(const double b[], double x[], bool transposed) const{ // ustd::sing GMRES
+void SparseMatrix::solveGMRES(const double b[], std::vector<double> &pb, double x[], bool transposed) const{
     int max_inner = 30;
     int max_outer = 80;
     std::vector<double> W((max_inner+1) * num_rows); // Krylov basis
@@ -380,67 +518,19 @@ void SparseMatrix::solve(const double b[], double x[], bool transposed) const{ /
     double outer_res = tol + 1.0; // outer and inner residual
     int outer_itr = 0; // counts the inner and outer iterations
 
-    std::vector<double> pb(num_rows);
-    if (!transposed){
-        std::copy(b, b + num_rows, pb.data());
-
-        // action of the preconditioner
-        for(int i=1; i<num_rows; i++){
-            for(int j=pntr[i]; j<indxD[i]; j++){
-                pb[i] -= ilu[j] * pb[indx[j]];
-            }
-        }
-        for(int i=num_rows-1; i>=0; i--){
-            for(int j=indxD[i]+1; j<pntr[i+1]; j++){
-                pb[i] -= ilu[j] * pb[indx[j]];
-            }
-            pb[i] /= ilu[indxD[i]];
-        }
-    }
-
     std::fill(x, x + num_rows, 0.0); // zero initial guess, I wonder if we can improve this
 
     while ((outer_res > tol) && (outer_itr < max_outer)){
-        for(int i=0; i<num_rows; i++) W[i] = 0.0;
         if (transposed){
             std::copy(x, x + num_rows, pb.data());
-            for(int i=0; i<num_rows; i++){
-                pb[i] /= ilu[indxD[i]];
-                for(int j=indxD[i]+1; j<pntr[i+1]; j++){
-                    pb[indx[j]] -= ilu[j] * pb[i];
-                }
-            }
-            for(int i=num_rows-2; i>=0; i--){
-                for(int j=pntr[i]; j<indxD[i]; j++){
-                    pb[indx[j]] -= ilu[j] * pb[i];
-                }
-            }
-            for(int i=0; i<num_rows; i++){
-                for(int j=pntr[i]; j<pntr[i+1]; j++){
-                    W[indx[j]] += vals[j] * pb[i];
-                }
-            }
+            applyILUTransposed(pb.data());
+            multiply(true, pb.data(), W.data());
             for(int i=0; i<num_rows; i++){
                 W[i] = b[i] - W[i];
             }
         }else{
-            for(int i=0; i<num_rows; i++){
-                for(int j=pntr[i]; j<pntr[i+1]; j++){
-                    W[i] += vals[j] * x[indx[j]];
-                }
-            }
-            for(int i=1; i<num_rows; i++){
-                for(int j=pntr[i]; j<indxD[i]; j++){
-                    W[i] -= ilu[j] * W[indx[j]];
-                }
-            }
-            for(int i=num_rows-1; i>=0; i--){
-                for(int j=indxD[i]+1; j<pntr[i+1]; j++){
-                    W[i] -= ilu[j] * W[indx[j]];
-                }
-                W[i] /= ilu[indxD[i]];
-            }
-
+            multiply(false, x, W.data());
+            applyILU(1, W.data());
             for(int i=0; i<num_rows; i++){
                 W[i] = pb[i] - W[i];
             }
@@ -456,42 +546,13 @@ void SparseMatrix::solve(const double b[], double x[], bool transposed) const{ /
         while ((inner_res > tol) && (inner_itr < max_inner-1)){
             inner_itr++;
 
-            std::fill(&(W[inner_itr*num_rows]), &(W[inner_itr*num_rows]) + num_rows, 0.0);
             if (transposed){
                 std::copy(&(W[num_rows*(inner_itr-1)]), &(W[num_rows*(inner_itr-1)]) + num_rows, pb.data());
-                for(int i=0; i<num_rows; i++){
-                    pb[i] /= ilu[indxD[i]];
-                    for(int j=indxD[i]+1; j<pntr[i+1]; j++){
-                        pb[indx[j]] -= ilu[j] * pb[i];
-                    }
-                }
-                for(int i=num_rows-2; i>=0; i--){
-                    for(int j=pntr[i]; j<indxD[i]; j++){
-                        pb[indx[j]] -= ilu[j] * pb[i];
-                    }
-                }
-                for(int i=0; i<num_rows; i++){
-                    for(int j=pntr[i]; j<pntr[i+1]; j++){
-                        W[inner_itr*num_rows + indx[j]] += vals[j] * pb[i];
-                    }
-                }
+                applyILUTransposed(pb.data());
+                multiply(true, pb.data(), &(W[inner_itr*num_rows]));
             }else{
-                for(int i=0; i<num_rows; i++){
-                    for(int j=pntr[i]; j<pntr[i+1]; j++){
-                        W[inner_itr*num_rows + i] += vals[j] * W[num_rows*(inner_itr-1) + indx[j]];
-                    }
-                }
-                for(int i=1; i<num_rows; i++){
-                    for(int j=pntr[i]; j<indxD[i]; j++){
-                        W[inner_itr*num_rows + i] -= ilu[j] * W[inner_itr*num_rows + indx[j]];
-                    }
-                }
-                for(int i=num_rows-1; i>=0; i--){
-                    for(int j=indxD[i]+1; j<pntr[i+1]; j++){
-                        W[inner_itr*num_rows + i] -= ilu[j] * W[inner_itr*num_rows + indx[j]];
-                    }
-                    W[inner_itr*num_rows + i] /= ilu[indxD[i]];
-                }
+                multiply(false, &(W[num_rows*(inner_itr-1)]), &(W[inner_itr*num_rows]));
+                applyILU(1, &(W[inner_itr*num_rows]));
             }
 
             #pragma omp parallel for
@@ -548,19 +609,7 @@ void SparseMatrix::solve(const double b[], double x[], bool transposed) const{ /
                 }
             }
 
-            if (transposed){
-                for(int i=0; i<num_rows; i++){
-                    x[i] /= ilu[indxD[i]];
-                    for(int j=indxD[i]+1; j<pntr[i+1]; j++){
-                        x[indx[j]] -= ilu[j] * x[i];
-                    }
-                }
-                for(int i=num_rows-2; i>=0; i--){
-                    for(int j=pntr[i]; j<indxD[i]; j++){
-                        x[indx[j]] -= ilu[j] * x[i];
-                    }
-                }
-            }
+            if (transposed) applyILUTransposed(x);
 
         }
 
@@ -132,6 +132,15 @@ public:
     //! \brief Solve `op(A) x = b` where `op` is either identity (find the coefficients) or transpose (find the interpolation weights).
     void solve(const double b[], double x[], bool transposed = false) const;
 
+    /*!
+     * \brief Solve `A x = b` for multiple right-hand-sides.
+     *
+     * Both \b b and \b x have \b num_rhs entries per row of the matrix (i.e., the layout of the model values
+     * with \b num_rhs outputs). The preconditioner is applied to all right-hand-sides in a single pass
+     * and the GMRES iterations for the different right-hand-sides are distributed across the OpenMP threads.
+     */
+    void solve(int num_rhs, const double b[], double x[]) const;
+
 protected:
     //! \brief Clear the internal data structures (maybe not needed?)
     void clear();
@@ -139,11 +148,42 @@ protected:
     //! \brief Compute the incomplete lower-upper decomposition of the matrix (zero extra fill).
     void computeILU();
 
+    /*!
+     * \brief Group the rows into wavefronts for the sweep over the \b lower (or upper) triangular part of the matrix.
+     *
+     * The rows in a wavefront depend only on rows from the previous wavefronts, hence each wavefront can be processed in parallel.
+     * The rows of wavefront \b l are listed in \b levels_rows between \b levels_pntr[l] and \b levels_pntr[l+1],
+     * for the upper part the wavefronts are listed in the order of the backward sweep.
+     */
+    void computeLevels(bool lower, std::vector<int> const &mpntr, std::vector<int> const &mindx, std::vector<int> const &mindxD,
+                       std::vector<int> &levels_pntr, std::vector<int> &levels_rows) const;
+
+    //! \brief Triangular solve (forward if \b lower, backward otherwise) using the wavefronts, divides by the diagonal if \b divide is set.
+    void sweep(bool lower, bool divide, std::vector<int> const &levels_pntr, std::vector<int> const &levels_rows,
+               std::vector<int> const &mpntr, std::vector<int> const &mindx, std::vector<int> const &mindxD,
+               std::vector<double> const &factor, int num_rhs, double panel[]) const;
+
+    //! \brief Apply the inverse of the ILU factors to the \b panel with \b num_rhs entries per row.
+    void applyILU(int num_rhs, double panel[]) const;
+
+    //! \brief Apply the inverse of the transpose of the ILU factors to \b x.
+    void applyILUTransposed(double x[]) const;
+
+    //! \brief Compute `y = op(A) x` where \b op is either identity or transpose.
+    void multiply(bool transposed, const double x[], double y[]) const;
+
+    //! \brief Preconditioned GMRES iteration, \b pb is the preconditioned right-hand-side (or workspace if \b transposed).
+    void solveGMRES(const double b[], std::vector<double> &pb, double x[], bool transposed) const;
+
 private:
     double tol;
     int num_rows;
     std::vector<int> pntr, indx, indxD;
     std::vector<double> vals, ilu;
+    std::vector<int> lower_pntr, lower_rows, upper_pntr, upper_rows; // wavefronts of the forward and backward sweeps
+    std::vector<int> tpntr, tindx, tindxD; // transposed pattern, used by the transposed solves
+    std::vector<double> tvals, tilu;
+    std::vector<int> tlower_pntr, tlower_rows, tupper_pntr, tupper_rows;
 };
 
 }
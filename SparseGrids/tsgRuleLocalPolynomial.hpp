@@ -72,7 +72,7 @@ protected:
 
 
 template<TypeOneDRule rule, bool isZeroOrder>
-class templRuleLocalPolynomial : public BaseRuleLocalPolynomial{
+class templRuleLocalPolynomial final : public BaseRuleLocalPolynomial{ // final allows calls through the template type to be inlined
 public:
     templRuleLocalPolynomial(){}
     ~templRuleLocalPolynomial(){}
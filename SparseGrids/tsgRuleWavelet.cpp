@@ -391,6 +391,49 @@ void RuleWavelet::getShiftScale(int point, double &scale, double &shift) const{
     }
 }
 
+void RuleWavelet::getSupport(int point, double &lower, double &upper) const{
+    // The wavelets are evaluated in a shifted and scaled variable, the bounds of the support
+    // follow from the support of the canonical wavelets (see eval_linear() and eval_cubic()).
+    lower = -1.0;
+    upper =  1.0;
+    if (order == 1){
+        if (point < 3){
+            lower = std::max(-1.0, getNode(point) - 1.0);
+            upper = std::min( 1.0, getNode(point) + 1.0);
+            return;
+        }
+        int l = Maths::intlog2(point - 1);
+        int subindex = (point - 1) % (1 << l);
+        double scale = std::pow(2,l-2);
+        if (subindex == 0){
+            upper = 1.0 / scale - 1.0;
+        }else if (subindex == (1 << l) - 1){
+            lower = 1.0 - 1.0 / scale;
+        }else{
+            double shift = 0.5 * (double (subindex - 1));
+            lower = std::max(-1.0, shift / scale - 1.0);
+            upper = std::min( 1.0, (1.5 + shift) / scale - 1.0);
+        }
+    }else{
+        if (point < 17) return; // scaling functions and the first two levels of wavelets span the whole domain
+        int l = Maths::intlog2(point - 1);
+        int subindex = (point - 1) % (1 << l);
+        double scale = pow(2,l-4);
+        if (subindex < 5){
+            upper = std::min(1.0, 2.0 / scale - 1.0);
+        }else if ((1 << l) - 1 - subindex < 5){
+            lower = std::max(-1.0, 1.0 - 2.0 / scale);
+        }else{
+            double shift = 0.125 * (double (subindex - 5));
+            lower = std::max(-1.0, shift / scale - 1.0);
+            upper = std::min( 1.0, (2.0 + shift) / scale - 1.0);
+        }
+    }
+    // guard against round-off, the wavelets are zero on the boundary of the support anyway
+    lower -= Maths::num_tol;
+    upper += Maths::num_tol;
+}
+
 inline double RuleWavelet::eval_linear(int point, double x) const{
     // Given a wavelet designated by point and a value x, evaluates the wavelet at x.
 
@@ -59,6 +59,7 @@ public:
     int getParent(int point) const; // Returns the parent of the given node
 
     void getShiftScale(int point, double &scale, double &shift) const; // encodes for GPU purposes
+    void getSupport(int point, double &lower, double &upper) const; // interval in [-1, 1] outside of which the wavelet is zero
 protected:
     inline double eval_linear(int pt, double x) const;
     inline double eval_cubic(int pt, double x) const;
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2017, Miroslav Stoyanov
+ *
+ * This file is part of
+ * Toolkit for Adaptive Stochastic Modeling And Non-Intrusive ApproximatioN: TASMANIAN
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * UT-BATTELLE, LLC AND THE UNITED STATES GOVERNMENT MAKE NO REPRESENTATIONS AND DISCLAIM ALL WARRANTIES, BOTH EXPRESSED AND IMPLIED.
+ * THERE ARE NO EXPRESS OR IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, OR THAT THE USE OF THE SOFTWARE WILL NOT INFRINGE ANY PATENT,
+ * COPYRIGHT, TRADEMARK, OR OTHER PROPRIETARY RIGHTS, OR THAT THE SOFTWARE WILL ACCOMPLISH THE INTENDED RESULTS OR THAT THE SOFTWARE OR ITS USE WILL NOT RESULT IN INJURY OR DAMAGE.
+ * THE USER ASSUMES RESPONSIBILITY FOR ALL LIABILITIES, PENALTIES, FINES, CLAIMS, CAUSES OF ACTION, AND COSTS AND EXPENSES, CAUSED BY, RESULTING FROM OR ARISING OUT OF,
+ * IN WHOLE OR IN PART THE USE, STORAGE OR DISPOSAL OF THE SOFTWARE.
+ */
+
+#ifndef __TASMANIAN_THREAD_POOL_CPP
+#define __TASMANIAN_THREAD_POOL_CPP
+
+#include "tsgThreadPool.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace TasGrid{
+
+// true while the thread is executing tasks of some pool, nested calls to run() do not use the workers
+static thread_local bool inside_pool_task = false;
+
+#ifdef __linux__
+// reads a list of integers in the sysfs format, e.g., "0-3,8,10-11", returns an empty list if the file is missing
+static std::vector<int> readSysList(std::string const &filename){
+    std::vector<int> result;
+    std::ifstream ifs(filename);
+    std::string list;
+    if (!(ifs >> list)) return result;
+    std::stringstream ss(list);
+    std::string range;
+    while(std::getline(ss, range, ',')){
+        int first, last;
+        int num_read = std::sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (num_read < 1) continue;
+        if (num_read == 1) last = first;
+        for(int i=first; i<=last; i++) result.push_back(i);
+    }
+    return result;
+}
+#endif
+
+// pins the calling thread to the cpu, pinning is only a hint and failures are ignored
+static void pinCurrentThread(int cpu){
+    #ifdef __linux__
+    if (cpu < 0) return;
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set);
+    #else
+    (void) cpu;
+    #endif
+}
+
+std::vector<int> ThreadPool::getPinnedCPUs(){
+    std::vector<int> cpus;
+    #ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed) != 0) return cpus;
+
+    // group the allowed CPUs by NUMA node, CPUs without a node form one more group
+    std::vector<std::vector<int>> groups;
+    std::vector<bool> grouped(CPU_SETSIZE, false);
+    for(int node : readSysList("/sys/devices/system/node/online")){
+        std::vector<int> group;
+        for(int c : readSysList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")){
+            if ((c >= 0) && (c < CPU_SETSIZE) && CPU_ISSET(c, &allowed) && !grouped[c]){
+                group.push_back(c);
+                grouped[c] = true;
+            }
+        }
+        if (!group.empty()) groups.push_back(std::move(group));
+    }
+    std::vector<int> remaining;
+    for(int c=0; c<CPU_SETSIZE; c++)
+        if (CPU_ISSET(c, &allowed) && !grouped[c]) remaining.push_back(c);
+    if (!remaining.empty()) groups.push_back(std::move(remaining));
+
+    // cycle through the groups, i.e., the NUMA nodes
+    size_t max_group = 0;
+    for(auto const &g : groups) max_group = std::max(max_group, g.size());
+    for(size_t i=0; i<max_group; i++)
+        for(auto const &g : groups)
+            if (i < g.size()) cpus.push_back(g[i]);
+    #endif
+    return cpus;
+}
+
+ThreadPool::ThreadPool(int num_threads, bool pin_threads) : static_partition(pin_threads), current_task(nullptr), current_num_tasks(0), next_task(0),
+                                                            num_active(0), generation(0), shutdown(false){
+    int num_cores = std::max((int) std::thread::hardware_concurrency(), 1);
+    if (pin_threads){ // all tasks run in pinned workers, the calling thread belongs to the application and is never pinned
+        std::vector<int> cpus = getPinnedCPUs();
+        if (num_threads < 1) num_threads = (cpus.empty()) ? num_cores : (int) cpus.size();
+        workers.reserve((size_t) num_threads);
+        for(int i=0; i<num_threads; i++){
+            int cpu = (cpus.empty()) ? -1 : cpus[((size_t) i) % cpus.size()];
+            workers.emplace_back([&, i, cpu]()->void{
+                pinCurrentThread(cpu);
+                workerLoop(i);
+            });
+        }
+    }else{
+        if (num_threads < 1) num_threads = num_cores;
+        workers.reserve((size_t) (num_threads - 1));
+        for(int i=1; i<num_threads; i++)
+            workers.emplace_back([&, i]()->void{ workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        shutdown = true;
+    }
+    wake.notify_all();
+    for(auto &w : workers) w.join();
+}
+
+void ThreadPool::run(int num_tasks, std::function<void(int)> const &task){
+    if (num_tasks < 1) return;
+    if (inside_pool_task || workers.empty() || ((num_tasks == 1) && !static_partition)){
+        for(int t=0; t<num_tasks; t++) task(t);
+        return;
+    }
+
+    std::lock_guard<std::mutex> serial(run_lock);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        current_task = &task;
+        current_num_tasks = num_tasks;
+        next_task = 0;
+        num_active = (int) workers.size();
+        error = nullptr;
+        generation++;
+    }
+    wake.notify_all();
+
+    if (!static_partition) executeTasks(0); // the caller is one of the workers, unless the workers are pinned
+
+    std::exception_ptr task_error;
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [&]()->bool{ return (num_active == 0); });
+        current_task = nullptr;
+        std::swap(task_error, error);
+    }
+    if (task_error) std::rethrow_exception(task_error);
+}
+
+void ThreadPool::workerLoop(int thread_id){
+    unsigned long long last_generation = 0;
+    while(true){
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&]()->bool{ return shutdown || (generation != last_generation); });
+            if (shutdown) return;
+            last_generation = generation;
+        }
+        executeTasks(thread_id);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (--num_active == 0) done.notify_one();
+        }
+    }
+}
+
+void ThreadPool::executeTasks(int thread_id){
+    bool was_inside = inside_pool_task;
+    inside_pool_task = true;
+    if (static_partition){
+        long long num_threads = (long long) getNumThreads();
+        int range_begin = (int) ((((long long) current_num_tasks) * thread_id) / num_threads);
+        int range_end   = (int) ((((long long) current_num_tasks) * (thread_id + 1)) / num_threads);
+        for(int t = range_begin; t < range_end; t++){
+            try{
+                (*current_task)(t);
+            }catch(...){
+                std::lock_guard<std::mutex> guard(lock);
+                if (!error) error = std::current_exception();
+                break;
+            }
+        }
+    }else{
+        for(int t = next_task++; t < current_num_tasks; t = next_task++){
+            try{
+                (*current_task)(t);
+            }catch(...){
+                std::lock_guard<std::mutex> guard(lock);
+                if (!error) error = std::current_exception();
+                next_task = current_num_tasks; // skip the remaining tasks
+            }
+        }
+    }
+    inside_pool_task = was_inside;
+}
+
+ParallelExecutor makeThreadPoolExecutor(int num_threads, bool pin_threads){
+    auto pool = std::make_shared<ThreadPool>(num_threads, pin_threads);
+    return [pool](int num_tasks, std::function<void(int)> const &task)->void{ pool->run(num_tasks, task); };
+}
+
+void Utils::runExecutorTasks(ParallelExecutor const &executor, int num_tasks, std::function<void(int)> const &task){
+    executor(num_tasks, [&](int t)->void{
+        #ifdef _OPENMP
+        int omp_threads = omp_get_max_threads();
+        omp_set_num_threads(1);
+        try{
+            task(t);
+        }catch(...){
+            omp_set_num_threads(omp_threads);
+            throw;
+        }
+        omp_set_num_threads(omp_threads);
+        #else
+        task(t);
+        #endif
+    });
+}
+
+}
+
+#endif
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2017, Miroslav Stoyanov
+ *
+ * This file is part of
+ * Toolkit for Adaptive Stochastic Modeling And Non-Intrusive ApproximatioN: TASMANIAN
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * UT-BATTELLE, LLC AND THE UNITED STATES GOVERNMENT MAKE NO REPRESENTATIONS AND DISCLAIM ALL WARRANTIES, BOTH EXPRESSED AND IMPLIED.
+ * THERE ARE NO EXPRESS OR IMPLIED WARRANTIES OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, OR THAT THE USE OF THE SOFTWARE WILL NOT INFRINGE ANY PATENT,
+ * COPYRIGHT, TRADEMARK, OR OTHER PROPRIETARY RIGHTS, OR THAT THE SOFTWARE WILL ACCOMPLISH THE INTENDED RESULTS OR THAT THE SOFTWARE OR ITS USE WILL NOT RESULT IN INJURY OR DAMAGE.
+ * THE USER ASSUMES RESPONSIBILITY FOR ALL LIABILITIES, PENALTIES, FINES, CLAIMS, CAUSES OF ACTION, AND COSTS AND EXPENSES, CAUSED BY, RESULTING FROM OR ARISING OUT OF,
+ * IN WHOLE OR IN PART THE USE, STORAGE OR DISPOSAL OF THE SOFTWARE.
+ */
+
+#ifndef __TASMANIAN_THREAD_POOL_HPP
+#define __TASMANIAN_THREAD_POOL_HPP
+
+#include <thread>
+#include <condition_variable>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <exception>
+
+#include "tsgEnumerates.hpp"
+
+/*!
+ * \internal
+ * \file tsgThreadPool.hpp
+ * \brief Executor interface and a built-in thread pool.
+ * \author Miroslav Stoyanov
+ * \ingroup TasmanianSG
+ *
+ * Defines the signature of the executors that can replace the OpenMP parallel loops
+ * of the batch evaluations and surplus computations, and a simple thread pool executor.
+ * \endinternal
+ */
+
+namespace TasGrid{
+
+/*!
+ * \ingroup TasmanianSG
+ * \brief Signature of a parallel executor, must call \b task once for every integer from 0 to \b num_tasks - 1.
+ *
+ * The tasks are independent, the executor can run them concurrently and in any order
+ * but it must return only after all tasks have completed.
+ * If a task throws, the executor should propagate the exception to the caller after the other tasks complete,
+ * e.g., the executor can simply let the exception escape when all tasks are run in the calling thread.
+ *
+ * Example using a task-based parallel library:
+ * \code
+ * grid.setExecutor([&](int num_tasks, std::function<void(int)> const &task)->void{
+ *     tbb::parallel_for(0, num_tasks, task);
+ * });
+ * \endcode
+ * See TasmanianSparseGrid::setExecutor() and makeThreadPoolExecutor().
+ */
+using ParallelExecutor = std::function<void(int num_tasks, std::function<void(int task)> const &task)>;
+
+/*!
+ * \ingroup TasmanianSG
+ * \brief Simple thread pool that assigns the tasks dynamically to a fixed set of persistent threads.
+ *
+ * The threads are started in the constructor and joined in the destructor.
+ * Each call to run() hands the tasks to the workers through a shared atomic counter,
+ * thus idle threads immediately pick up the remaining work and the load is balanced without
+ * a static partition of the tasks. The calling thread participates in the work as well.
+ *
+ * Only one run() can be active at a time, concurrent calls from different threads are serialized;
+ * tasks that call run() (on any pool) are executed sequentially in the calling thread,
+ * which prevents deadlocks and oversubscription due to nesting.
+ *
+ * If the threads are pinned, all tasks are executed by workers and the calling thread only waits,
+ * each worker is bound to a single CPU (on Linux, ignored on other systems)
+ * and the tasks are partitioned statically into contiguous ranges, one range per worker.
+ * The CPUs are taken from the affinity mask of the process (i.e., respecting taskset and cgroup cpusets)
+ * and consecutive workers are placed on different NUMA nodes, see getPinnedCPUs().
+ * Thus, repeated calls assign the same tasks to the same core and the output of each task
+ * is first touched and then updated by the same NUMA node, while all nodes are used.
+ */
+class ThreadPool{
+public:
+    /*!
+     * \brief Create a pool with \b num_threads threads that execute tasks.
+     *
+     * The threads include the caller, unless \b pin_threads is \b true.
+     * A non-positive number uses std::thread::hardware_concurrency(), or the size of getPinnedCPUs() if \b pin_threads is \b true.
+     */
+    ThreadPool(int num_threads, bool pin_threads = false);
+    //! \brief Stops and joins all threads.
+    ~ThreadPool();
+    //! \brief The pool cannot be copied.
+    ThreadPool(ThreadPool const&) = delete;
+    //! \brief The pool cannot be copied.
+    ThreadPool& operator =(ThreadPool const&) = delete;
+
+    //! \brief Returns the number of threads that execute tasks, including the calling thread if the pool is not pinned.
+    int getNumThreads() const{ return (int) workers.size() + ((static_partition) ? 0 : 1); }
+
+    /*!
+     * \brief Returns the CPUs used by the pinned workers, worker \b i is pinned to entry \b i modulo the size of the result.
+     *
+     * The list holds the CPUs in the affinity mask of the calling thread, ordered so that consecutive entries
+     * cycle through the NUMA nodes reported in /sys/devices/system/node, e.g., on two nodes
+     * the first half of the workers has the same number of threads on each node.
+     * Without the node information the CPUs are listed in increasing order,
+     * the result is empty on systems other than Linux.
+     */
+    static std::vector<int> getPinnedCPUs();
+
+    //! \brief Calls \b task for every integer from 0 to \b num_tasks - 1, the first exception thrown by a task is rethrown.
+    void run(int num_tasks, std::function<void(int)> const &task);
+
+protected:
+    //! \brief The loop of the worker threads, \b thread_id is between 1 and getNumThreads() - 1, or 0 and getNumThreads() - 1 if pinned.
+    void workerLoop(int thread_id);
+    //! \brief Executes the tasks of the current job, either until the counter is exhausted or the static range of \b thread_id.
+    void executeTasks(int thread_id);
+
+private:
+    std::vector<std::thread> workers;
+    bool static_partition; // true for pinned pools, where the caller does not execute tasks
+
+    std::mutex run_lock; // serializes calls to run()
+    std::mutex lock;
+    std::condition_variable wake, done;
+
+    std::function<void(int)> const *current_task;
+    int current_num_tasks;
+    std::atomic<int> next_task;
+    int num_active;
+    unsigned long long generation;
+    bool shutdown;
+    std::exception_ptr error;
+};
+
+/*!
+ * \ingroup TasmanianSG
+ * \brief Returns an executor that runs the tasks in a new ThreadPool with \b num_threads threads.
+ *
+ * The pool is owned by the returned executor and copies of the executor share the pool,
+ * the threads are joined when the last copy is destroyed.
+ * If \b num_threads is not positive, the number of threads is set to std::thread::hardware_concurrency().
+ * If \b pin_threads is \b true, the workers are pinned to cores and the tasks are partitioned statically,
+ * see ThreadPool.
+ */
+ParallelExecutor makeThreadPoolExecutor(int num_threads = 0, bool pin_threads = false);
+
+namespace Utils{
+/*!
+ * \internal
+ * \ingroup TasmanianUtils
+ * \brief Runs the tasks with the \b executor, the OpenMP loops called from within a task use a single thread.
+ *
+ * The executor controls the parallelism, thus the OpenMP regions inside the tasks are restricted
+ * to one thread to avoid nested oversubscription; the OpenMP settings of the calling threads
+ * are restored after each task.
+ * \endinternal
+ */
+void runExecutorTasks(ParallelExecutor const &executor, int num_tasks, std::function<void(int)> const &task);
+}
+
+}
+
+#endif
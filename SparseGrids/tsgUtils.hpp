@@ -43,6 +43,9 @@
  * \endinternal
  */
 
+#include <memory>
+#include <mutex>
+
 #include "tsgMathUtils.hpp"
 
 /*!
@@ -101,6 +104,109 @@ std::vector<T> mergeVectors(std::vector<std::vector<T>> const &vec){
     return result;
 }
 
+/*!
+ * \internal
+ * \brief Set of integers in the range 0 to size - 1 that can be emptied in constant time.
+ * \ingroup TasmanianUtils
+ *
+ * Each entry is stamped with the epoch of the last insert and clear() simply advances the epoch,
+ * thus the set can be reused for many graph walks without allocating or zeroing memory;
+ * the stamps are reset only when the epoch counter wraps around.
+ * \endinternal
+ */
+class VisitedSet{
+public:
+    //! \brief Create an empty set that can hold integers from 0 to \b size - 1.
+    VisitedSet(int size) : epoch(1), stamps((size_t) size, 0){}
+    //! \brief Default destructor.
+    ~VisitedSet(){}
+
+    //! \brief Returns the number of integers that the set can hold.
+    int getSize() const{ return (int) stamps.size(); }
+
+    //! \brief Remove all entries from the set.
+    void clear(){
+        if (++epoch == 0){
+            std::fill(stamps.begin(), stamps.end(), 0u);
+            epoch = 1;
+        }
+    }
+    //! \brief Returns \b true if \b i was not in the set and adds \b i to the set.
+    bool insert(int i){
+        if (stamps[i] == epoch) return false;
+        stamps[i] = epoch;
+        return true;
+    }
+
+private:
+    unsigned int epoch;
+    std::vector<unsigned int> stamps;
+};
+
+/*!
+ * \internal
+ * \brief Pool of evaluation workspaces owned by a grid object.
+ * \ingroup TasmanianUtils
+ *
+ * The acquire() method takes a workspace from the pool, or creates a new one if the pool is empty,
+ * and the workspace returns to the pool when the handle goes out of scope.
+ * Concurrent callers receive different workspaces, thus the pool holds at most one workspace
+ * for each thread that used the owner at the same time, and the memory is released together with the owner.
+ * Copies of a pool start empty, the workspaces are never shared between objects.
+ * \endinternal
+ */
+template<class Workspace>
+class WorkspacePool{
+public:
+    //! \brief Create an empty pool.
+    WorkspacePool(){}
+    //! \brief Copy constructor, creates an empty pool.
+    WorkspacePool(WorkspacePool const &){}
+    //! \brief Copy assignment, keeps the existing workspaces.
+    WorkspacePool& operator=(WorkspacePool const &){ return *this; }
+    //! \brief Default destructor.
+    ~WorkspacePool(){}
+
+    //! \brief Holds a workspace and returns it to the pool on destruction.
+    class Handle{
+    public:
+        //! \brief Constructor used by the pool.
+        Handle(WorkspacePool const *owner, std::unique_ptr<Workspace> &&acquired) : pool(owner), workspace(std::move(acquired)){}
+        //! \brief Move constructor.
+        Handle(Handle &&other) : pool(other.pool), workspace(std::move(other.workspace)){}
+        //! \brief Returns the workspace to the pool.
+        ~Handle(){ if (workspace) pool->release(std::move(workspace)); }
+
+        //! \brief Access the workspace.
+        Workspace& operator*(){ return *workspace; }
+        //! \brief Access the workspace members.
+        Workspace* operator->(){ return workspace.get(); }
+
+    private:
+        WorkspacePool const *pool;
+        std::unique_ptr<Workspace> workspace;
+    };
+
+    //! \brief Take a workspace from the pool, allocates a new one only if all existing workspaces are in use.
+    Handle acquire() const{
+        std::lock_guard<std::mutex> lock(access);
+        if (available.empty()) return Handle(this, std::unique_ptr<Workspace>(new Workspace()));
+        std::unique_ptr<Workspace> workspace = std::move(available.back());
+        available.pop_back();
+        return Handle(this, std::move(workspace));
+    }
+
+private:
+    //! \brief Put the workspace back into the pool.
+    void release(std::unique_ptr<Workspace> &&workspace) const{
+        std::lock_guard<std::mutex> lock(access);
+        available.push_back(std::move(workspace));
+    }
+
+    mutable std::mutex access;
+    mutable std::vector<std::unique_ptr<Workspace>> available;
+};
+
 /*!
  * \internal
  * \brief Wraps around a C-style of an array and mimics 2D data-structure.